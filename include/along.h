@@ -0,0 +1,42 @@
+/* along.h
+   Along-track low-pass filter and decimation of one pass of sea surface
+   heights (wdr.h) into CDR points (cdr.h).
+
+   Each output point, on the grid of whole multiples of dt seconds, is a
+   weighted least squares line through the heights (and positions and
+   corrections) around it, with weights
+
+     w(tau) = (1 + |tau|/T) exp(-|tau|/T),   tau = t - t_out
+
+   so the line's value is the filtered height and its slope the filtered
+   rate, which divided by the ground speed from the filtered positions is
+   the along-track slope dsh.  The filter passes half the amplitude at a
+   wavelength of about 10 T times the ground speed (14 km at T = 0.2 s).
+   Times need not be even; a point is only written where the data around
+   it are dense and balanced enough that the line is not an extrapolation,
+   so gaps and pass ends are left out rather than bridged.
+
+   along_direct() sums over each output point's window, O(n x window).
+   along_recursive() gets the same sums in O(n): to one side of an output
+   point every weight is exp(-a) times a polynomial in a = |tau|/T, and
+   the sums of exp(-a) a^m over the points behind a moving time carry to
+   a later time by a 4x4 binomial update and one exp(), however unevenly
+   the points are spaced.  A forward sweep gives each output point the
+   sums over the points at or before it, and a backward sweep those after
+   it.  The kernel is not cut at ALONG_CUT T, so the two differ by about
+   1e-6 of the signal; wdr2cdr -c measures it.
+*/
+#ifndef along_h
+#define along_h
+
+#include <stddef.h>
+#include "wdr.h"
+#include "cdr.h"
+
+#define ALONG_CUT   16.     /* direct sums stop at |tau| = ALONG_CUT T, where w < 2e-6 */
+
+size_t  along_nout (struct WDR_POINT *p, size_t n, double dt);
+size_t  along_direct (struct WDR_POINT *p, size_t n, double tscale, double dt, struct CDR *out);
+size_t  along_recursive (struct WDR_POINT *p, size_t n, double tscale, double dt, struct CDR *out);
+
+#endif /* along_h */
@@ -3,7 +3,17 @@
 Structure for Saral data
 
 */
+#ifndef altika40hz_h
+#define altika40hz_h
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <netcdf.h>
+
+#define I4NaN 2147483647    /* If an int is set to this it means it is NaN */
+#define I2NaN 32767         /* If a short int is set to this it means it is NaN */
 #define SOL 299792458.0                 /* speed of light in vacuum */
 
 /* find center of mass correction */
@@ -20,10 +30,12 @@ struct SARAL40HZ {	/* */
 	unsigned int	trackbits;	/* Useful flags to be defined as we go along; initially zero 
 						1	          1 - record empty based on no time or range record 
 						2	          2 - dry land idetermined from iwetdry.c 
+						4                 3 - drange[1] is out of bounds (retrack -2)
+						8                 4 - second retrack (-2) failed least squares
 						1024             11 - standard deviation out of range (e.g. LRM 0.3 to 0.8)
-						2048             12 - drange is out of bounds
+						2048             12 - drange[0] is out of bounds
 						4096             13 - swh is out of range (e.g. LRM 1 to 10 m)
-						8192             14 - retrack failed least squares
+						8192             14 - first retrack failed least squares
 						16384            15 - amp out of range (e.g. LRM 50000 to 80000) */
 	unsigned int csum; 		/* computed sum of counts of power for all range gates */
 
@@ -60,3 +72,6 @@ struct SARAL40HZ {	/* */
       /*unsigned short int  wave_c[64];	 C-band waveform data. Not available for AltiKa */
 };
 
+#define SARAL40HZ_LAYOUT 0x1750734fu     /* rec_layout(), see rec_file.h */
+
+#endif /* altika40hz_h */
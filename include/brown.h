@@ -0,0 +1,34 @@
+/* brown.h
+   Brown-type model of an ocean altimeter waveform and a Levenberg-Marquardt
+   fit of it to the counts in a record's wave[].  Gate i of the model is
+
+     m(i) = noise + amp/2 * exp(-decay*(x - decay*sigma^2/2)) * (1 + erf((x - decay*sigma^2)/(sqrt(2)*sigma)))
+
+   with x = i - t0: an erf leading edge of width sigma (gates) centred at
+   gate t0, on a plateau decaying at decay per gate, above a noise floor.
+   This is the Gaussian-PTR Brown model with the antenna term folded into
+   decay; the caller turns t0, sigma and decay into drange, pswh and decay.
+*/
+#ifndef brown_h
+#define brown_h
+
+/* Parameter vector p[BROWN_NPAR] */
+#define BROWN_T0    0       /* leading edge mid-point, gates */
+#define BROWN_SIGMA 1       /* leading edge width, gates */
+#define BROWN_AMP   2       /* plateau amplitude above the noise, counts */
+#define BROWN_NOISE 3       /* thermal noise floor, counts */
+#define BROWN_DECAY 4       /* plateau decay, per gate */
+#define BROWN_NPAR  5
+
+#define BROWN_ALL   0x1f    /* free mask: bit k set fits p[k], clear holds it */
+
+struct BROWN_STAT {
+    double  rms;            /* root mean square misfit, counts */
+    int     iter;           /* iterations used */
+};
+
+void    brown_model (double *p, int ngate, double *m, double *jac);
+void    brown_guess (unsigned short *wave, int ngate, double *p);
+int     brown_fit (unsigned short *wave, int ngate, double *p, int free, struct BROWN_STAT *st);
+
+#endif /* brown_h */
@@ -0,0 +1,39 @@
+/* brown_kernels.h
+   Kernels that evaluate the Brown model of brown.h and its analytic
+   Jacobian over a whole waveform, for brown_fit().  Three kernels trade
+   accuracy for speed:
+
+     BROWN_REF     libm erf() and exp() in double, one gate at a time
+     BROWN_DOUBLE  rational erf and polynomial exp in double, 4 or 8 gates at a time
+     BROWN_FLOAT   the same in float, 8 or 16 gates at a time
+
+   BROWN_DOUBLE and BROWN_FLOAT have AVX2 and AVX-512 versions chosen at
+   run time with the ingest kernels (cvt_kernels.h, CVT_SIMD=...), and a
+   scalar version for anything else.  brown_kernel_check() measures a
+   kernel against BROWN_REF, so a fast kernel can be refused if the build
+   or CPU makes it worse than expected.
+*/
+#ifndef brown_kernels_h
+#define brown_kernels_h
+
+#define BROWN_REF       0
+#define BROWN_DOUBLE    1
+#define BROWN_FLOAT     2
+
+#define BROWN_KTOL      1.e-5   /* largest model error a kernel may have, of amplitude */
+
+/* m[ngate] and, unless jac is NULL, jac[k*ngate + i] = dm(i)/dp[k], by the kernel in use */
+void    brown_eval (double *p, int ngate, double *m, double *jac);
+
+/* Kernel in use: BROWN_DOUBLE unless set, or BROWN_KERNEL=ref|double|float */
+int     brown_kernel (void);
+int     brown_set_kernel (int kernel);
+char    *brown_kernel_name (int kernel);
+char    *brown_kernel_isa (int kernel);
+
+/* Worst model error of kernel against BROWN_REF over a grid of plausible
+   waveforms, as a fraction of amplitude; the worst Jacobian error, as a
+   fraction of the largest derivative for that parameter, goes in *jerr */
+double  brown_kernel_check (int kernel, double *jerr);
+
+#endif /* brown_kernels_h */
@@ -1,21 +1,63 @@
 /* cdr.h */
 /* structure to hold a condensed data record (CDR) */
+/* A CDR file is one pass: a struct CDR_HEAD, then its points packed at
+   CDR_PACKED bytes each (struct CDR without the padding after the floats).
+   On disk every int, float and double is little endian whatever the host,
+   which is what the x86 files written before this library already are.
+
+   cdr_open() maps a file and leaves the packed points in place, for tools
+   that touch a few fields of many points; cdr_unpack() turns any run of
+   them into struct CDR with one memcpy per field (and a byte swap only on
+   a big-endian host).  cdr_load() and cdr_read() give a whole pass
+   unpacked, sized to the file, from a name or a stream; cdr_write() is
+   the matching writer. */
+#ifndef cdr_h
+#define cdr_h
+
+#include <stdio.h>
+#include <stddef.h>
+
+#define CDR_PACKED	28	/* bytes per point on disk */
+#define CDR_HEADSIZE	28	/* bytes of struct CDR_HEAD on disk */
 
 struct CDR {
-	double time_1;
-	float lat;
-	float lon;
-	float sh;
-	float dsh;
-	float cor;
+	double time_1;		/* seconds since 2000 */
+	float lat;		/* degrees */
+	float lon;		/* degrees, 0 to 360 */
+	float sh;		/* sea surface height above the ellipsoid, m */
+	float dsh;		/* along-track slope of sh in the direction of flight, microradians */
+	float cor;		/* corrections taken out of sh, m */
 };
 
 struct CDR_HEAD {
-    int isat;
-    int iasc;
-    int ifile;
-    int idt;
+    int isat;		/* mission, REC_CRYOSAT ... in rec_file.h */
+    int iasc;		/* 1 ascending, 0 descending */
+    int ifile;		/* pass number within its source file */
+    int idt;		/* point spacing, milliseconds */
     int junk_1;
     int junk_2;
     int junk_3;
 };
+
+/* A CDR file mapped read-only; point k is raw + k * CDR_PACKED */
+struct CDR_FILE {
+    struct CDR_HEAD h;
+    size_t  n;
+    const unsigned char *raw;
+    int     fd;
+    void    *map;
+    size_t  maplen;
+};
+
+void    cdr_le (void *dst, const void *src, size_t len);
+void    cdr_unpack (const unsigned char *raw, size_t n, struct CDR *p);
+void    cdr_pack (struct CDR *p, size_t n, unsigned char *raw);
+void    cdr_head_unpack (const unsigned char *raw, struct CDR_HEAD *h);
+void    cdr_head_pack (struct CDR_HEAD *h, unsigned char *raw);
+int     cdr_open (struct CDR_FILE *cf, char *fname);
+void    cdr_close (struct CDR_FILE *cf);
+struct CDR *cdr_load (char *fname, struct CDR_HEAD *h, size_t *n);
+struct CDR *cdr_read (FILE *fp, struct CDR_HEAD *h, size_t *n);
+int     cdr_write (FILE *fp, struct CDR_HEAD *h, struct CDR *p, size_t n);
+
+#endif /* cdr_h */
@@ -0,0 +1,76 @@
+/* cdr_arch.h
+   CDR archive: many passes in one file, so a mission is one open() and
+   one mmap() rather than a walk over hundreds of thousands of small
+   files.  The layout, little endian like cdr.h:
+
+     header     CDR_ARCH_HEAD bytes: magic, version, pass count and the
+                offset of the directory
+     passes     each one a whole CDR file (cdr.h header and packed points)
+     directory  CDR_ARCH_ENTRY bytes per pass, in pass id order
+
+   A pass's id is its place in the directory, so finding it is one
+   multiply.  Each entry keeps the header fields, the time span and the
+   lat/lon box, so a tool can choose passes without touching their points.
+
+   An append writes the new passes after the old directory and then a new
+   directory, and only then rewrites the header; until that last write the
+   old header still describes the old archive, so an interrupted append
+   leaves the archive as it was.  Each append leaves the old directory
+   behind as dead space of CDR_ARCH_ENTRY bytes a pass.
+*/
+#ifndef cdr_arch_h
+#define cdr_arch_h
+
+#include <stdio.h>
+#include <stddef.h>
+#include "cdr.h"
+
+#define CDR_ARCH_MAGIC  "CDRARCH\n"
+#define CDR_ARCH_VERSION 1
+#define CDR_ARCH_HEAD   64      /* bytes of the archive header */
+#define CDR_ARCH_ENTRY  64      /* bytes per directory entry */
+
+/* A directory entry */
+struct CDR_PASS {
+    long    off;            /* bytes from the start of the archive to the pass's CDR header */
+    long    n;              /* points */
+    double  t0, t1;         /* first and last time_1 */
+    float   south, north;   /* deg */
+    float   west, east;     /* deg, 0 to 360; west > east wraps through 0 */
+    int     isat, iasc, ifile, idt;     /* as in struct CDR_HEAD */
+};
+
+/* An archive mapped read-only */
+struct CDR_ARCH {
+    int     fd;
+    void    *map;
+    size_t  maplen;
+    long    npass;
+    const unsigned char *dir;
+    int     rw;             /* mapped by cdr_arch_open_rw() */
+};
+
+/* Writer state, from cdr_arch_create() to cdr_arch_finish() */
+struct CDR_ARCHW {
+    FILE    *fp;
+    struct CDR_PASS *dir;
+    long    npass, cap;
+    long    end;            /* where the next pass goes, and the stream is */
+    int     err;            /* a write failed */
+};
+
+int     cdr_is_arch (char *fname);
+int     cdr_arch_open (struct CDR_ARCH *a, char *fname);
+int     cdr_arch_open_rw (struct CDR_ARCH *a, char *fname);
+int     cdr_arch_close (struct CDR_ARCH *a);
+int     cdr_arch_pass (struct CDR_ARCH *a, long id, struct CDR_PASS *d);
+const unsigned char *cdr_arch_raw (struct CDR_ARCH *a, struct CDR_PASS *d);
+struct CDR *cdr_arch_load (struct CDR_ARCH *a, long id, struct CDR_HEAD *h, size_t *n);
+
+int     cdr_arch_create (struct CDR_ARCHW *w, char *fname, int append);
+long    cdr_arch_add (struct CDR_ARCHW *w, struct CDR_HEAD *h, struct CDR *p, size_t n);
+long    cdr_arch_put (struct CDR_ARCHW *w, const unsigned char *raw, size_t n);
+long    cdr_arch_copy (struct CDR_ARCHW *w, struct CDR_PASS *d, const unsigned char *raw);
+int     cdr_arch_finish (struct CDR_ARCHW *w);
+
+#endif /* cdr_arch_h */
@@ -28,10 +28,12 @@ struct CRYOSAT20HZ{	/* */
 	unsigned int	trackbits;	/* Useful flags to be defined as we go along; initially zero
 						1			      1 - record empty based on no time record
 						2			      2 - dry land idetermined from iwetdry.c
+						4                 3 - drange[1] is out of bounds (retrack -2)
+						8                 4 - second retrack (-2) failed least squares
 						1024             11 - standard deviation out of range (e.g. LRM 0.3 to 0.8)
-						2048             12 - drange is out of bounds
+						2048             12 - drange[0] is out of bounds
 						4096             13 - swh is out of range (e.g. LRM 1 to 10 m)
-						8192             14 - retrack failed least squares
+						8192             14 - first retrack failed least squares
 						16384            15 - amp out of range (e.g. LRM 50000 to 80000) */
 	unsigned int csum; 		/* computed sum of counts of power for all range gates */
 
@@ -66,4 +68,6 @@ struct CRYOSAT20HZ{	/* */
 	unsigned short int	wave[128];	/* Ku-band waveform data.  */
       /*unsigned short int	wave_s[64];	 S-band waveform data. Not available for CryoSAT */
 };
+#define CRYOSAT20HZ_LAYOUT 0x09cb25bbu     /* rec_layout(), see rec_file.h */
+
 #endif /* cryosat20hz_h */
@@ -0,0 +1,36 @@
+/* cvt_kernels.h
+   Batch unit conversions used by the ingest readers, with SSE2, AVX2 and
+   AVX-512 versions chosen at run time.  Every version gives bit for bit the
+   result of the scalar expression quoted with each function.
+*/
+#ifndef cvt_kernels_h
+#define cvt_kernels_h
+
+#include <stddef.h>
+
+#define CVT_SCALAR  0
+#define CVT_SSE2    1
+#define CVT_AVX2    2
+#define CVT_AVX512  3
+
+/* out = (int)floor(in/scale + .5), then out += 360000000 where negative if wrap */
+void    cvt_round (const int *in, int *out, size_t n, double scale, int wrap);
+
+/* out = (int)floor(in*a + b + .5); repacks fixed-point integers onto another grid */
+void    cvt_pack (const int *in, int *out, size_t n, double a, double b);
+
+/* out = (unsigned int) floor(0.5 + in*1.e-9*SOL/2.); two-way delay (ps) to one-way range (mm) */
+void    cvt_delay (const long long *in, unsigned int *out, size_t n);
+
+/* sec = floor(in), usec = floor(1000000.0 * (in - sec)); both = nan if in is NaN */
+void    cvt_time (const double *in, unsigned int *sec, unsigned int *usec, size_t n, unsigned int nan);
+
+/* sum[k] = sum of the ngate gates of waveform k, rows ngate apart */
+void    cvt_wave_sum (const unsigned short *wave, size_t ngate, unsigned int *sum, size_t n);
+
+/* Kernel set in use: the best the CPU supports, or CVT_SIMD=scalar|sse2|avx2|avx512 */
+int     cvt_level (void);
+int     cvt_set_level (int level);
+char    *cvt_level_name (int level);
+
+#endif /* cvt_kernels_h */
@@ -0,0 +1,33 @@
+/* fgrid.h
+   Float grids on a regular lat/lon lattice, as written by cdr2dov.  The
+   file is a struct FGRID_HEAD and then nplane planes, each ny rows of nx
+   floats from the south row to the north one and from west to east, in
+   host byte order like xover.h.  Node (i, j) is at lon west + i dx and lat
+   south + j dy; a node without a value is NaN.  The planes are written a
+   block of rows at a time at their place in the file, so a grid need
+   never be whole in memory.
+*/
+#ifndef fgrid_h
+#define fgrid_h
+
+#include <stddef.h>
+
+#define FGRID_MAGIC     "CDRGRID\n"
+#define FGRID_ENDIAN    0x01020304u
+#define FGRID_VERSION   1
+
+struct FGRID_HEAD {     /* 64 bytes */
+    char    magic[8];
+    unsigned int endian;    /* FGRID_ENDIAN as written */
+    unsigned int version;
+    int     nx, ny, nplane;
+    int     global;         /* 1 when lon wraps: node nx would be node 0 */
+    double  west, south;    /* deg, the first node */
+    double  dx, dy;         /* deg */
+};
+
+int     fgrid_create (char *fname, struct FGRID_HEAD *h);
+int     fgrid_put (int fd, struct FGRID_HEAD *h, int plane, int row0, int nrow, float *v);
+int     fgrid_close (int fd);
+
+#endif /* fgrid_h */
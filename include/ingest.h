@@ -0,0 +1,36 @@
+/* ingest.h
+   Shared front end of the stage 00 NetCDF readers.  Each mission program
+   (cryosat20hz, jason20hz, ...) describes its product in a struct MISSION
+   and hands argc/argv to ingest_main(), so every mission gets the same
+   command line, streaming windows, 1 Hz expansion and output modes.
+*/
+#ifndef ingest_h
+#define ingest_h
+
+#include <stddef.h>
+#include "ncfield.h"
+
+struct MISSION {
+    char    *prog;          /* program name, for messages */
+    char    *out;           /* name of the output structure, for the usage line */
+    unsigned int id;        /* REC_CRYOSAT, ... in rec_file.h */
+    unsigned int layout;    /* the struct header's layout constant; must equal rec_layout() of fields */
+    struct NC_FIELD *fields;
+    int     nfields;
+    size_t  recsize;        /* sizeof the output record */
+    size_t  scalar_size;    /* offsetof its wave[] member, which must be last; recsize if none */
+    size_t  lat, lon, surf; /* offsetof the int lat and lon and 2-byte surface flag, for the -o index */
+    char    *dim20;         /* dimension counting 20 Hz rows */
+    int     nsub;           /* records per dim20 row: 1, or 20/40 for [time][meas_ind] products */
+    char    *dim01;         /* dimension counting 1 Hz correction rows */
+    char    *time20;        /* 20 Hz and 1 Hz time variables, for matching corrections */
+    char    *time01;
+    /* Mission pass over the scalar members of records k0..k0+n-1 after
+       they are filled (trackbits etc.), or NULL */
+    void    (*finish) (char *scal, size_t scalar_size, size_t k0, size_t n);
+};
+
+int     ingest_main (struct MISSION *ms, int argc, char **argv);
+size_t  ingest_file (struct MISSION *ms, char *fname);
+
+#endif /* ingest_h */
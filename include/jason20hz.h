@@ -3,7 +3,17 @@
 Structure for Jason 1, Envisat and Cryosat data
 
 */
+#ifndef jason20hz_h
+#define jason20hz_h
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <netcdf.h>
+
+#define I4NaN 2147483647    /* If an int is set to this it means it is NaN */
+#define I2NaN 32767         /* If a short int is set to this it means it is NaN */
 #define SOL 299792458.0                 /* speed of light in vacuum */
 
 /* find center of mass correction */
@@ -20,10 +30,12 @@ struct JASON20HZ {	/* */
 	unsigned int	trackbits;	/* Useful flags to be defined as we go along; initially zero 
 						1	          1 - record empty based on no time or range record 
 						2	          2 - dry land idetermined from iwetdry.c 
+						4                 3 - drange[1] is out of bounds (retrack -2)
+						8                 4 - second retrack (-2) failed least squares
 						1024             11 - standard deviation out of range (e.g. LRM 0.3 to 0.8)
-						2048             12 - drange is out of bounds
+						2048             12 - drange[0] is out of bounds
 						4096             13 - swh is out of range (e.g. LRM 1 to 10 m)
-						8192             14 - retrack failed least squares
+						8192             14 - first retrack failed least squares
 						16384            15 - amp out of range (e.g. LRM 50000 to 80000) */
 	unsigned int csum; 		/* computed sum of counts of power for all range gates */
 
@@ -56,7 +68,10 @@ struct JASON20HZ {	/* */
 	short int	new_tide;	/* new total tide model from CSR4.0, mm  */
 
 	unsigned short int  wave[128];	/* Ku-band waveform data. Only the first 104 are used. */
-                                        /* Gate 32 is the track location and the gate spacing is is 0.4656  */
+                                        /* Gate 32 is the track location and the gate spacing is is 0.4684  */
       /*unsigned short int  wave_c[64];	 C-band waveform data. Not available for CryoSAT */
 };
 
+#define JASON20HZ_LAYOUT 0x54f6f922u     /* rec_layout(), see rec_file.h */
+
+#endif /* jason20hz_h */
@@ -0,0 +1,112 @@
+/* ncfield.h
+   Table-driven loading of NetCDF variables into arrays of fixed-layout
+   altimeter records (struct CRYOSAT20HZ and friends).  A mission describes
+   its schema once as an array of struct NC_FIELD; the engine resolves every
+   variable up front, reads each one once, and fills the records in fused
+   passes over cache-sized blocks.
+*/
+#ifndef ncfield_h
+#define ncfield_h
+
+#include <stddef.h>
+#include <netcdf.h>
+
+/* How a source value becomes a struct member */
+#define NCF_COPY    0   /* integer cast to the target type */
+#define NCF_ROUND   1   /* (int)floor(x/scale + .5) */
+#define NCF_LON     2   /* as NCF_ROUND, then negative longitudes wrapped to 0-360 deg (units 1e-6 deg) */
+#define NCF_TIME    3   /* double seconds split into whole seconds (offset) and microseconds (offset2) */
+#define NCF_DELAY   4   /* two-way window delay (ps) to one-way range (mm) */
+#define NCF_WAVE    5   /* waveform gates copied as is, their sum stored as unsigned int at offset2 */
+#define NCF_PACK    6   /* packed value x*scale_factor+add_offset repacked as (int)floor((value-base)/scale + .5) */
+#define NCF_FLAG    7   /* bit OR-ed into the target member where the source flag is nonzero */
+
+/* Target member types */
+#define NCF_U4      0   /* unsigned int */
+#define NCF_I4      1   /* int */
+#define NCF_U2      2   /* unsigned short int */
+#define NCF_I2      3   /* short int */
+
+/* Sample rate of the source variable */
+#define NCF_20HZ    0   /* one value (or vector) per record */
+#define NCF_01HZ    1   /* one value per 1 Hz correction record, expanded to 20 Hz through the NCF_MAP */
+#define NCF_01FLAG  2   /* as NCF_01HZ but a flag or class: never interpolated, linear maps use the nearest row */
+#define NCF_IS_01(rate) ((rate) != NCF_20HZ)
+
+/* How 20 Hz records are matched to 1 Hz rows */
+#define NCF_MAP_INDEX   0   /* legacy: row floor((k+1)/20.), assumes exactly 20 records per row;
+                               k/nsub for files stored as [row][nsub] */
+#define NCF_MAP_NEAREST 1   /* row nearest in time */
+#define NCF_MAP_LINEAR  2   /* linear in time between the bracketing rows */
+#define NCF_MAP_MAXGAP  2.  /* seconds; linear maps do not bridge 1 Hz gaps wider than this */
+
+#define NCF_BLOCK   256 /* records converted per fused pass; keeps a block in L2 */
+
+struct NC_FIELD {
+    char    *name;      /* NetCDF variable name */
+    int     conv;       /* NCF_COPY, NCF_ROUND, ... */
+    int     type;       /* NCF_U4, NCF_I4, NCF_U2, NCF_I2 */
+    size_t  offset;     /* offsetof the target member */
+    size_t  offset2;    /* second target for NCF_TIME (microsec) and NCF_WAVE (csum) */
+    int     count;      /* values per record in the struct: 1, 3, 128 ... */
+    int     rate;       /* NCF_20HZ, NCF_01HZ or NCF_01FLAG */
+    double  scale;      /* NCF_ROUND/NCF_LON divisor, source units per target unit */
+    int     nan;        /* stored for NaN or _FillValue source values (I4NaN, I2NaN), 0 for none */
+    int     use;        /* 0 to skip this field; its members are left zero */
+    int     bit;        /* NCF_FLAG: the bit to set */
+    double  base;       /* NCF_PACK: value stored as 0, e.g. 700000 m for S3 heights */
+};
+
+/* One field resolved against an open file */
+struct NCF_VAR {
+    struct NC_FIELD *f;
+    int     varid;
+    int     ndims;
+    nc_type xtype;      /* external type as stored in the file */
+    size_t  xsize;      /* bytes per value */
+    size_t  ncount;     /* values per record in the file, <= f->count */
+    int     nsub;       /* records per leading row in the file: 1, or 20 for [time][meas_ind] layouts */
+    int     has_fill;   /* f->nan is set and the variable has a _FillValue */
+    int     any_fill;   /* the variable has a _FillValue, whatever f->nan */
+    double  fill;
+    double  pa, pb;     /* NCF_PACK: target = floor(raw*pa + pb + .5), from the file's packing */
+    int     alias;      /* index of an earlier var with the same name, or -1 */
+    int     plane;      /* NCF_WAVE only: col is an unsigned short waveform plane
+                           loaded in place, and wave[] in the records is not written */
+    int     fresh;      /* col already holds this window, read by ncf_map_window() */
+    size_t  row0;       /* first 20 Hz or 1 Hz row held in col */
+    size_t  nrow;       /* number of rows held in col */
+    size_t  cap;        /* bytes allocated for col */
+    char    *col;       /* raw values as read from the file */
+};
+
+/* 20 Hz -> 1 Hz mapping, built once per window and shared by every 1 Hz field */
+struct NCF_MAP {
+    int     mode;       /* NCF_MAP_INDEX, NCF_MAP_NEAREST or NCF_MAP_LINEAR */
+    int     nsub;       /* 20 Hz records per row of the 20 Hz time variable */
+    double  *t01;       /* 1 Hz times for the whole file */
+    size_t  n01;
+    double  *t20;       /* 20 Hz times for the window, when not read into the table's time column */
+    size_t  *row;       /* per record: nearest 1 Hz row, or the row at or before it for linear */
+    double  *w;         /* per record: linear weight of row+1, 0 otherwise */
+    size_t  cap;        /* records allocated in t20, row and w */
+    size_t  k0, n;      /* the window */
+    size_t  j0, j1;     /* first and last 1 Hz rows the window refers to */
+};
+
+struct NCF_VAR *ncf_resolve (int ncfid, char *fname, struct NC_FIELD *tab, int ntab, int nsub);
+int     ncf_load (int ncfid, char *fname, struct NCF_VAR *v, int ntab, size_t k0, size_t n20, size_t j0, size_t n01);
+int     ncf_load_var (int ncfid, char *fname, struct NCF_VAR *v, size_t k0, size_t n20, size_t j0, size_t n01);
+void    ncf_fill (struct NCF_VAR *v, int ntab, struct NCF_MAP *map, void *rec, size_t recsize, size_t k0, size_t n20);
+int     ncf_use_plane (struct NCF_VAR *v, int ntab);
+unsigned short *ncf_plane (struct NCF_VAR *v, int ntab);
+size_t  ncf_recbytes (struct NCF_VAR *v, int ntab);
+void    ncf_free (struct NCF_VAR *v, int ntab);
+int     ncf_select (struct NC_FIELD *tab, int ntab, char *list);
+
+int     ncf_map_open (int ncfid, char *fname, struct NCF_MAP *map, int mode, char *t01name, size_t n01, int nsub);
+int     ncf_map_window (int ncfid, char *fname, struct NCF_MAP *map, char *t20name, struct NCF_VAR *tv, size_t k0, size_t n);
+void    ncf_map_free (struct NCF_MAP *map);
+int     ncf_map_mode (char *name);
+
+#endif /* ncfield_h */
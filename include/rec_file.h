@@ -0,0 +1,106 @@
+/* rec_file.h
+   Self-describing container for the fixed-size records written by the
+   stage 00 readers.  A REC_HEAD, padded to REC_BODY bytes, is followed by
+   nrec records of recsize bytes, so the body starts page aligned and can
+   be mmap()ed and used as an array of the mission's struct in place.
+
+   The header says which mission and struct the records are, and carries a
+   hash of the struct layout, so a tool built against a different version
+   of the struct (or on a machine of the other byte order) refuses the file
+   instead of reading garbage.  Each mission header defines the hash its
+   reader writes as <STRUCT>_LAYOUT; change it with the struct or the
+   reader's field table, so that tools built against the old layout refuse
+   the new records.
+
+   With REC_ZWAVE in the header flags each record is stored as its bytes
+   before wave[] followed by the waveform coded with wave_codec.h, so the
+   records are no longer a fixed size: read and write them with rec_get()
+   and rec_put(), which hand back and take whole structs either way.
+   With REC_THIN each record is stored only up to wave[], so the stages
+   after retracking read a third of the bytes; rec_get() hands the records
+   back whole with the waveform zeroed, and rec_open() maps them at
+   REC_FILE.stride.
+
+   retrack sets REC_FIT1 once it has filled the retracker members' [0]
+   slots, and retrack -2 REC_FIT2 for the [1] slots too, so that stages
+   that use drange can refuse records whose range was never retracked.
+*/
+#ifndef rec_file_h
+#define rec_file_h
+
+#include <stdio.h>
+#include <stddef.h>
+#include "ncfield.h"
+
+#define REC_MAGIC   "ALTREC\r\n"    /* \r\n catches text-mode mangling */
+#define REC_ENDIAN  0x01020304u
+#define REC_VERSION 3               /* 3 added wave, ngate and flags; a version 2 file reads as 3 without flags */
+#define REC_BODY    4096            /* records start here; one page */
+
+/* Mission IDs */
+#define REC_ANY     0               /* rec_open: accept any mission */
+#define REC_CRYOSAT 1               /* struct CRYOSAT20HZ */
+#define REC_JASON   2               /* struct JASON20HZ */
+#define REC_ALTIKA  3               /* struct SARAL40HZ */
+#define REC_S3AB    4               /* struct S3AB20HZ */
+
+/* Header flags */
+#define REC_ZWAVE   1               /* waveforms coded by wave_codec.h */
+#define REC_THIN    2               /* no waveforms: records stored up to wave[] only */
+#define REC_FIT1    4               /* retracker slots [0] filled by retrack */
+#define REC_FIT2    8               /* retracker slots [1] filled by retrack -2 */
+#define REC_STORE   (REC_ZWAVE | REC_THIN)  /* the flags that say how records are stored */
+
+/* Where the members the header and index summarise sit in a record */
+struct REC_KEYS {
+    unsigned int sec, usec;     /* unsigned int seconds since 2000 and microseconds */
+    unsigned int lat, lon;      /* int, 1e-6 deg */
+    unsigned int surf;          /* 2-byte surface flag */
+    unsigned int nan;           /* value of sec, lat and lon when missing */
+};
+
+struct REC_HEAD {       /* 88 bytes */
+    char    magic[8];
+    unsigned int endian;    /* REC_ENDIAN as written */
+    unsigned int version;   /* REC_VERSION */
+    unsigned int mission;   /* REC_CRYOSAT, ... */
+    unsigned int recsize;   /* bytes per record, sizeof the struct */
+    unsigned int layout;    /* rec_layout() of the mission's field table */
+    unsigned int body;      /* byte offset of the first record */
+    long long nrec;         /* number of records */
+    double  tmin, tmax;     /* first and last record time, seconds since 2000; 0 if none */
+    struct REC_KEYS keys;   /* so mission-independent tools can find time and position */
+    unsigned short wave;    /* offsetof wave[], the last member; 0 if none */
+    unsigned short ngate;   /* gates in wave[] */
+    unsigned int flags;     /* REC_ZWAVE or REC_THIN, and REC_FIT1 and REC_FIT2 */
+};
+
+/* An open container, with its records mapped read-only */
+struct REC_FILE {
+    struct REC_HEAD h;
+    int     fd;
+    void    *map;
+    size_t  maplen;
+    size_t  stride;         /* bytes per stored record: h.recsize, or h.wave if REC_THIN */
+    char    *rec;           /* record k is rec + k * stride */
+};
+
+/* State of rec_cut() while it splits a record stream into passes */
+struct REC_CUT {
+    int     nvalid;         /* records with time and position in this pass */
+    int     asc;            /* 1 ascending, 0 descending, -1 not known yet */
+    int     lat;            /* latest valid latitude, 1e-6 deg */
+    double  t;              /* latest valid time, seconds since 2000 */
+};
+
+unsigned int rec_layout (struct NC_FIELD *tab, int ntab, size_t recsize);
+int     rec_write_head (FILE *fp, struct REC_HEAD *h);
+int     rec_finish (FILE *fp, char *idxname);
+int     rec_open (struct REC_FILE *rf, char *fname, unsigned int mission, size_t recsize, unsigned int layout);
+FILE    *rec_stream (char *fname, struct REC_HEAD *h, unsigned int mission, size_t recsize, unsigned int layout);
+void    rec_close (struct REC_FILE *rf);
+size_t  rec_get (FILE *fp, struct REC_HEAD *h, char *rec, size_t n);
+size_t  rec_put (FILE *fp, struct REC_HEAD *h, char *rec, size_t n);
+int     rec_cut (struct REC_CUT *c, struct REC_HEAD *h, char *rec, double gap);
+
+#endif /* rec_file_h */
@@ -0,0 +1,67 @@
+/* rec_index.h
+   Block index written beside a record container (file.rec.idx for
+   file.rec).  For every REC_IXBLOCK records it keeps the time range, the
+   lat/lon bounding box and a histogram of the surface flag, so a query for
+   one region, week or surface type reads the small index and then touches
+   only the blocks of the container that can match.
+*/
+#ifndef rec_index_h
+#define rec_index_h
+
+#include <stdio.h>
+#include "rec_file.h"
+
+#define REC_IXMAGIC "ALTIDX\r\n"
+#define REC_IXBLOCK 4096            /* records per block */
+#define REC_NSURF   8               /* surface flag histogram bins; flags >= 7 count in the last */
+
+struct REC_INDEX {      /* 72 bytes, then nblock struct REC_BLOCK */
+    char    magic[8];
+    unsigned int endian;    /* REC_ENDIAN */
+    unsigned int version;   /* REC_VERSION */
+    unsigned int mission;   /* as in the container header */
+    unsigned int layout;
+    unsigned int recsize;
+    unsigned int block;     /* records per block */
+    unsigned int nblock;
+    struct REC_KEYS keys;   /* where time, lat, lon and surf are in a record */
+    unsigned int spare;
+    long long nrec;
+};
+
+struct REC_BLOCK {      /* 72 bytes */
+    double  tmin, tmax;     /* seconds since 2000, over records with a time */
+    int     latmin, latmax; /* 1e-6 deg, over records with a position */
+    int     lonmin, lonmax; /* 1e-6 deg as stored (0 to 360 or -180 to 180) */
+    unsigned int nsurf[REC_NSURF];
+    unsigned int nvalid;    /* records with time and position; 0 leaves the ranges unset */
+    unsigned int spare;
+};
+
+/* Selection: each part applies only if its flag is set */
+struct REC_QUERY {
+    int     use_t;
+    double  t0, t1;         /* seconds since 2000 */
+    int     use_r;
+    double  west, east, south, north;   /* deg; west > east wraps through 0 */
+    unsigned int surf;      /* bit f set to accept surface flag f; 0 for any */
+};
+
+/* Writer state, used by rec_finish() */
+struct REC_IXW {
+    FILE    *fp;
+    struct REC_INDEX h;
+    struct REC_BLOCK b;
+    unsigned int nb;        /* records in b so far */
+    int     err;            /* a write failed */
+};
+
+int     rec_index_open (struct REC_IXW *ix, char *idxname, struct REC_HEAD *head);
+void    rec_index_add (struct REC_IXW *ix, char *rec);
+int     rec_index_close (struct REC_IXW *ix);
+
+struct REC_BLOCK *rec_index_read (char *idxname, struct REC_HEAD *head, struct REC_INDEX *h);
+int     rec_block_match (struct REC_BLOCK *b, struct REC_QUERY *q);
+int     rec_match (char *rec, struct REC_KEYS *keys, struct REC_QUERY *q);
+
+#endif /* rec_index_h */
@@ -0,0 +1,15 @@
+/* run_parallel.h
+   Ordered multi-process ingest: run a per-file handler in up to njobs worker
+   processes and copy each worker's stdout to our stdout in argument order.
+*/
+#ifndef run_parallel_h
+#define run_parallel_h
+
+#include <stddef.h>
+
+/* A per-file handler writes its records to stdout and returns the number written. */
+typedef size_t (*file_handler) (char *fname);
+
+size_t run_parallel (int nfiles, char **fnames, int njobs, file_handler handle);
+
+#endif /* run_parallel_h */
@@ -54,4 +54,6 @@ struct S3AB20HZ {
     short int   sparei2[3];  /* Round out structure to 60 bytes total size */
 };
 
+#define S3AB20HZ_LAYOUT 0x7a9bb983u     /* rec_layout(), see rec_file.h */
+
 #endif /* s3ab20hz_h */
@@ -0,0 +1,27 @@
+/* wave_codec.h
+   Lossless code for one waveform of unsigned short gates, used for the
+   compressed record containers of rec_file.h (REC_ZWAVE).
+
+   Gates are replaced by their difference from the gate before (mod 2^16,
+   so any waveform round-trips), zigzag mapped so small steps either way
+   are small numbers, and stored in blocks of WAVE_BGATE gates at 0, 4, 8
+   or 16 bits a gate, whichever is the least that holds the block.  The
+   code starts with the 2-bit width class of every block, four to a byte,
+   so its length is known from those bytes alone.  Quiet noise floors pack
+   at 4 bits and the all-zero gates past the last one in use (Jason uses
+   104 of 128) at 0; the leading edge and a noisy peak need 8 or 16.
+*/
+#ifndef wave_codec_h
+#define wave_codec_h
+
+#include <stddef.h>
+
+#define WAVE_BGATE  16      /* gates per block */
+#define WAVE_NCLASS(ngate)  (((ngate) + 4 * WAVE_BGATE - 1) / (4 * WAVE_BGATE))    /* class bytes */
+#define WAVE_MAXCODE(ngate) (WAVE_NCLASS (ngate) + 2 * (ngate))                    /* longest code */
+
+size_t  wave_encode (const unsigned short *wave, int ngate, unsigned char *code);
+size_t  wave_code_len (const unsigned char *code, int ngate);
+size_t  wave_decode (const unsigned char *code, int ngate, unsigned short *wave);
+
+#endif /* wave_codec_h */
@@ -0,0 +1,17 @@
+/* wave_plane.h
+   Structure-of-arrays form of the 20 Hz records: the scalar members of each
+   record (everything before wave[], which is the last member of
+   CRYOSAT20HZ, JASON20HZ and SARAL40HZ) packed in one array, and the
+   waveforms in a separate contiguous plane of ngate gates per record.
+   The plane is how ingest holds a window in memory; what it writes is
+   always whole records, interleaved again or coded.
+*/
+#ifndef wave_plane_h
+#define wave_plane_h
+
+#include <stdio.h>
+
+size_t  write_interleaved (FILE *fp, char *scalars, size_t scalar_size, unsigned short *plane, int ngate, size_t n, size_t recsize);
+size_t  write_coded (FILE *fp, char *scalars, size_t scalar_size, unsigned short *plane, int ngate, size_t n, int mgate);
+
+#endif /* wave_plane_h */
@@ -0,0 +1,45 @@
+/* wdr.h
+   Waveform data records (WDR): the 20 Hz records of a rec_file.h
+   container once retrack has filled their drange, seen as along-track sea
+   surface heights for wdr2cdr.  A struct WDR_MISSION says where a mission
+   keeps the members that make up the height; wdr_point() turns one record
+   into a struct WDR_POINT, or refuses it.
+
+     sh  = alt - (range + drange[slot] + cor)
+     cor = hdry + hwet + hiono + hdopp            media, added to range
+         + hotide [+ hltide] + hstide + hptide    tides, heights
+         + hinvb                                  inverse barometer
+
+   hltide is only added for missions whose hotide leaves out the load tide
+   (CryoSat); the Jason and AltiKa ocean tides already include it.
+*/
+#ifndef wdr_h
+#define wdr_h
+
+#include <stddef.h>
+#include "rec_file.h"
+
+/* trackbits that drop a record: for any slot, and for the retracker slot
+   asked for (its fit failed or its drange is out of bounds) */
+#define WDR_BADBITS (1 | 2 | 1024 | 4096 | 16384)
+#define WDR_FITBITS(slot) ((slot) ? 4 | 8 : 2048 | 8192)
+
+struct WDR_MISSION {
+    unsigned int mission, layout;
+    size_t  recsize;
+    size_t  alt, range, trackbits, surf, drange;
+    size_t  hotide, hltide, hstide, hptide, hiono, hwet, hdry, hinvb, hdopp;
+    int     load;           /* 1 if hotide leaves out the load tide */
+};
+
+struct WDR_POINT {
+    double  t;              /* seconds since 2000 */
+    double  lat, lon;       /* degrees; lon as stored */
+    double  h;              /* sea surface height above the ellipsoid, m */
+    double  cor;            /* corrections taken out of h, m */
+};
+
+struct WDR_MISSION *wdr_mission (struct REC_HEAD *h);
+int     wdr_point (struct WDR_MISSION *m, struct REC_HEAD *h, char *rec, int slot, struct WDR_POINT *p);
+
+#endif /* wdr_h */
@@ -0,0 +1,33 @@
+/* xover.h
+   Crossover points between the ascending and descending passes of a CDR
+   archive (cdr_arch.h), as found by xover and used by xadjust.  The file
+   is a struct XO_HEAD and then n struct XOVER, in host byte order like
+   the record containers (rec_file.h), sorted by pass ids and then time.
+*/
+#ifndef xover_h
+#define xover_h
+
+#include <stddef.h>
+
+#define XO_MAGIC    "CDRXOV\r\n"
+#define XO_ENDIAN   0x01020304u
+#define XO_VERSION  1
+
+struct XO_HEAD {        /* 24 bytes */
+    char    magic[8];
+    unsigned int endian;    /* XO_ENDIAN as written */
+    unsigned int version;
+    long long n;
+};
+
+struct XOVER {          /* 40 bytes */
+    double  ta, tb;         /* time of the crossing on each pass, seconds since 2000 */
+    float   lat, lon;       /* deg, lon 0 to 360 */
+    float   sha, shb;       /* sh interpolated to the crossing on each pass, m */
+    int     ida, idb;       /* archive pass ids: a ascending, b descending */
+};
+
+int     xo_write (char *fname, struct XOVER *x, size_t n);
+struct XOVER *xo_read (char *fname, size_t *n);
+
+#endif /* xover_h */
@@ -0,0 +1,227 @@
+/*  along.c
+
+ Along-track filter of along.h.  Sums are taken in units of T about each
+ output time, so the 2x2 normal equations of the line stay well scaled
+ whatever the absolute time.  Both versions end in the same solve(), so
+ they can only differ by the sums.
+ */
+
+#define _XOPEN_SOURCE 600   /* M_PI */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "along.h"
+
+#define NY          4           /* channels: h, lat, lon, cor */
+#define MINW        3.          /* least weight sum, about points at |tau| < T */
+#define MAXMEAN     0.25        /* largest weighted mean of tau, T */
+#define MINVAR      1.          /* least weighted variance of tau, T^2; 4 for dense even data */
+#define VMIN        1000.       /* least ground speed, m/s */
+#define REARTH      6371000.    /* mean radius, m */
+#define D2R         (M_PI / 180.)
+#define FAR         50.         /* T; a sweep's sums are dropped past here, exp(-50) 50^3 < 1e-16 */
+
+struct MOM {
+    double  s0, s1, s2;         /* sum w, w x, w x^2; x = tau / T */
+    double  y[NY], xy[NY];      /* sum w y, w x y */
+};
+
+/* Sums of along_recursive() over the points behind the sweep, a = distance / T */
+struct SWEEP {
+    double  g[4];               /* sum exp(-a) a^m, m = 0..3 */
+    double  y[NY][3];           /* sum exp(-a) a^m y, m = 0..2 */
+};
+
+static void unwrap (struct WDR_POINT *p, size_t n) {
+
+    /* Make lon continuous along the pass, so a pass over 0 or 180 E filters */
+
+    size_t  i;
+
+    for (i = 1; i < n; i++) {
+        while (p[i].lon - p[i-1].lon > 180.) p[i].lon -= 360.;
+        while (p[i].lon - p[i-1].lon < -180.) p[i].lon += 360.;
+    }
+}
+
+static int solve (struct MOM *m, double tc, double tscale, struct CDR *c) {
+
+    /* The CDR point at tc from its sums; 1 if there is none */
+
+    double  det, mean, a[NY], b[NY], vn, ve, v, lon;
+    int     j;
+
+    if (m->s0 < MINW) return (1);
+    mean = m->s1 / m->s0;
+    if (fabs (mean) > MAXMEAN || m->s2 / m->s0 - mean * mean < MINVAR) return (1);
+    det = m->s0 * m->s2 - m->s1 * m->s1;
+    for (j = 0; j < NY; j++) {
+        a[j] = (m->s2 * m->y[j] - m->s1 * m->xy[j]) / det;
+        b[j] = (m->s0 * m->xy[j] - m->s1 * m->y[j]) / (det * tscale);     /* per second */
+    }
+    vn = REARTH * D2R * b[1];
+    ve = REARTH * D2R * b[2] * cos (D2R * a[1]);
+    v = sqrt (vn * vn + ve * ve);
+    if (v < VMIN) return (1);
+    lon = fmod (a[2], 360.);
+    if (lon < 0.) lon += 360.;
+    c->time_1 = tc;
+    c->lat = (float)a[1];
+    c->lon = (float)lon;
+    c->sh = (float)a[0];
+    c->dsh = (float)(1.e6 * b[0] / v);
+    c->cor = (float)a[3];
+    return (0);
+}
+
+size_t along_nout (struct WDR_POINT *p, size_t n, double dt) {
+
+    /* Most points a pass can give: the multiples of dt inside its time span */
+
+    if (n == 0) return (0);
+    return ((size_t)(floor (p[n-1].t / dt) - ceil (p[0].t / dt) + 1.));
+}
+
+size_t along_direct (struct WDR_POINT *p, size_t n, double tscale, double dt, struct CDR *out) {
+
+    /* Filter the n points of a pass, in time order, into out[along_nout()]
+       by summing over each point's window in turn: O(n x window).  lon is
+       unwrapped in place.  Returns the points written. */
+
+    struct MOM m;
+    double  k, k1, tc, x, w, y[NY];
+    size_t  i, i0 = 0, nout = 0;
+    int     j;
+
+    if (n == 0) return (0);
+    unwrap (p, n);
+    k1 = floor (p[n-1].t / dt);
+    for (k = ceil (p[0].t / dt); k <= k1; k++) {
+        tc = k * dt;
+        while (i0 < n && p[i0].t < tc - ALONG_CUT * tscale) i0++;
+        m.s0 = m.s1 = m.s2 = 0.;
+        for (j = 0; j < NY; j++) m.y[j] = m.xy[j] = 0.;
+        for (i = i0; i < n && p[i].t <= tc + ALONG_CUT * tscale; i++) {
+            x = (p[i].t - tc) / tscale;
+            w = (1. + fabs (x)) * exp (-fabs (x));
+            y[0] = p[i].h;
+            y[1] = p[i].lat;
+            y[2] = p[i].lon;
+            y[3] = p[i].cor;
+            m.s0 += w;
+            m.s1 += w * x;
+            m.s2 += w * x * x;
+            for (j = 0; j < NY; j++) {
+                m.y[j] += w * y[j];
+                m.xy[j] += w * x * y[j];
+            }
+        }
+        if (solve (&m, tc, tscale, &out[nout]) == 0) nout++;
+    }
+    return (nout);
+}
+
+static void sweep_move (struct SWEEP *s, double d) {
+
+    /* Carry the sums d further from their points: with a -> a + d,
+       exp(-a) a^m becomes exp(-d) exp(-a) sum_l C(m,l) d^(m-l) a^l.
+       Updating from the highest m down uses only the old lower sums. */
+
+    double  e, d2, d3;
+    int     j;
+
+    if (d <= 0.) return;
+    if (d > FAR) {
+        memset (s, 0, sizeof (*s));
+        return;
+    }
+    e = exp (-d);
+    d2 = d * d;
+    d3 = d2 * d;
+    s->g[3] = e * (s->g[3] + 3. * d * s->g[2] + 3. * d2 * s->g[1] + d3 * s->g[0]);
+    s->g[2] = e * (s->g[2] + 2. * d * s->g[1] + d2 * s->g[0]);
+    s->g[1] = e * (s->g[1] + d * s->g[0]);
+    s->g[0] = e * s->g[0];
+    for (j = 0; j < NY; j++) {
+        s->y[j][2] = e * (s->y[j][2] + 2. * d * s->y[j][1] + d2 * s->y[j][0]);
+        s->y[j][1] = e * (s->y[j][1] + d * s->y[j][0]);
+        s->y[j][0] = e * s->y[j][0];
+    }
+}
+
+static void sweep_add (struct SWEEP *s, struct WDR_POINT *p) {
+
+    /* A point at the sweep's time: a = 0, so only the m = 0 sums change */
+
+    s->g[0] += 1.;
+    s->y[0][0] += p->h;
+    s->y[1][0] += p->lat;
+    s->y[2][0] += p->lon;
+    s->y[3][0] += p->cor;
+}
+
+static void sweep_take (struct SWEEP *s, double side, struct MOM *m) {
+
+    /* Add the sweep's sums to an output point's, for points on one side:
+       x = side * a and w = (1 + a) exp(-a) */
+
+    int     j;
+
+    m->s0 += s->g[0] + s->g[1];
+    m->s1 += side * (s->g[1] + s->g[2]);
+    m->s2 += s->g[2] + s->g[3];
+    for (j = 0; j < NY; j++) {
+        m->y[j] += s->y[j][0] + s->y[j][1];
+        m->xy[j] += side * (s->y[j][1] + s->y[j][2]);
+    }
+}
+
+size_t along_recursive (struct WDR_POINT *p, size_t n, double tscale, double dt, struct CDR *out) {
+
+    /* Filter as along_direct(), in O(n + points out).  A backward sweep
+       leaves each output point the sums over the points after it, and a
+       forward sweep adds those at or before it and solves. */
+
+    struct SWEEP s;
+    struct MOM *mom;
+    double  k0, tc, tcur;
+    size_t  i, c, nmax, nout = 0;
+
+    if (n == 0) return (0);
+    nmax = along_nout (p, n, dt);
+    if ((mom = (struct MOM *) calloc (nmax + 1, sizeof (struct MOM))) == NULL) return (along_direct (p, n, tscale, dt, out));
+    unwrap (p, n);
+    k0 = ceil (p[0].t / dt);
+
+    memset (&s, 0, sizeof (s));
+    tcur = p[n-1].t;
+    for (i = n, c = nmax; c-- > 0; ) {
+        tc = (k0 + c) * dt;
+        while (i > 0 && p[i-1].t > tc) {
+            sweep_move (&s, (tcur - p[i-1].t) / tscale);
+            tcur = p[--i].t;
+            sweep_add (&s, &p[i]);
+        }
+        sweep_move (&s, (tcur - tc) / tscale);
+        tcur = tc;
+        sweep_take (&s, 1., &mom[c]);
+    }
+
+    memset (&s, 0, sizeof (s));
+    tcur = p[0].t;
+    for (i = 0, c = 0; c < nmax; c++) {
+        tc = (k0 + c) * dt;
+        while (i < n && p[i].t <= tc) {
+            sweep_move (&s, (p[i].t - tcur) / tscale);
+            tcur = p[i].t;
+            sweep_add (&s, &p[i++]);
+        }
+        sweep_move (&s, (tc - tcur) / tscale);
+        tcur = tc;
+        sweep_take (&s, -1., &mom[c]);
+        if (solve (&mom[c], tc, tscale, &out[nout]) == 0) nout++;
+    }
+    free ( (void *)mom);
+    return (nout);
+}
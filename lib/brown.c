@@ -0,0 +1,195 @@
+/*  brown.c
+
+ Brown-type waveform model, its analytic Jacobian, and a Levenberg-Marquardt
+ least squares fit of it to one waveform.  See brown.h for the model.
+
+ The fit works on at most BROWN_NPAR parameters, so each iteration is one
+ pass over the gates to build the normal equations and a Cholesky solve of
+ a 5x5 system; everything lives on the stack and nothing is shared, so any
+ number of threads may fit different waveforms at once.  The model and
+ Jacobian come from the kernel chosen in brown_kernels.c; the Jacobian is
+ stored a parameter row at a time so the vector kernels can write it and
+ the normal equations are dot products of rows.
+ */
+
+#define _XOPEN_SOURCE 600   /* erf() */
+
+#include <math.h>
+#include <string.h>
+#include "brown.h"
+#include "brown_kernels.h"
+
+#define MAXGATE     256
+#define MAXITER     30
+#define LAMBDA0     1.e-3
+#define LAMBDAMAX   1.e10
+#define TOL         1.e-7       /* relative change in chi^2 that counts as converged */
+#define TOLF        1.e-5       /* the same, for the float kernel's rounding of the model */
+#define SIGMAMIN    0.05        /* gates; a narrower edge is not resolved */
+
+void brown_model (double *p, int ngate, double *m, double *jac) {
+
+    /* Model counts m[ngate] at p, and if jac is not NULL its derivatives
+       jac[k*ngate + i] = dm(i)/dp[k].  This is the BROWN_REF kernel of
+       brown_kernels.h, which the fast kernels are checked against. */
+
+    double  t0 = p[BROWN_T0], s = p[BROWN_SIGMA], a = p[BROWN_AMP], q = p[BROWN_DECAY];
+    double  r2s = 1. / (M_SQRT2 * s), qs2 = q * s * s;
+    double  x, u, e, f, g, h;
+    int     i;
+
+    for (i = 0; i < ngate; i++) {
+        x = i - t0;
+        u = (x - qs2) * r2s;
+        e = exp (-q * (x - 0.5 * qs2));
+        f = 1. + erf (u);
+        m[i] = p[BROWN_NOISE] + 0.5 * a * e * f;
+        if (jac == NULL) continue;
+        g = M_2_SQRTPI * exp (-u * u);     /* d erf(u) / du */
+        h = 0.5 * a * e;
+        jac[BROWN_T0*ngate+i] = h * (q * f - g * r2s);
+        jac[BROWN_SIGMA*ngate+i] = h * (q * q * s * f - g * (x * r2s / s + q * M_SQRT1_2));
+        jac[BROWN_AMP*ngate+i] = 0.5 * e * f;
+        jac[BROWN_NOISE*ngate+i] = 1.;
+        jac[BROWN_DECAY*ngate+i] = h * ((qs2 - x) * f - g * s * M_SQRT1_2);
+    }
+}
+
+void brown_guess (unsigned short *wave, int ngate, double *p) {
+
+    /* Starting values from the waveform itself: noise from the early gates,
+       amplitude from the peak, t0 where the counts first reach half way */
+
+    double  noise = 0., peak = 0., half;
+    int     i, n = 0;
+
+    for (i = 2; i < 10 && i < ngate; i++, n++) noise += wave[i];
+    noise = (n) ? noise / n : 0.;
+    for (i = 0; i < ngate; i++) if (wave[i] > peak) peak = wave[i];
+    if (peak <= noise) peak = noise + 1.;
+    half = 0.5 * (noise + peak);
+    for (i = 1; i < ngate - 1 && wave[i] < half; i++);
+    p[BROWN_T0] = (wave[i] > wave[i-1]) ? i - (wave[i] - half) / (wave[i] - wave[i-1]) : i;
+    p[BROWN_SIGMA] = 2.;
+    p[BROWN_AMP] = peak - noise;
+    p[BROWN_NOISE] = noise;
+    p[BROWN_DECAY] = 0.;
+}
+
+static int cholesky_solve (double *a, double *b, int n) {
+
+    /* Solve a x = b in place for symmetric positive definite a[n*n]; x -> b */
+
+    int     i, j, k;
+    double  s;
+
+    for (j = 0; j < n; j++) {
+        for (s = a[j*n+j], k = 0; k < j; k++) s -= a[j*n+k] * a[j*n+k];
+        if (!(s > 0.)) return (1);
+        a[j*n+j] = sqrt (s);
+        for (i = j + 1; i < n; i++) {
+            for (s = a[i*n+j], k = 0; k < j; k++) s -= a[i*n+k] * a[j*n+k];
+            a[i*n+j] = s / a[j*n+j];
+        }
+    }
+    for (i = 0; i < n; i++) {
+        for (s = b[i], k = 0; k < i; k++) s -= a[i*n+k] * b[k];
+        b[i] = s / a[i*n+i];
+    }
+    for (i = n - 1; i >= 0; i--) {
+        for (s = b[i], k = i + 1; k < n; k++) s -= a[k*n+i] * b[k];
+        b[i] = s / a[i*n+i];
+    }
+    return (0);
+}
+
+static double misfit (double *y, double *m, int ngate) {
+
+    int     i;
+    double  r, chi = 0.;
+
+    for (i = 0; i < ngate; i++) {
+        r = y[i] - m[i];
+        chi += r * r;
+    }
+    return (chi);
+}
+
+int brown_fit (unsigned short *wave, int ngate, double *p, int free, struct BROWN_STAT *st) {
+
+    /* Fit the model to wave[ngate] starting from p, adjusting the parameters
+       whose bits are set in free and holding the others.  On return p holds
+       the fit.  Returns 0 on success, 1 if the fit failed or is not a
+       plausible waveform (p is then undefined). */
+
+    double  y[MAXGATE], m[MAXGATE], jac[MAXGATE*BROWN_NPAR];
+    double  jtj[BROWN_NPAR*BROWN_NPAR], jtr[BROWN_NPAR], a[BROWN_NPAR*BROWN_NPAR], dp[BROWN_NPAR], pt[BROWN_NPAR];
+    double  r[MAXGATE], chi, chit, lambda = LAMBDA0, s, *ja, *jb, tol;
+    int     idx[BROWN_NPAR], nf = 0, i, j, k, iter, done = 0;
+
+    if (ngate > MAXGATE || ngate < 2 * BROWN_NPAR) return (1);
+    for (k = 0; k < BROWN_NPAR; k++) if (free & (1 << k)) idx[nf++] = k;
+    for (i = 0; i < ngate; i++) y[i] = wave[i];
+    tol = (brown_kernel () == BROWN_FLOAT) ? TOLF : TOL;
+
+    brown_eval (p, ngate, m, jac);
+    chi = misfit (y, m, ngate);
+    for (iter = 0; iter < MAXITER && !done; iter++) {
+
+        /* normal equations over the free parameters */
+        for (i = 0; i < ngate; i++) r[i] = y[i] - m[i];
+        for (j = 0; j < nf; j++) {
+            ja = jac + idx[j] * ngate;
+            for (s = 0., i = 0; i < ngate; i++) s += ja[i] * r[i];
+            jtr[j] = s;
+            for (k = 0; k <= j; k++) {
+                jb = jac + idx[k] * ngate;
+                for (s = 0., i = 0; i < ngate; i++) s += ja[i] * jb[i];
+                jtj[j*nf+k] = s;
+            }
+        }
+
+        /* raise lambda until a step lowers chi^2 */
+        for (;;) {
+            for (j = 0; j < nf; j++) {
+                for (k = 0; k <= j; k++) a[j*nf+k] = a[k*nf+j] = jtj[j*nf+k];
+                a[j*nf+j] *= 1. + lambda;
+                dp[j] = jtr[j];
+            }
+            memcpy (pt, p, sizeof (pt));
+            chit = 2. * chi + 1.;   /* no trial yet */
+            if (cholesky_solve (a, dp, nf) == 0) {
+                for (j = 0; j < nf; j++) pt[idx[j]] += dp[j];
+                if (pt[BROWN_SIGMA] > SIGMAMIN) {
+                    brown_eval (pt, ngate, m, NULL);
+                    chit = misfit (y, m, ngate);
+                    if (chit <= chi) break;
+                }
+            }
+            lambda *= 10.;
+            /* no downhill step left, or none the model can resolve: at the minimum */
+            if (lambda > LAMBDAMAX || chit - chi <= tol * chi) {
+                chit = chi;
+                memcpy (pt, p, sizeof (pt));
+                done = 1;
+                break;
+            }
+        }
+        if (chi - chit <= tol * chi) done = 1;
+        lambda *= 0.1;
+        if (lambda < 1.e-12) lambda = 1.e-12;
+        memcpy (p, pt, sizeof (pt));
+        chi = chit;
+        brown_eval (p, ngate, m, jac);
+    }
+
+    if (st != NULL) {
+        st->rms = sqrt (chi / ngate);
+        st->iter = iter;
+    }
+    for (k = 0; k < BROWN_NPAR; k++) if (!(p[k] == p[k]) || fabs (p[k]) > 1.e9) return (1);
+    if (p[BROWN_T0] < 0. || p[BROWN_T0] > ngate - 1) return (1);
+    if (p[BROWN_SIGMA] <= SIGMAMIN || p[BROWN_SIGMA] > 0.5 * ngate) return (1);
+    if (p[BROWN_AMP] <= 0. || fabs (p[BROWN_DECAY]) > 1.) return (1);
+    return (0);
+}
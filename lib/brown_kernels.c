@@ -0,0 +1,563 @@
+/*  brown_kernels.c
+
+ Fast kernels for the Brown model and its Jacobian (brown_kernels.h).
+
+ Each gate needs erf(u) and two exponentials.  The fast kernels use the
+ rational approximation of Abramowitz and Stegun 7.1.26,
+
+   erf(u) = 1 - t*(a1 + t*(a2 + t*(a3 + t*(a4 + t*a5)))) * exp(-u*u),  t = 1/(1 + p*|u|)
+
+ (absolute error below 1.5e-7), which shares exp(-u*u) with the derivative
+ of erf, and an exp() done by range reduction to |r| < ln2/2 and a Taylor
+ polynomial, with 2^n put in the exponent bits.  The vector kernels lay the
+ gates along the vector, so a 128-gate waveform is 16 AVX-512 vectors of
+ doubles or 8 of floats, and write the Jacobian one parameter row at a time.
+ */
+
+#define _XOPEN_SOURCE 600   /* erf(), expf() */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "brown.h"
+#include "brown_kernels.h"
+#include "cvt_kernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define BK_X86 1
+#include <immintrin.h>
+#endif
+
+/* A&S 7.1.26 */
+#define AS_P    0.3275911
+#define AS_A1   0.254829592
+#define AS_A2   -0.284496736
+#define AS_A3   1.421413741
+#define AS_A4   -1.453152027
+#define AS_A5   1.061405429
+
+#define LOG2E   1.4426950408889634
+#define LN2HI   0.693145751953125           /* ln2 = LN2HI + LN2LO, LN2HI exact in float */
+#define LN2LO   1.42860682030941723212e-6
+
+typedef void (*brown_fn) (double *p, int ngate, double *m, double *jac);
+
+static int      kernel = -1;
+static brown_fn kfn = NULL;
+
+/* Per-waveform constants shared by every kernel */
+struct KPAR {
+    double  t0, s, a, noise, q;
+    double  r2s;        /* 1/(sqrt(2) s) */
+    double  qs2;        /* q s^2 */
+    double  ha;         /* a/2 */
+    double  r2ss;       /* 1/(sqrt(2) s^2) */
+    double  qr2;        /* q/sqrt(2) */
+    double  sr2;        /* s/sqrt(2) */
+    double  q2s;        /* q^2 s */
+};
+
+static void kpar (double *p, struct KPAR *k) {
+    k->t0 = p[BROWN_T0];
+    k->s = p[BROWN_SIGMA];
+    k->a = p[BROWN_AMP];
+    k->noise = p[BROWN_NOISE];
+    k->q = p[BROWN_DECAY];
+    k->r2s = 1. / (M_SQRT2 * k->s);
+    k->qs2 = k->q * k->s * k->s;
+    k->ha = 0.5 * k->a;
+    k->r2ss = k->r2s / k->s;
+    k->qr2 = k->q * M_SQRT1_2;
+    k->sr2 = k->s * M_SQRT1_2;
+    k->q2s = k->q * k->q * k->s;
+}
+
+/* ---------------------------------------------------------------- scalar */
+
+static void model_double_scalar (double *p, int ngate, double *m, double *jac) {
+    struct KPAR k;
+    double  x, u, e, w, t, y, f, g, h;
+    int     i;
+
+    kpar (p, &k);
+    for (i = 0; i < ngate; i++) {
+        x = i - k.t0;
+        u = (x - k.qs2) * k.r2s;
+        e = exp (-k.q * (x - 0.5 * k.qs2));
+        w = exp (-u * u);
+        t = 1. / (1. + AS_P * fabs (u));
+        y = 1. - t * (AS_A1 + t * (AS_A2 + t * (AS_A3 + t * (AS_A4 + t * AS_A5)))) * w;
+        f = 1. + ((u < 0.) ? -y : y);
+        h = k.ha * e;
+        m[i] = k.noise + h * f;
+        if (jac == NULL) continue;
+        g = M_2_SQRTPI * w;
+        jac[BROWN_T0*ngate+i] = h * (k.q * f - g * k.r2s);
+        jac[BROWN_SIGMA*ngate+i] = h * (k.q2s * f - g * (x * k.r2ss + k.qr2));
+        jac[BROWN_AMP*ngate+i] = 0.5 * e * f;
+        jac[BROWN_NOISE*ngate+i] = 1.;
+        jac[BROWN_DECAY*ngate+i] = h * ((k.qs2 - x) * f - g * k.sr2);
+    }
+}
+
+static void model_float_scalar (double *p, int ngate, double *m, double *jac) {
+    struct KPAR k;
+    float   t0, q, qs2, r2s, ha, x, u, e, w, t, y, f, g, h;
+    int     i;
+
+    kpar (p, &k);
+    t0 = (float)k.t0;
+    q = (float)k.q;
+    qs2 = (float)k.qs2;
+    r2s = (float)k.r2s;
+    ha = (float)k.ha;
+    for (i = 0; i < ngate; i++) {
+        x = (float)i - t0;
+        u = (x - qs2) * r2s;
+        e = expf (-q * (x - 0.5f * qs2));
+        w = expf (-u * u);
+        t = 1.f / (1.f + (float)AS_P * fabsf (u));
+        y = 1.f - t * ((float)AS_A1 + t * ((float)AS_A2 + t * ((float)AS_A3 + t * ((float)AS_A4 + t * (float)AS_A5)))) * w;
+        f = 1.f + ((u < 0.f) ? -y : y);
+        h = ha * e;
+        m[i] = k.noise + h * f;
+        if (jac == NULL) continue;
+        g = (float)M_2_SQRTPI * w;
+        jac[BROWN_T0*ngate+i] = h * (q * f - g * r2s);
+        jac[BROWN_SIGMA*ngate+i] = h * ((float)k.q2s * f - g * (x * (float)k.r2ss + (float)k.qr2));
+        jac[BROWN_AMP*ngate+i] = 0.5f * e * f;
+        jac[BROWN_NOISE*ngate+i] = 1.;
+        jac[BROWN_DECAY*ngate+i] = h * ((qs2 - x) * f - g * (float)k.sr2);
+    }
+}
+
+static void put_tail (double *m, double *jac, int ngate, int i, double *tm, double *tj, int lanes) {
+
+    /* Copy the gates of a last, partial vector from the lane buffers */
+
+    int     k, n = ngate - i;
+
+    memcpy (m + i, tm, n * sizeof (double));
+    if (jac == NULL) return;
+    for (k = 0; k < BROWN_NPAR; k++) memcpy (jac + k * ngate + i, tj + k * lanes, n * sizeof (double));
+}
+
+#ifdef BK_X86
+/* ------------------------------------------------------------------ AVX2 */
+
+__attribute__((target("avx2,fma")))
+static __m256d exp_pd_avx2 (__m256d x) {
+    __m256d n, r, y;
+    __m256i e;
+    x = _mm256_max_pd (_mm256_min_pd (x, _mm256_set1_pd (700.)), _mm256_set1_pd (-700.));
+    n = _mm256_round_pd (_mm256_mul_pd (x, _mm256_set1_pd (LOG2E)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    r = _mm256_fnmadd_pd (n, _mm256_set1_pd (LN2HI), x);
+    r = _mm256_fnmadd_pd (n, _mm256_set1_pd (LN2LO), r);
+    y = _mm256_set1_pd (1. / 39916800.);
+    y = _mm256_fmadd_pd (y, r, _mm256_set1_pd (1. / 3628800.));
+    y = _mm256_fmadd_pd (y, r, _mm256_set1_pd (1. / 362880.));
+    y = _mm256_fmadd_pd (y, r, _mm256_set1_pd (1. / 40320.));
+    y = _mm256_fmadd_pd (y, r, _mm256_set1_pd (1. / 5040.));
+    y = _mm256_fmadd_pd (y, r, _mm256_set1_pd (1. / 720.));
+    y = _mm256_fmadd_pd (y, r, _mm256_set1_pd (1. / 120.));
+    y = _mm256_fmadd_pd (y, r, _mm256_set1_pd (1. / 24.));
+    y = _mm256_fmadd_pd (y, r, _mm256_set1_pd (1. / 6.));
+    y = _mm256_fmadd_pd (y, r, _mm256_set1_pd (0.5));
+    y = _mm256_fmadd_pd (y, r, _mm256_set1_pd (1.));
+    y = _mm256_fmadd_pd (y, r, _mm256_set1_pd (1.));
+    e = _mm256_slli_epi64 (_mm256_add_epi64 (_mm256_cvtepi32_epi64 (_mm256_cvtpd_epi32 (n)), _mm256_set1_epi64x (1023)), 52);
+    return (_mm256_mul_pd (y, _mm256_castsi256_pd (e)));
+}
+
+__attribute__((target("avx2,fma")))
+static __m256d one_plus_erf_pd_avx2 (__m256d u, __m256d w) {
+    /* 1 + erf(u), given w = exp(-u*u) */
+    __m256d sign = _mm256_set1_pd (-0.), t, y;
+    t = _mm256_div_pd (_mm256_set1_pd (1.), _mm256_fmadd_pd (_mm256_set1_pd (AS_P), _mm256_andnot_pd (sign, u), _mm256_set1_pd (1.)));
+    y = _mm256_fmadd_pd (t, _mm256_set1_pd (AS_A5), _mm256_set1_pd (AS_A4));
+    y = _mm256_fmadd_pd (y, t, _mm256_set1_pd (AS_A3));
+    y = _mm256_fmadd_pd (y, t, _mm256_set1_pd (AS_A2));
+    y = _mm256_fmadd_pd (y, t, _mm256_set1_pd (AS_A1));
+    y = _mm256_fnmadd_pd (_mm256_mul_pd (y, t), w, _mm256_set1_pd (1.));
+    return (_mm256_add_pd (_mm256_set1_pd (1.), _mm256_xor_pd (y, _mm256_and_pd (sign, u))));
+}
+
+__attribute__((target("avx2,fma")))
+static void model_double_avx2 (double *p, int ngate, double *m, double *jac) {
+    struct KPAR k;
+    __m256d x, u, e, w, f, g, h, v[BROWN_NPAR], mm;
+    __m256d step = _mm256_set_pd (3., 2., 1., 0.), t0, qs2, hqs2, nq, r2s;
+    double  tm[4], tj[BROWN_NPAR*4], *dm;
+    int     i, j, full;
+
+    kpar (p, &k);
+    t0 = _mm256_set1_pd (k.t0);
+    qs2 = _mm256_set1_pd (k.qs2);
+    hqs2 = _mm256_set1_pd (0.5 * k.qs2);
+    nq = _mm256_set1_pd (-k.q);
+    r2s = _mm256_set1_pd (k.r2s);
+    for (i = 0; i < ngate; i += 4) {
+        x = _mm256_sub_pd (_mm256_add_pd (_mm256_set1_pd ((double)i), step), t0);
+        u = _mm256_mul_pd (_mm256_sub_pd (x, qs2), r2s);
+        e = exp_pd_avx2 (_mm256_mul_pd (nq, _mm256_sub_pd (x, hqs2)));
+        w = exp_pd_avx2 (_mm256_mul_pd (_mm256_xor_pd (u, _mm256_set1_pd (-0.)), u));
+        f = one_plus_erf_pd_avx2 (u, w);
+        h = _mm256_mul_pd (_mm256_set1_pd (k.ha), e);
+        mm = _mm256_fmadd_pd (h, f, _mm256_set1_pd (k.noise));
+        full = (i + 4 <= ngate);
+        dm = (full) ? m + i : tm;
+        _mm256_storeu_pd (dm, mm);
+        if (jac != NULL) {
+            g = _mm256_mul_pd (_mm256_set1_pd (M_2_SQRTPI), w);
+            v[BROWN_T0] = _mm256_mul_pd (h, _mm256_fmsub_pd (_mm256_set1_pd (k.q), f, _mm256_mul_pd (g, r2s)));
+            v[BROWN_SIGMA] = _mm256_mul_pd (h, _mm256_fmsub_pd (_mm256_set1_pd (k.q2s), f,
+                _mm256_mul_pd (g, _mm256_fmadd_pd (x, _mm256_set1_pd (k.r2ss), _mm256_set1_pd (k.qr2)))));
+            v[BROWN_AMP] = _mm256_mul_pd (_mm256_mul_pd (_mm256_set1_pd (0.5), e), f);
+            v[BROWN_NOISE] = _mm256_set1_pd (1.);
+            v[BROWN_DECAY] = _mm256_mul_pd (h, _mm256_fmsub_pd (_mm256_sub_pd (qs2, x), f, _mm256_mul_pd (g, _mm256_set1_pd (k.sr2))));
+            for (j = 0; j < BROWN_NPAR; j++) _mm256_storeu_pd ((full) ? jac + j * ngate + i : tj + j * 4, v[j]);
+        }
+        if (!full) put_tail (m, jac, ngate, i, tm, tj, 4);
+    }
+}
+
+__attribute__((target("avx2,fma")))
+static __m256 exp_ps_avx2 (__m256 x) {
+    __m256  n, r, y;
+    __m256i e;
+    x = _mm256_max_ps (_mm256_min_ps (x, _mm256_set1_ps (87.f)), _mm256_set1_ps (-87.f));
+    n = _mm256_round_ps (_mm256_mul_ps (x, _mm256_set1_ps ((float)LOG2E)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    r = _mm256_fnmadd_ps (n, _mm256_set1_ps ((float)LN2HI), x);
+    r = _mm256_fnmadd_ps (n, _mm256_set1_ps ((float)LN2LO), r);
+    y = _mm256_set1_ps (1.f / 5040.f);
+    y = _mm256_fmadd_ps (y, r, _mm256_set1_ps (1.f / 720.f));
+    y = _mm256_fmadd_ps (y, r, _mm256_set1_ps (1.f / 120.f));
+    y = _mm256_fmadd_ps (y, r, _mm256_set1_ps (1.f / 24.f));
+    y = _mm256_fmadd_ps (y, r, _mm256_set1_ps (1.f / 6.f));
+    y = _mm256_fmadd_ps (y, r, _mm256_set1_ps (0.5f));
+    y = _mm256_fmadd_ps (y, r, _mm256_set1_ps (1.f));
+    y = _mm256_fmadd_ps (y, r, _mm256_set1_ps (1.f));
+    e = _mm256_slli_epi32 (_mm256_add_epi32 (_mm256_cvtps_epi32 (n), _mm256_set1_epi32 (127)), 23);
+    return (_mm256_mul_ps (y, _mm256_castsi256_ps (e)));
+}
+
+__attribute__((target("avx2,fma")))
+static __m256 one_plus_erf_ps_avx2 (__m256 u, __m256 w) {
+    __m256  sign = _mm256_set1_ps (-0.f), t, y;
+    t = _mm256_div_ps (_mm256_set1_ps (1.f), _mm256_fmadd_ps (_mm256_set1_ps ((float)AS_P), _mm256_andnot_ps (sign, u), _mm256_set1_ps (1.f)));
+    y = _mm256_fmadd_ps (t, _mm256_set1_ps ((float)AS_A5), _mm256_set1_ps ((float)AS_A4));
+    y = _mm256_fmadd_ps (y, t, _mm256_set1_ps ((float)AS_A3));
+    y = _mm256_fmadd_ps (y, t, _mm256_set1_ps ((float)AS_A2));
+    y = _mm256_fmadd_ps (y, t, _mm256_set1_ps ((float)AS_A1));
+    y = _mm256_fnmadd_ps (_mm256_mul_ps (y, t), w, _mm256_set1_ps (1.f));
+    return (_mm256_add_ps (_mm256_set1_ps (1.f), _mm256_xor_ps (y, _mm256_and_ps (sign, u))));
+}
+
+__attribute__((target("avx2,fma")))
+static void store_ps_avx2 (double *d, __m256 v) {
+    _mm256_storeu_pd (d, _mm256_cvtps_pd (_mm256_castps256_ps128 (v)));
+    _mm256_storeu_pd (d + 4, _mm256_cvtps_pd (_mm256_extractf128_ps (v, 1)));
+}
+
+__attribute__((target("avx2,fma")))
+static void model_float_avx2 (double *p, int ngate, double *m, double *jac) {
+    struct KPAR k;
+    __m256  x, u, e, w, f, g, h, v[BROWN_NPAR];
+    __m256  step = _mm256_set_ps (7.f, 6.f, 5.f, 4.f, 3.f, 2.f, 1.f, 0.f), t0, qs2, hqs2, nq, r2s;
+    double  tm[8], tj[BROWN_NPAR*8], *dm;
+    int     i, j, full;
+
+    kpar (p, &k);
+    t0 = _mm256_set1_ps ((float)k.t0);
+    qs2 = _mm256_set1_ps ((float)k.qs2);
+    hqs2 = _mm256_set1_ps ((float)(0.5 * k.qs2));
+    nq = _mm256_set1_ps ((float)-k.q);
+    r2s = _mm256_set1_ps ((float)k.r2s);
+    for (i = 0; i < ngate; i += 8) {
+        x = _mm256_sub_ps (_mm256_add_ps (_mm256_set1_ps ((float)i), step), t0);
+        u = _mm256_mul_ps (_mm256_sub_ps (x, qs2), r2s);
+        e = exp_ps_avx2 (_mm256_mul_ps (nq, _mm256_sub_ps (x, hqs2)));
+        w = exp_ps_avx2 (_mm256_mul_ps (_mm256_xor_ps (u, _mm256_set1_ps (-0.f)), u));
+        f = one_plus_erf_ps_avx2 (u, w);
+        h = _mm256_mul_ps (_mm256_set1_ps ((float)k.ha), e);
+        full = (i + 8 <= ngate);
+        dm = (full) ? m + i : tm;
+        /* the noise floor is added in double: it can be much larger than h f */
+        store_ps_avx2 (dm, _mm256_mul_ps (h, f));
+        for (j = 0; j < 8; j++) dm[j] += k.noise;
+        if (jac != NULL) {
+            g = _mm256_mul_ps (_mm256_set1_ps ((float)M_2_SQRTPI), w);
+            v[BROWN_T0] = _mm256_mul_ps (h, _mm256_fmsub_ps (_mm256_set1_ps ((float)k.q), f, _mm256_mul_ps (g, r2s)));
+            v[BROWN_SIGMA] = _mm256_mul_ps (h, _mm256_fmsub_ps (_mm256_set1_ps ((float)k.q2s), f,
+                _mm256_mul_ps (g, _mm256_fmadd_ps (x, _mm256_set1_ps ((float)k.r2ss), _mm256_set1_ps ((float)k.qr2)))));
+            v[BROWN_AMP] = _mm256_mul_ps (_mm256_mul_ps (_mm256_set1_ps (0.5f), e), f);
+            v[BROWN_NOISE] = _mm256_set1_ps (1.f);
+            v[BROWN_DECAY] = _mm256_mul_ps (h, _mm256_fmsub_ps (_mm256_sub_ps (qs2, x), f, _mm256_mul_ps (g, _mm256_set1_ps ((float)k.sr2))));
+            for (j = 0; j < BROWN_NPAR; j++) store_ps_avx2 ((full) ? jac + j * ngate + i : tj + j * 8, v[j]);
+        }
+        if (!full) put_tail (m, jac, ngate, i, tm, tj, 8);
+    }
+}
+
+/* --------------------------------------------------------------- AVX-512 */
+
+__attribute__((target("avx512f")))
+static __m512d exp_pd_avx512 (__m512d x) {
+    __m512d n, r, y;
+    x = _mm512_max_pd (_mm512_min_pd (x, _mm512_set1_pd (700.)), _mm512_set1_pd (-700.));
+    n = _mm512_roundscale_pd (_mm512_mul_pd (x, _mm512_set1_pd (LOG2E)), _MM_FROUND_TO_NEAREST_INT);
+    r = _mm512_fnmadd_pd (n, _mm512_set1_pd (LN2HI), x);
+    r = _mm512_fnmadd_pd (n, _mm512_set1_pd (LN2LO), r);
+    y = _mm512_set1_pd (1. / 39916800.);
+    y = _mm512_fmadd_pd (y, r, _mm512_set1_pd (1. / 3628800.));
+    y = _mm512_fmadd_pd (y, r, _mm512_set1_pd (1. / 362880.));
+    y = _mm512_fmadd_pd (y, r, _mm512_set1_pd (1. / 40320.));
+    y = _mm512_fmadd_pd (y, r, _mm512_set1_pd (1. / 5040.));
+    y = _mm512_fmadd_pd (y, r, _mm512_set1_pd (1. / 720.));
+    y = _mm512_fmadd_pd (y, r, _mm512_set1_pd (1. / 120.));
+    y = _mm512_fmadd_pd (y, r, _mm512_set1_pd (1. / 24.));
+    y = _mm512_fmadd_pd (y, r, _mm512_set1_pd (1. / 6.));
+    y = _mm512_fmadd_pd (y, r, _mm512_set1_pd (0.5));
+    y = _mm512_fmadd_pd (y, r, _mm512_set1_pd (1.));
+    y = _mm512_fmadd_pd (y, r, _mm512_set1_pd (1.));
+    return (_mm512_scalef_pd (y, n));
+}
+
+__attribute__((target("avx512f")))
+static __m512d one_plus_erf_pd_avx512 (__m512d u, __m512d w) {
+    __m512d t, y;
+    t = _mm512_div_pd (_mm512_set1_pd (1.), _mm512_fmadd_pd (_mm512_set1_pd (AS_P), _mm512_abs_pd (u), _mm512_set1_pd (1.)));
+    y = _mm512_fmadd_pd (t, _mm512_set1_pd (AS_A5), _mm512_set1_pd (AS_A4));
+    y = _mm512_fmadd_pd (y, t, _mm512_set1_pd (AS_A3));
+    y = _mm512_fmadd_pd (y, t, _mm512_set1_pd (AS_A2));
+    y = _mm512_fmadd_pd (y, t, _mm512_set1_pd (AS_A1));
+    y = _mm512_fnmadd_pd (_mm512_mul_pd (y, t), w, _mm512_set1_pd (1.));
+    /* erf is odd: negate y where u < 0 */
+    y = _mm512_mask_sub_pd (y, _mm512_cmp_pd_mask (u, _mm512_setzero_pd (), _CMP_LT_OQ), _mm512_setzero_pd (), y);
+    return (_mm512_add_pd (_mm512_set1_pd (1.), y));
+}
+
+__attribute__((target("avx512f")))
+static void model_double_avx512 (double *p, int ngate, double *m, double *jac) {
+    struct KPAR k;
+    __m512d x, u, e, w, f, g, h, v[BROWN_NPAR];
+    __m512d step = _mm512_set_pd (7., 6., 5., 4., 3., 2., 1., 0.), t0, qs2, hqs2, nq, r2s;
+    double  tm[8], tj[BROWN_NPAR*8];
+    int     i, j, full;
+
+    kpar (p, &k);
+    t0 = _mm512_set1_pd (k.t0);
+    qs2 = _mm512_set1_pd (k.qs2);
+    hqs2 = _mm512_set1_pd (0.5 * k.qs2);
+    nq = _mm512_set1_pd (-k.q);
+    r2s = _mm512_set1_pd (k.r2s);
+    for (i = 0; i < ngate; i += 8) {
+        x = _mm512_sub_pd (_mm512_add_pd (_mm512_set1_pd ((double)i), step), t0);
+        u = _mm512_mul_pd (_mm512_sub_pd (x, qs2), r2s);
+        e = exp_pd_avx512 (_mm512_mul_pd (nq, _mm512_sub_pd (x, hqs2)));
+        w = exp_pd_avx512 (_mm512_sub_pd (_mm512_setzero_pd (), _mm512_mul_pd (u, u)));
+        f = one_plus_erf_pd_avx512 (u, w);
+        h = _mm512_mul_pd (_mm512_set1_pd (k.ha), e);
+        full = (i + 8 <= ngate);
+        _mm512_storeu_pd ((full) ? m + i : tm, _mm512_fmadd_pd (h, f, _mm512_set1_pd (k.noise)));
+        if (jac != NULL) {
+            g = _mm512_mul_pd (_mm512_set1_pd (M_2_SQRTPI), w);
+            v[BROWN_T0] = _mm512_mul_pd (h, _mm512_fmsub_pd (_mm512_set1_pd (k.q), f, _mm512_mul_pd (g, r2s)));
+            v[BROWN_SIGMA] = _mm512_mul_pd (h, _mm512_fmsub_pd (_mm512_set1_pd (k.q2s), f,
+                _mm512_mul_pd (g, _mm512_fmadd_pd (x, _mm512_set1_pd (k.r2ss), _mm512_set1_pd (k.qr2)))));
+            v[BROWN_AMP] = _mm512_mul_pd (_mm512_mul_pd (_mm512_set1_pd (0.5), e), f);
+            v[BROWN_NOISE] = _mm512_set1_pd (1.);
+            v[BROWN_DECAY] = _mm512_mul_pd (h, _mm512_fmsub_pd (_mm512_sub_pd (qs2, x), f, _mm512_mul_pd (g, _mm512_set1_pd (k.sr2))));
+            for (j = 0; j < BROWN_NPAR; j++) _mm512_storeu_pd ((full) ? jac + j * ngate + i : tj + j * 8, v[j]);
+        }
+        if (!full) put_tail (m, jac, ngate, i, tm, tj, 8);
+    }
+}
+
+__attribute__((target("avx512f")))
+static __m512 exp_ps_avx512 (__m512 x) {
+    __m512  n, r, y;
+    x = _mm512_max_ps (_mm512_min_ps (x, _mm512_set1_ps (87.f)), _mm512_set1_ps (-87.f));
+    n = _mm512_roundscale_ps (_mm512_mul_ps (x, _mm512_set1_ps ((float)LOG2E)), _MM_FROUND_TO_NEAREST_INT);
+    r = _mm512_fnmadd_ps (n, _mm512_set1_ps ((float)LN2HI), x);
+    r = _mm512_fnmadd_ps (n, _mm512_set1_ps ((float)LN2LO), r);
+    y = _mm512_set1_ps (1.f / 5040.f);
+    y = _mm512_fmadd_ps (y, r, _mm512_set1_ps (1.f / 720.f));
+    y = _mm512_fmadd_ps (y, r, _mm512_set1_ps (1.f / 120.f));
+    y = _mm512_fmadd_ps (y, r, _mm512_set1_ps (1.f / 24.f));
+    y = _mm512_fmadd_ps (y, r, _mm512_set1_ps (1.f / 6.f));
+    y = _mm512_fmadd_ps (y, r, _mm512_set1_ps (0.5f));
+    y = _mm512_fmadd_ps (y, r, _mm512_set1_ps (1.f));
+    y = _mm512_fmadd_ps (y, r, _mm512_set1_ps (1.f));
+    return (_mm512_scalef_ps (y, n));
+}
+
+__attribute__((target("avx512f")))
+static __m512 one_plus_erf_ps_avx512 (__m512 u, __m512 w) {
+    __m512  t, y;
+    t = _mm512_div_ps (_mm512_set1_ps (1.f), _mm512_fmadd_ps (_mm512_set1_ps ((float)AS_P), _mm512_abs_ps (u), _mm512_set1_ps (1.f)));
+    y = _mm512_fmadd_ps (t, _mm512_set1_ps ((float)AS_A5), _mm512_set1_ps ((float)AS_A4));
+    y = _mm512_fmadd_ps (y, t, _mm512_set1_ps ((float)AS_A3));
+    y = _mm512_fmadd_ps (y, t, _mm512_set1_ps ((float)AS_A2));
+    y = _mm512_fmadd_ps (y, t, _mm512_set1_ps ((float)AS_A1));
+    y = _mm512_fnmadd_ps (_mm512_mul_ps (y, t), w, _mm512_set1_ps (1.f));
+    y = _mm512_mask_sub_ps (y, _mm512_cmp_ps_mask (u, _mm512_setzero_ps (), _CMP_LT_OQ), _mm512_setzero_ps (), y);
+    return (_mm512_add_ps (_mm512_set1_ps (1.f), y));
+}
+
+__attribute__((target("avx512f")))
+static void store_ps_avx512 (double *d, __m512 v, __m512d add) {
+    _mm512_storeu_pd (d, _mm512_add_pd (_mm512_cvtps_pd (_mm512_castps512_ps256 (v)), add));
+    _mm512_storeu_pd (d + 8, _mm512_add_pd (_mm512_cvtps_pd (_mm256_castpd_ps (_mm512_extractf64x4_pd (_mm512_castps_pd (v), 1))), add));
+}
+
+__attribute__((target("avx512f")))
+static void model_float_avx512 (double *p, int ngate, double *m, double *jac) {
+    struct KPAR k;
+    __m512  x, u, e, w, f, g, h, v[BROWN_NPAR];
+    __m512  step = _mm512_set_ps (15.f, 14.f, 13.f, 12.f, 11.f, 10.f, 9.f, 8.f, 7.f, 6.f, 5.f, 4.f, 3.f, 2.f, 1.f, 0.f);
+    __m512  t0, qs2, hqs2, nq, r2s;
+    __m512d zero = _mm512_setzero_pd ();
+    double  tm[16], tj[BROWN_NPAR*16];
+    int     i, j, full;
+
+    kpar (p, &k);
+    t0 = _mm512_set1_ps ((float)k.t0);
+    qs2 = _mm512_set1_ps ((float)k.qs2);
+    hqs2 = _mm512_set1_ps ((float)(0.5 * k.qs2));
+    nq = _mm512_set1_ps ((float)-k.q);
+    r2s = _mm512_set1_ps ((float)k.r2s);
+    for (i = 0; i < ngate; i += 16) {
+        x = _mm512_sub_ps (_mm512_add_ps (_mm512_set1_ps ((float)i), step), t0);
+        u = _mm512_mul_ps (_mm512_sub_ps (x, qs2), r2s);
+        e = exp_ps_avx512 (_mm512_mul_ps (nq, _mm512_sub_ps (x, hqs2)));
+        w = exp_ps_avx512 (_mm512_sub_ps (_mm512_setzero_ps (), _mm512_mul_ps (u, u)));
+        f = one_plus_erf_ps_avx512 (u, w);
+        h = _mm512_mul_ps (_mm512_set1_ps ((float)k.ha), e);
+        full = (i + 16 <= ngate);
+        /* the noise floor is added in double: it can be much larger than h f */
+        store_ps_avx512 ((full) ? m + i : tm, _mm512_mul_ps (h, f), _mm512_set1_pd (k.noise));
+        if (jac != NULL) {
+            g = _mm512_mul_ps (_mm512_set1_ps ((float)M_2_SQRTPI), w);
+            v[BROWN_T0] = _mm512_mul_ps (h, _mm512_fmsub_ps (_mm512_set1_ps ((float)k.q), f, _mm512_mul_ps (g, r2s)));
+            v[BROWN_SIGMA] = _mm512_mul_ps (h, _mm512_fmsub_ps (_mm512_set1_ps ((float)k.q2s), f,
+                _mm512_mul_ps (g, _mm512_fmadd_ps (x, _mm512_set1_ps ((float)k.r2ss), _mm512_set1_ps ((float)k.qr2)))));
+            v[BROWN_AMP] = _mm512_mul_ps (_mm512_mul_ps (_mm512_set1_ps (0.5f), e), f);
+            v[BROWN_NOISE] = _mm512_set1_ps (1.f);
+            v[BROWN_DECAY] = _mm512_mul_ps (h, _mm512_fmsub_ps (_mm512_sub_ps (qs2, x), f, _mm512_mul_ps (g, _mm512_set1_ps ((float)k.sr2))));
+            for (j = 0; j < BROWN_NPAR; j++) store_ps_avx512 ((full) ? jac + j * ngate + i : tj + j * 16, v[j], zero);
+        }
+        if (!full) put_tail (m, jac, ngate, i, tm, tj, 16);
+    }
+}
+#endif /* BK_X86 */
+
+/* -------------------------------------------------------------- dispatch */
+
+char *brown_kernel_name (int kern) {
+    static char *names[] = {"ref", "double", "float"};
+    return ((kern >= BROWN_REF && kern <= BROWN_FLOAT) ? names[kern] : "unknown");
+}
+
+static int simd_level (void) {
+
+    /* The cvt_kernels level, less AVX2 on the rare CPU that has it without FMA */
+
+    int     lev = cvt_level ();
+#ifdef BK_X86
+    if (lev == CVT_AVX2 && !__builtin_cpu_supports ("fma")) lev = CVT_SSE2;
+#endif
+    return (lev);
+}
+
+char *brown_kernel_isa (int kern) {
+    int     lev = simd_level ();
+    if (kern == BROWN_REF) return ("libm");
+    return ((lev == CVT_AVX512 || lev == CVT_AVX2) ? cvt_level_name (lev) : "scalar");
+}
+
+static brown_fn kernel_fn (int kern) {
+    int     lev = simd_level ();
+    if (kern == BROWN_REF) return (brown_model);
+#ifdef BK_X86
+    if (lev == CVT_AVX512) return ((kern == BROWN_FLOAT) ? model_float_avx512 : model_double_avx512);
+    if (lev == CVT_AVX2) return ((kern == BROWN_FLOAT) ? model_float_avx2 : model_double_avx2);
+#endif
+    (void)lev;
+    return ((kern == BROWN_FLOAT) ? model_float_scalar : model_double_scalar);
+}
+
+int brown_set_kernel (int kern) {
+
+    /* Use kernel kern (BROWN_DOUBLE if it is not one).  Call before
+       starting threads that fit.  Returns the kernel now in use. */
+
+    kernel = (kern < BROWN_REF || kern > BROWN_FLOAT) ? BROWN_DOUBLE : kern;
+    kfn = kernel_fn (kernel);
+    return (kernel);
+}
+
+int brown_kernel (void) {
+    char    *env;
+    int     kern;
+    if (kernel < 0) {
+        kern = BROWN_DOUBLE;
+        if ((env = getenv ("BROWN_KERNEL")) != NULL) {
+            for (kern = BROWN_REF; kern <= BROWN_FLOAT; kern++) {
+                if (!strcmp (env, brown_kernel_name (kern))) break;
+            }
+        }
+        brown_set_kernel (kern);
+    }
+    return (kernel);
+}
+
+void brown_eval (double *p, int ngate, double *m, double *jac) {
+    if (kfn == NULL) brown_kernel ();
+    kfn (p, ngate, m, jac);
+}
+
+double brown_kernel_check (int kern, double *jerr) {
+
+    /* Compare kern with BROWN_REF over waveforms spanning the parameters
+       a retracker meets: edges early, central and late, narrow to wide,
+       weak to strong, with and without noise and plateau decay. */
+
+    static double t0s[] = {20.3, 64., 97.71}, ss[] = {0.6, 1.5, 3.2, 7.}, as[] = {900., 42000.};
+    static double ns[] = {0., 2500.}, qs[] = {-0.004, 0., 0.01, 0.03};
+    double  p[BROWN_NPAR], m0[128], m1[128], j0[BROWN_NPAR*128], j1[BROWN_NPAR*128];
+    double  err, merr = 0., jmax, dmax;
+    int     a, b, c, d, e, i, k, ngate = 128;
+    brown_fn fn = kernel_fn (kern);
+
+    *jerr = 0.;
+    for (a = 0; a < 3; a++) for (b = 0; b < 4; b++) for (c = 0; c < 2; c++) for (d = 0; d < 2; d++) for (e = 0; e < 4; e++) {
+        p[BROWN_T0] = t0s[a];
+        p[BROWN_SIGMA] = ss[b];
+        p[BROWN_AMP] = as[c];
+        p[BROWN_NOISE] = ns[d];
+        p[BROWN_DECAY] = qs[e];
+        brown_model (p, ngate, m0, j0);
+        fn (p, ngate - (a == 1), m1, j1);   /* one odd length, for the tails */
+        if (a == 1) {   /* compare like with like */
+            brown_model (p, ngate - 1, m0, j0);
+            ngate--;
+        }
+        for (i = 0; i < ngate; i++) {
+            err = fabs (m1[i] - m0[i]) / p[BROWN_AMP];
+            if (!(err <= merr)) merr = err;     /* NaN sticks */
+        }
+        for (k = 0; k < BROWN_NPAR; k++) {
+            for (jmax = dmax = 0., i = 0; i < ngate; i++) {
+                if (fabs (j0[k*ngate+i]) > jmax) jmax = fabs (j0[k*ngate+i]);
+                err = fabs (j1[k*ngate+i] - j0[k*ngate+i]);
+                if (!(err <= dmax)) dmax = err;
+            }
+            err = (jmax > 0.) ? dmax / jmax : dmax;
+            if (!(err <= *jerr)) *jerr = err;
+        }
+        ngate = 128;
+    }
+    return (merr);
+}
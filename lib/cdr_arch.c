@@ -0,0 +1,441 @@
+/*  cdr_arch.c
+
+ Reader and writer for the CDR archive of cdr_arch.h.  The reader maps the
+ whole archive and unpacks directory entries and points straight from the
+ map; the writer keeps the directory in memory and writes it, then the
+ header, when it is finished.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "cdr.h"
+#include "cdr_arch.h"
+
+static void put_long (unsigned char *b, long v) {
+
+    /* 8 bytes little endian */
+
+    unsigned long u = (unsigned long)v;
+    int     i;
+
+    for (i = 0; i < 8; i++, u >>= 8) b[i] = (unsigned char)(u & 0xff);
+}
+
+static long get_long (const unsigned char *b) {
+    unsigned long u = 0;
+    int     i;
+
+    for (i = 7; i >= 0; i--) u = (u << 8) | b[i];
+    return ((long)u);
+}
+
+static void pack_head (long npass, long dir, unsigned char *b) {
+    int     version = CDR_ARCH_VERSION, entry = CDR_ARCH_ENTRY;
+
+    memset (b, 0, CDR_ARCH_HEAD);
+    memcpy (b, CDR_ARCH_MAGIC, 8);
+    cdr_le (b + 8, &version, 4);
+    cdr_le (b + 12, &entry, 4);
+    put_long (b + 16, npass);
+    put_long (b + 24, dir);
+}
+
+static void pack_entry (struct CDR_PASS *d, unsigned char *b) {
+    put_long (b, d->off);
+    put_long (b + 8, d->n);
+    cdr_le (b + 16, &d->t0, 8);
+    cdr_le (b + 24, &d->t1, 8);
+    cdr_le (b + 32, &d->south, 4);
+    cdr_le (b + 36, &d->north, 4);
+    cdr_le (b + 40, &d->west, 4);
+    cdr_le (b + 44, &d->east, 4);
+    cdr_le (b + 48, &d->isat, 4);
+    cdr_le (b + 52, &d->iasc, 4);
+    cdr_le (b + 56, &d->ifile, 4);
+    cdr_le (b + 60, &d->idt, 4);
+}
+
+static void unpack_entry (const unsigned char *b, struct CDR_PASS *d) {
+    d->off = get_long (b);
+    d->n = get_long (b + 8);
+    cdr_le (&d->t0, b + 16, 8);
+    cdr_le (&d->t1, b + 24, 8);
+    cdr_le (&d->south, b + 32, 4);
+    cdr_le (&d->north, b + 36, 4);
+    cdr_le (&d->west, b + 40, 4);
+    cdr_le (&d->east, b + 44, 4);
+    cdr_le (&d->isat, b + 48, 4);
+    cdr_le (&d->iasc, b + 52, 4);
+    cdr_le (&d->ifile, b + 56, 4);
+    cdr_le (&d->idt, b + 60, 4);
+}
+
+static int check_head (const unsigned char *b, long *npass, long *dir) {
+
+    /* 0 if b is an archive header this code reads */
+
+    int     version, entry;
+
+    if (memcmp (b, CDR_ARCH_MAGIC, 8)) return (1);
+    cdr_le (&version, b + 8, 4);
+    cdr_le (&entry, b + 12, 4);
+    *npass = get_long (b + 16);
+    *dir = get_long (b + 24);
+    return (version != CDR_ARCH_VERSION || entry != CDR_ARCH_ENTRY || *npass < 0 || *dir < CDR_ARCH_HEAD);
+}
+
+/* Time span and lat/lon box of a pass, point by point.  lon is followed
+   continuously from the first point, so a pass over 0 E gets a box that
+   wraps rather than one spanning the globe. */
+struct BOX {
+    long    n;
+    double  t0, t1, south, north;
+    double  lon, u, lo, hi;     /* last lon, and it unwrapped with its range */
+};
+
+static void box_point (struct BOX *b, double t, double lat, double lon) {
+    double  step;
+
+    if (b->n++ == 0) {
+        b->t0 = b->t1 = t;
+        b->south = b->north = lat;
+        b->u = b->lo = b->hi = b->lon = lon;
+        return;
+    }
+    if (t < b->t0) b->t0 = t;
+    if (t > b->t1) b->t1 = t;
+    if (lat < b->south) b->south = lat;
+    if (lat > b->north) b->north = lat;
+    step = lon - b->lon;
+    if (step > 180.) step -= 360.;
+    if (step < -180.) step += 360.;
+    b->lon = lon;
+    b->u += step;
+    if (b->u < b->lo) b->lo = b->u;
+    if (b->u > b->hi) b->hi = b->u;
+}
+
+static void box_entry (struct BOX *b, struct CDR_PASS *d) {
+    double  w, e;
+
+    d->t0 = d->t1 = 0.;
+    d->south = d->north = d->west = d->east = 0.f;
+    if (b->n == 0) return;
+    d->t0 = b->t0;
+    d->t1 = b->t1;
+    d->south = (float)b->south;
+    d->north = (float)b->north;
+    if (b->hi - b->lo >= 360.) {
+        d->west = 0.f;
+        d->east = 360.f;
+        return;
+    }
+    for (w = b->lo; w < 0.; w += 360.) ;
+    for (; w >= 360.; w -= 360.) ;
+    for (e = b->hi; e < 0.; e += 360.) ;
+    for (; e > 360.; e -= 360.) ;
+    d->west = (float)w;
+    d->east = (float)e;
+}
+
+int cdr_is_arch (char *fname) {
+
+    /* 1 if fname starts as an archive does */
+
+    unsigned char b[8];
+    FILE    *fp;
+    int     is;
+
+    if ((fp = fopen (fname, "rb")) == NULL) return (0);
+    is = (fread (b, 8, 1, fp) == 1 && !memcmp (b, CDR_ARCH_MAGIC, 8));
+    fclose (fp);
+    return (is);
+}
+
+static int arch_map (struct CDR_ARCH *a, char *fname, int rw) {
+
+    struct stat st;
+    long    dir;
+
+    memset (a, 0, sizeof (*a));
+    if ((a->fd = open (fname, (rw) ? O_RDWR : O_RDONLY)) < 0) {
+        fprintf (stderr, "Failed to open %s\n", fname);
+        return (1);
+    }
+    if (fstat (a->fd, &st) || st.st_size < CDR_ARCH_HEAD) {
+        fprintf (stderr, "Failed: %s is not a CDR archive\n", fname);
+        close (a->fd);
+        return (1);
+    }
+    a->maplen = (size_t)st.st_size;
+    a->map = mmap (NULL, a->maplen, (rw) ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, a->fd, 0);
+    if (a->map == MAP_FAILED) {
+        fprintf (stderr, "Failed to mmap %s\n", fname);
+        close (a->fd);
+        a->map = NULL;
+        return (1);
+    }
+    if (check_head ((const unsigned char *)a->map, &a->npass, &dir)
+        || (size_t)dir + (size_t)a->npass * CDR_ARCH_ENTRY > a->maplen) {
+        fprintf (stderr, "Failed: %s is not a CDR archive or is cut short\n", fname);
+        cdr_arch_close (a);
+        return (1);
+    }
+    a->dir = (const unsigned char *)a->map + dir;
+    a->rw = rw;
+    return (0);
+}
+
+int cdr_arch_open (struct CDR_ARCH *a, char *fname) {
+
+    /* Map an archive.  Returns 0 on success. */
+
+    return (arch_map (a, fname, 0));
+}
+
+int cdr_arch_open_rw (struct CDR_ARCH *a, char *fname) {
+
+    /* Map an archive so that its points may be changed in place through
+       cdr_arch_raw(); the directory must not be.  Returns 0 on success. */
+
+    return (arch_map (a, fname, 1));
+}
+
+int cdr_arch_close (struct CDR_ARCH *a) {
+
+    /* Returns 0, or 1 if changes made through a read-write map failed to
+       reach the file */
+
+    int     err = 0;
+
+    if (a->map == NULL) return (0);
+    if (a->rw && msync (a->map, a->maplen, MS_SYNC)) {
+        fprintf (stderr, "Failed to write back a CDR archive\n");
+        err = 1;
+    }
+    munmap (a->map, a->maplen);
+    close (a->fd);
+    a->map = NULL;
+    a->dir = NULL;
+    return (err);
+}
+
+int cdr_arch_pass (struct CDR_ARCH *a, long id, struct CDR_PASS *d) {
+
+    /* Directory entry of pass id.  Returns 0 on success. */
+
+    if (id < 0 || id >= a->npass) {
+        fprintf (stderr, "Failed: no pass %ld in an archive of %ld\n", id, a->npass);
+        return (1);
+    }
+    unpack_entry (a->dir + (size_t)id * CDR_ARCH_ENTRY, d);
+    if (d->off < CDR_ARCH_HEAD || d->n < 0
+        || (size_t)d->off + CDR_HEADSIZE + (size_t)d->n * CDR_PACKED > a->maplen) {
+        fprintf (stderr, "Failed: pass %ld lies outside its archive\n", id);
+        return (1);
+    }
+    return (0);
+}
+
+const unsigned char *cdr_arch_raw (struct CDR_ARCH *a, struct CDR_PASS *d) {
+
+    /* The pass as a CDR file in the map: its header, then its packed points */
+
+    return ((const unsigned char *)a->map + d->off);
+}
+
+struct CDR *cdr_arch_load (struct CDR_ARCH *a, long id, struct CDR_HEAD *h, size_t *n) {
+
+    /* As cdr_load(), for pass id */
+
+    struct CDR_PASS d;
+    struct CDR *p;
+    const unsigned char *raw;
+
+    if (cdr_arch_pass (a, id, &d)) return (NULL);
+    if ((p = (struct CDR *) malloc ((d.n + 1) * sizeof (struct CDR))) == NULL) {
+        fprintf (stderr, "Failed to malloc %ld points for pass %ld\n", d.n, id);
+        return (NULL);
+    }
+    raw = cdr_arch_raw (a, &d);
+    cdr_head_unpack (raw, h);
+    cdr_unpack (raw + CDR_HEADSIZE, (size_t)d.n, p);
+    *n = (size_t)d.n;
+    return (p);
+}
+
+int cdr_arch_create (struct CDR_ARCHW *w, char *fname, int append) {
+
+    /* Start writing an archive, or with append add to one that exists.
+       Returns 0 on success. */
+
+    unsigned char b[CDR_ARCH_HEAD];
+    long    k, dir;
+
+    memset (w, 0, sizeof (*w));
+    if (append && access (fname, F_OK) == 0) {
+        if ((w->fp = fopen (fname, "r+b")) == NULL) {
+            fprintf (stderr, "Failed to open %s for appending\n", fname);
+            return (1);
+        }
+        if (fread (b, CDR_ARCH_HEAD, 1, w->fp) != 1 || check_head (b, &w->npass, &dir)) {
+            fprintf (stderr, "Failed: %s is not a CDR archive\n", fname);
+            fclose (w->fp);
+            return (1);
+        }
+        w->cap = w->npass + 1024;
+        if ((w->dir = (struct CDR_PASS *) malloc (w->cap * sizeof (struct CDR_PASS))) == NULL) {
+            fprintf (stderr, "Failed to malloc the directory of %s\n", fname);
+            fclose (w->fp);
+            return (1);
+        }
+        if (fseek (w->fp, dir, SEEK_SET)) k = 0;
+        else for (k = 0; k < w->npass && fread (b, CDR_ARCH_ENTRY, 1, w->fp) == 1; k++) unpack_entry (b, &w->dir[k]);
+        if (k < w->npass || fseek (w->fp, 0L, SEEK_END) || (w->end = ftell (w->fp)) < dir) {
+            fprintf (stderr, "Failed to read the directory of %s\n", fname);
+            fclose (w->fp);
+            free ( (void *)w->dir);
+            return (1);
+        }
+        return (0);
+    }
+    if ((w->fp = fopen (fname, "wb")) == NULL) {
+        fprintf (stderr, "Failed to open %s\n", fname);
+        return (1);
+    }
+    w->end = CDR_ARCH_HEAD;
+    pack_head (0L, w->end, b);
+    if (fwrite (b, CDR_ARCH_HEAD, 1, w->fp) != 1) {
+        fprintf (stderr, "Failed to write %s\n", fname);
+        fclose (w->fp);
+        return (1);
+    }
+    return (0);
+}
+
+static long add_entry (struct CDR_ARCHW *w, struct CDR_PASS *d) {
+    struct CDR_PASS *nd;
+
+    if (w->npass == w->cap) {
+        w->cap = (w->cap) ? 2 * w->cap : 1024;
+        if ((nd = (struct CDR_PASS *) realloc (w->dir, w->cap * sizeof (*nd))) == NULL) {
+            fprintf (stderr, "Failed to realloc archive directory\n");
+            w->err = 1;
+            return (-1);
+        }
+        w->dir = nd;
+    }
+    w->dir[w->npass] = *d;
+    w->end += CDR_HEADSIZE + d->n * CDR_PACKED;
+    return (w->npass++);
+}
+
+long cdr_arch_add (struct CDR_ARCHW *w, struct CDR_HEAD *h, struct CDR *p, size_t n) {
+
+    /* Write a pass; returns its id, or -1 on failure */
+
+    struct CDR_PASS d;
+    struct BOX b;
+    size_t  k;
+
+    memset (&b, 0, sizeof (b));
+    for (k = 0; k < n; k++) box_point (&b, p[k].time_1, p[k].lat, p[k].lon);
+    box_entry (&b, &d);
+    d.off = w->end;
+    d.n = (long)n;
+    d.isat = h->isat;
+    d.iasc = h->iasc;
+    d.ifile = h->ifile;
+    d.idt = h->idt;
+    if (w->err || cdr_write (w->fp, h, p, n)) {
+        w->err = 1;
+        return (-1);
+    }
+    return (add_entry (w, &d));
+}
+
+long cdr_arch_put (struct CDR_ARCHW *w, const unsigned char *raw, size_t n) {
+
+    /* Write a pass packed as a CDR file (header, then n points); returns
+       its id, or -1 */
+
+    struct CDR_PASS d;
+    struct CDR_HEAD h;
+    struct BOX b;
+    const unsigned char *r;
+    double  t;
+    float   lat, lon;
+    size_t  k, len;
+
+    memset (&b, 0, sizeof (b));
+    for (k = 0, r = raw + CDR_HEADSIZE; k < n; k++, r += CDR_PACKED) {
+        cdr_le (&t, r, 8);
+        cdr_le (&lat, r + 8, 4);
+        cdr_le (&lon, r + 12, 4);
+        box_point (&b, t, lat, lon);
+    }
+    box_entry (&b, &d);
+    cdr_head_unpack (raw, &h);
+    d.off = w->end;
+    d.n = (long)n;
+    d.isat = h.isat;
+    d.iasc = h.iasc;
+    d.ifile = h.ifile;
+    d.idt = h.idt;
+    len = CDR_HEADSIZE + n * CDR_PACKED;
+    if (w->err || fwrite (raw, 1, len, w->fp) != len) {
+        w->err = 1;
+        return (-1);
+    }
+    return (add_entry (w, &d));
+}
+
+long cdr_arch_copy (struct CDR_ARCHW *w, struct CDR_PASS *d, const unsigned char *raw) {
+
+    /* Write a pass already packed, such as cdr_arch_raw() of another
+       archive, with its directory entry; returns its id, or -1 */
+
+    struct CDR_PASS e;
+    size_t  len;
+
+    e = *d;
+    e.off = w->end;
+    len = CDR_HEADSIZE + (size_t)d->n * CDR_PACKED;
+    if (w->err || fwrite (raw, 1, len, w->fp) != len) {
+        w->err = 1;
+        return (-1);
+    }
+    return (add_entry (w, &e));
+}
+
+int cdr_arch_finish (struct CDR_ARCHW *w) {
+
+    /* Write the directory, then the header that points at it.  Returns 0
+       if every write since cdr_arch_create() succeeded. */
+
+    unsigned char b[CDR_ARCH_HEAD];
+    long    k;
+
+    if (!w->err) w->err = (fseek (w->fp, w->end, SEEK_SET) != 0);
+    for (k = 0; k < w->npass && !w->err; k++) {
+        pack_entry (&w->dir[k], b);
+        w->err = (fwrite (b, CDR_ARCH_ENTRY, 1, w->fp) != 1);
+    }
+    if (!w->err) {
+        pack_head (w->npass, w->end, b);
+        w->err = (fflush (w->fp) || fseek (w->fp, 0L, SEEK_SET) || fwrite (b, CDR_ARCH_HEAD, 1, w->fp) != 1);
+    }
+    w->err |= (fclose (w->fp) != 0);
+    if (w->err) fprintf (stderr, "Failure writing CDR archive\n");
+    free ( (void *)w->dir);
+    w->dir = NULL;
+    return (w->err);
+}
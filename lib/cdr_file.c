@@ -0,0 +1,217 @@
+/*  cdr_file.c
+
+ Reader and writer for CDR files (cdr.h).  The on-disk layout is fixed
+ (little endian, no padding), so everything here is memcpy of fields at
+ fixed offsets: no parsing, no per-point calls into stdio, and no limit
+ on the points in a pass.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "cdr.h"
+
+#define CHUNK   1024    /* points packed per fwrite */
+
+static int host_swaps (void) {
+
+    /* 1 on a big-endian host, where the file's bytes must be reversed */
+
+    unsigned int one = 1;
+
+    return (*(unsigned char *)&one == 0);
+}
+
+static void le (void *dst, const void *src, size_t len, int swap) {
+
+    /* Little endian to host or back: the same copy, reversed if swap */
+
+    unsigned char *d = (unsigned char *)dst;
+    const unsigned char *s = (const unsigned char *)src;
+    size_t  i;
+
+    if (!swap) memcpy (d, s, len);
+    else for (i = 0; i < len; i++) d[i] = s[len-1-i];
+}
+
+void cdr_le (void *dst, const void *src, size_t len) {
+    le (dst, src, len, host_swaps ());
+}
+
+void cdr_unpack (const unsigned char *raw, size_t n, struct CDR *p) {
+
+    /* n packed points to structs */
+
+    int     swap = host_swaps ();
+    size_t  k;
+
+    for (k = 0; k < n; k++, raw += CDR_PACKED, p++) {
+        le (&p->time_1, raw, 8, swap);
+        le (&p->lat, raw + 8, 4, swap);
+        le (&p->lon, raw + 12, 4, swap);
+        le (&p->sh, raw + 16, 4, swap);
+        le (&p->dsh, raw + 20, 4, swap);
+        le (&p->cor, raw + 24, 4, swap);
+    }
+}
+
+void cdr_pack (struct CDR *p, size_t n, unsigned char *raw) {
+
+    /* n structs to packed points */
+
+    int     swap = host_swaps ();
+    size_t  k;
+
+    for (k = 0; k < n; k++, raw += CDR_PACKED, p++) {
+        le (raw, &p->time_1, 8, swap);
+        le (raw + 8, &p->lat, 4, swap);
+        le (raw + 12, &p->lon, 4, swap);
+        le (raw + 16, &p->sh, 4, swap);
+        le (raw + 20, &p->dsh, 4, swap);
+        le (raw + 24, &p->cor, 4, swap);
+    }
+}
+
+void cdr_head_unpack (const unsigned char *raw, struct CDR_HEAD *h) {
+    int     swap = host_swaps ();
+
+    le (&h->isat, raw, 4, swap);
+    le (&h->iasc, raw + 4, 4, swap);
+    le (&h->ifile, raw + 8, 4, swap);
+    le (&h->idt, raw + 12, 4, swap);
+    le (&h->junk_1, raw + 16, 4, swap);
+    le (&h->junk_2, raw + 20, 4, swap);
+    le (&h->junk_3, raw + 24, 4, swap);
+}
+
+void cdr_head_pack (struct CDR_HEAD *h, unsigned char *raw) {
+    int     swap = host_swaps ();
+
+    le (raw, &h->isat, 4, swap);
+    le (raw + 4, &h->iasc, 4, swap);
+    le (raw + 8, &h->ifile, 4, swap);
+    le (raw + 12, &h->idt, 4, swap);
+    le (raw + 16, &h->junk_1, 4, swap);
+    le (raw + 20, &h->junk_2, 4, swap);
+    le (raw + 24, &h->junk_3, 4, swap);
+}
+
+int cdr_open (struct CDR_FILE *cf, char *fname) {
+
+    /* Map a CDR file; its points stay packed at cf->raw.  Returns 0 on success. */
+
+    struct stat st;
+
+    memset (cf, 0, sizeof (*cf));
+    if ((cf->fd = open (fname, O_RDONLY)) < 0) {
+        fprintf (stderr, "Failed to open %s\n", fname);
+        return (1);
+    }
+    if (fstat (cf->fd, &st) || st.st_size < CDR_HEADSIZE || (st.st_size - CDR_HEADSIZE) % CDR_PACKED) {
+        fprintf (stderr, "Failed: %s is not a CDR file\n", fname);
+        close (cf->fd);
+        return (1);
+    }
+    cf->maplen = (size_t)st.st_size;
+    cf->map = mmap (NULL, cf->maplen, PROT_READ, MAP_SHARED, cf->fd, 0);
+    if (cf->map == MAP_FAILED) {
+        fprintf (stderr, "Failed to mmap %s\n", fname);
+        close (cf->fd);
+        cf->map = NULL;
+        return (1);
+    }
+    cdr_head_unpack ((const unsigned char *)cf->map, &cf->h);
+    cf->raw = (const unsigned char *)cf->map + CDR_HEADSIZE;
+    cf->n = (cf->maplen - CDR_HEADSIZE) / CDR_PACKED;
+    return (0);
+}
+
+void cdr_close (struct CDR_FILE *cf) {
+    if (cf->map == NULL) return;
+    munmap (cf->map, cf->maplen);
+    close (cf->fd);
+    cf->map = NULL;
+    cf->raw = NULL;
+}
+
+struct CDR *cdr_load (char *fname, struct CDR_HEAD *h, size_t *n) {
+
+    /* The whole pass in fname, unpacked into a malloc'd array the caller
+       frees, or NULL.  *n is its length. */
+
+    struct CDR_FILE cf;
+    struct CDR *p;
+
+    if (cdr_open (&cf, fname)) return (NULL);
+    if ((p = (struct CDR *) malloc ((cf.n + 1) * sizeof (struct CDR))) == NULL) {
+        fprintf (stderr, "Failed to malloc %lu points for %s\n", (unsigned long)cf.n, fname);
+        cdr_close (&cf);
+        return (NULL);
+    }
+    cdr_unpack (cf.raw, cf.n, p);
+    *h = cf.h;
+    *n = cf.n;
+    cdr_close (&cf);
+    return (p);
+}
+
+struct CDR *cdr_read (FILE *fp, struct CDR_HEAD *h, size_t *n) {
+
+    /* As cdr_load(), from a stream (a pipe) positioned at a CDR file and
+       read to its end in large blocks. */
+
+    unsigned char head[CDR_HEADSIZE], *raw = NULL, *nr;
+    struct CDR *p;
+    size_t  len = 0, cap = 0, m;
+
+    if (fread (head, CDR_HEADSIZE, 1, fp) != 1) {
+        fprintf (stderr, "Failed: no CDR header\n");
+        return (NULL);
+    }
+    do {
+        if (len == cap) {
+            cap = (cap) ? 2 * cap : CHUNK * CDR_PACKED;
+            if ((nr = (unsigned char *) realloc (raw, cap)) == NULL) {
+                fprintf (stderr, "Failed to realloc CDR buffer\n");
+                free ( (void *)raw);
+                return (NULL);
+            }
+            raw = nr;
+        }
+        len += (m = fread (raw + len, 1, cap - len, fp));
+    } while (m > 0);
+    if (len % CDR_PACKED || (p = (struct CDR *) malloc ((len / CDR_PACKED + 1) * sizeof (struct CDR))) == NULL) {
+        fprintf (stderr, "Failed: CDR stream is %s\n", (len % CDR_PACKED) ? "not whole points" : "too large to unpack");
+        free ( (void *)raw);
+        return (NULL);
+    }
+    cdr_head_unpack (head, h);
+    *n = len / CDR_PACKED;
+    cdr_unpack (raw, *n, p);
+    free ( (void *)raw);
+    return (p);
+}
+
+int cdr_write (FILE *fp, struct CDR_HEAD *h, struct CDR *p, size_t n) {
+
+    /* Write a CDR file: the header and n points.  Returns 0 on success. */
+
+    unsigned char buf[CHUNK * CDR_PACKED];
+    size_t  k, m;
+
+    cdr_head_pack (h, buf);
+    if (fwrite (buf, CDR_HEADSIZE, 1, fp) != 1) return (1);
+    for (k = 0; k < n; k += m) {
+        m = (n - k < CHUNK) ? n - k : CHUNK;
+        cdr_pack (p + k, m, buf);
+        if (fwrite (buf, CDR_PACKED, m, fp) != m) return (1);
+    }
+    return (0);
+}
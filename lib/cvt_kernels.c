@@ -0,0 +1,465 @@
+/*  cvt_kernels.c
+
+ SIMD versions of the ingest conversions in cvt_kernels.h.
+
+ To stay bit-identical with the scalar code every kernel does the same IEEE
+ operations in the same order (a division stays a division), converts to
+ integer only values that are already whole and inside int range, and hands
+ any vector with an out-of-range or NaN lane to the scalar code.  Build
+ without FMA contraction (the makefile's -ansi implies -ffp-contract=off).
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "cvt_kernels.h"
+
+#define SOL 299792458.0                 /* speed of light in vacuum */
+#define TWO31 2147483648.0
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CVT_X86 1
+#include <immintrin.h>
+#endif
+
+static int level = -1;
+
+/* ---------------------------------------------------------------- scalar */
+
+static void round_scalar (const int *in, int *out, size_t n, double scale, int wrap) {
+    size_t k;
+    int    ix;
+    for (k = 0; k < n; k++) {
+        ix = (int)floor(in[k]/scale + .5);
+        if (wrap && ix < 0) ix = ix + 360000000;
+        out[k] = ix;
+    }
+}
+
+static void pack_scalar (const int *in, int *out, size_t n, double a, double b) {
+    size_t k;
+    for (k = 0; k < n; k++) out[k] = (int)floor(in[k]*a + b + .5);
+}
+
+static void delay_scalar (const long long *in, unsigned int *out, size_t n) {
+    size_t k;
+    for (k = 0; k < n; k++) out[k] = (unsigned int) floor(0.5 + in[k]*1.e-9*SOL/2.);
+}
+
+static void time_scalar (const double *in, unsigned int *sec, unsigned int *usec, size_t n, unsigned int nan) {
+    size_t k;
+    for (k = 0; k < n; k++) {
+        if (isnan(in[k])) {
+            sec[k] = nan;
+            usec[k] = nan;
+        } else {
+            sec[k] = floor(in[k]); /* double to unsigned int */
+            usec[k] = floor(1000000.0 * (in[k] - sec[k]));
+        }
+    }
+}
+
+static void sum_scalar (const unsigned short *wave, size_t ngate, unsigned int *sum, size_t n) {
+    size_t k, j;
+    unsigned int s;
+    for (k = 0; k < n; k++, wave += ngate) {
+        s = 0;
+        for (j = 0; j < ngate; j++) s = s + wave[j];
+        sum[k] = s;
+    }
+}
+
+#ifdef CVT_X86
+/* ------------------------------------------------------------------ SSE2 */
+
+static __m128d floor_sse2 (__m128d x) {
+    /* floor for |x| < 2^31: truncate, step down where truncation rounded up */
+    __m128d t = _mm_cvtepi32_pd (_mm_cvttpd_epi32 (x));
+    return (_mm_sub_pd (t, _mm_and_pd (_mm_cmpgt_pd (t, x), _mm_set1_pd (1.0))));
+}
+
+static int in_range_sse2 (__m128d x, double lo) {
+    /* both lanes in [lo, 2^31); false for NaN */
+    __m128d ok = _mm_and_pd (_mm_cmpge_pd (x, _mm_set1_pd (lo)), _mm_cmplt_pd (x, _mm_set1_pd (TWO31)));
+    return (_mm_movemask_pd (ok) == 3);
+}
+
+static void round_sse2 (const int *in, int *out, size_t n, double scale, int wrap) {
+    __m128d vs = _mm_set1_pd (scale), half = _mm_set1_pd (.5), x;
+    __m128i r, c360 = _mm_set1_epi32 (360000000), zero = _mm_setzero_si128 ();
+    size_t  k;
+    for (k = 0; k + 2 <= n; k += 2) {
+        x = _mm_add_pd (_mm_div_pd (_mm_cvtepi32_pd (_mm_loadl_epi64 ((const __m128i *)(in + k))), vs), half);
+        if (!in_range_sse2 (x, -TWO31 + 1.)) {
+            round_scalar (in + k, out + k, 2, scale, wrap);
+            continue;
+        }
+        r = _mm_cvttpd_epi32 (floor_sse2 (x));
+        if (wrap) r = _mm_add_epi32 (r, _mm_and_si128 (_mm_cmplt_epi32 (r, zero), c360));
+        _mm_storel_epi64 ((__m128i *)(out + k), r);
+    }
+    round_scalar (in + k, out + k, n - k, scale, wrap);
+}
+
+static void pack_sse2 (const int *in, int *out, size_t n, double a, double b) {
+    __m128d va = _mm_set1_pd (a), vb = _mm_set1_pd (b), half = _mm_set1_pd (.5), x;
+    size_t  k;
+    for (k = 0; k + 2 <= n; k += 2) {
+        x = _mm_cvtepi32_pd (_mm_loadl_epi64 ((const __m128i *)(in + k)));
+        x = _mm_add_pd (_mm_add_pd (_mm_mul_pd (x, va), vb), half);
+        if (!in_range_sse2 (x, -TWO31 + 1.)) {
+            pack_scalar (in + k, out + k, 2, a, b);
+            continue;
+        }
+        _mm_storel_epi64 ((__m128i *)(out + k), _mm_cvttpd_epi32 (floor_sse2 (x)));
+    }
+    pack_scalar (in + k, out + k, n - k, a, b);
+}
+
+static void delay_sse2 (const long long *in, unsigned int *out, size_t n) {
+    __m128d x, c9 = _mm_set1_pd (1.e-9), sol = _mm_set1_pd (SOL), two = _mm_set1_pd (2.), half = _mm_set1_pd (0.5);
+    size_t  k;
+    for (k = 0; k + 2 <= n; k += 2) {
+        x = _mm_set_pd ((double)in[k+1], (double)in[k]);
+        x = _mm_add_pd (half, _mm_div_pd (_mm_mul_pd (_mm_mul_pd (x, c9), sol), two));
+        if (!in_range_sse2 (x, 0.)) {
+            delay_scalar (in + k, out + k, 2);
+            continue;
+        }
+        _mm_storel_epi64 ((__m128i *)(out + k), _mm_cvttpd_epi32 (floor_sse2 (x)));
+    }
+    delay_scalar (in + k, out + k, n - k);
+}
+
+static void time_sse2 (const double *in, unsigned int *sec, unsigned int *usec, size_t n, unsigned int nan) {
+    __m128d t, fl, mic = _mm_set1_pd (1000000.0);
+    size_t  k;
+    for (k = 0; k + 2 <= n; k += 2) {
+        t = _mm_loadu_pd (in + k);
+        if (!in_range_sse2 (t, 0.)) {
+            time_scalar (in + k, sec + k, usec + k, 2, nan);
+            continue;
+        }
+        fl = floor_sse2 (t);
+        _mm_storel_epi64 ((__m128i *)(sec + k), _mm_cvttpd_epi32 (fl));
+        _mm_storel_epi64 ((__m128i *)(usec + k), _mm_cvttpd_epi32 (floor_sse2 (_mm_mul_pd (mic, _mm_sub_pd (t, fl)))));
+    }
+    time_scalar (in + k, sec + k, usec + k, n - k, nan);
+}
+
+static void sum_sse2 (const unsigned short *wave, size_t ngate, unsigned int *sum, size_t n) {
+    __m128i acc, v, zero = _mm_setzero_si128 ();
+    unsigned int part[4], s;
+    size_t  k, j;
+    for (k = 0; k < n; k++, wave += ngate) {
+        acc = zero;
+        for (j = 0; j + 8 <= ngate; j += 8) {
+            v = _mm_loadu_si128 ((const __m128i *)(wave + j));
+            acc = _mm_add_epi32 (acc, _mm_add_epi32 (_mm_unpacklo_epi16 (v, zero), _mm_unpackhi_epi16 (v, zero)));
+        }
+        _mm_storeu_si128 ((__m128i *)part, acc);
+        s = part[0] + part[1] + part[2] + part[3];
+        for (; j < ngate; j++) s = s + wave[j];
+        sum[k] = s;
+    }
+}
+
+/* ------------------------------------------------------------------ AVX2 */
+
+__attribute__((target("avx2")))
+static int in_range_avx2 (__m256d x, double lo) {
+    __m256d ok = _mm256_and_pd (_mm256_cmp_pd (x, _mm256_set1_pd (lo), _CMP_GE_OQ),
+                                _mm256_cmp_pd (x, _mm256_set1_pd (TWO31), _CMP_LT_OQ));
+    return (_mm256_movemask_pd (ok) == 15);
+}
+
+__attribute__((target("avx2")))
+static void round_avx2 (const int *in, int *out, size_t n, double scale, int wrap) {
+    __m256d vs = _mm256_set1_pd (scale), half = _mm256_set1_pd (.5), x;
+    __m128i r, c360 = _mm_set1_epi32 (360000000), zero = _mm_setzero_si128 ();
+    size_t  k;
+    for (k = 0; k + 4 <= n; k += 4) {
+        x = _mm256_add_pd (_mm256_div_pd (_mm256_cvtepi32_pd (_mm_loadu_si128 ((const __m128i *)(in + k))), vs), half);
+        if (!in_range_avx2 (x, -TWO31 + 1.)) {
+            round_scalar (in + k, out + k, 4, scale, wrap);
+            continue;
+        }
+        r = _mm256_cvttpd_epi32 (_mm256_floor_pd (x));
+        if (wrap) r = _mm_add_epi32 (r, _mm_and_si128 (_mm_cmplt_epi32 (r, zero), c360));
+        _mm_storeu_si128 ((__m128i *)(out + k), r);
+    }
+    round_scalar (in + k, out + k, n - k, scale, wrap);
+}
+
+__attribute__((target("avx2")))
+static void pack_avx2 (const int *in, int *out, size_t n, double a, double b) {
+    __m256d va = _mm256_set1_pd (a), vb = _mm256_set1_pd (b), half = _mm256_set1_pd (.5), x;
+    size_t  k;
+    for (k = 0; k + 4 <= n; k += 4) {
+        x = _mm256_cvtepi32_pd (_mm_loadu_si128 ((const __m128i *)(in + k)));
+        x = _mm256_add_pd (_mm256_add_pd (_mm256_mul_pd (x, va), vb), half);
+        if (!in_range_avx2 (x, -TWO31 + 1.)) {
+            pack_scalar (in + k, out + k, 4, a, b);
+            continue;
+        }
+        _mm_storeu_si128 ((__m128i *)(out + k), _mm256_cvttpd_epi32 (_mm256_floor_pd (x)));
+    }
+    pack_scalar (in + k, out + k, n - k, a, b);
+}
+
+__attribute__((target("avx2")))
+static void delay_avx2 (const long long *in, unsigned int *out, size_t n) {
+    /* int64 to double exactly for |in| < 2^51: add the bits of 1.5*2^52 and subtract it as a double */
+    __m256d magic = _mm256_set1_pd (6755399441055744.0), x;
+    __m256d c9 = _mm256_set1_pd (1.e-9), sol = _mm256_set1_pd (SOL), two = _mm256_set1_pd (2.), half = _mm256_set1_pd (0.5);
+    __m256i v, lim = _mm256_set1_epi64x (1LL << 51), nlim = _mm256_set1_epi64x (-(1LL << 51));
+    size_t  k;
+    for (k = 0; k + 4 <= n; k += 4) {
+        v = _mm256_loadu_si256 ((const __m256i *)(in + k));
+        if (_mm256_movemask_epi8 (_mm256_or_si256 (_mm256_cmpgt_epi64 (v, lim), _mm256_cmpgt_epi64 (nlim, v)))) {
+            delay_scalar (in + k, out + k, 4);
+            continue;
+        }
+        x = _mm256_sub_pd (_mm256_castsi256_pd (_mm256_add_epi64 (v, _mm256_castpd_si256 (magic))), magic);
+        x = _mm256_add_pd (half, _mm256_div_pd (_mm256_mul_pd (_mm256_mul_pd (x, c9), sol), two));
+        if (!in_range_avx2 (x, 0.)) {
+            delay_scalar (in + k, out + k, 4);
+            continue;
+        }
+        _mm_storeu_si128 ((__m128i *)(out + k), _mm256_cvttpd_epi32 (_mm256_floor_pd (x)));
+    }
+    delay_scalar (in + k, out + k, n - k);
+}
+
+__attribute__((target("avx2")))
+static void time_avx2 (const double *in, unsigned int *sec, unsigned int *usec, size_t n, unsigned int nan) {
+    __m256d t, fl, mic = _mm256_set1_pd (1000000.0);
+    size_t  k;
+    for (k = 0; k + 4 <= n; k += 4) {
+        t = _mm256_loadu_pd (in + k);
+        if (!in_range_avx2 (t, 0.)) {
+            time_scalar (in + k, sec + k, usec + k, 4, nan);
+            continue;
+        }
+        fl = _mm256_floor_pd (t);
+        _mm_storeu_si128 ((__m128i *)(sec + k), _mm256_cvttpd_epi32 (fl));
+        _mm_storeu_si128 ((__m128i *)(usec + k), _mm256_cvttpd_epi32 (_mm256_floor_pd (_mm256_mul_pd (mic, _mm256_sub_pd (t, fl)))));
+    }
+    time_scalar (in + k, sec + k, usec + k, n - k, nan);
+}
+
+__attribute__((target("avx2")))
+static void sum_avx2 (const unsigned short *wave, size_t ngate, unsigned int *sum, size_t n) {
+    __m256i acc, v, zero = _mm256_setzero_si256 ();
+    __m128i h;
+    unsigned int s;
+    size_t  k, j;
+    for (k = 0; k < n; k++, wave += ngate) {
+        acc = zero;
+        for (j = 0; j + 16 <= ngate; j += 16) {
+            v = _mm256_loadu_si256 ((const __m256i *)(wave + j));
+            acc = _mm256_add_epi32 (acc, _mm256_add_epi32 (_mm256_unpacklo_epi16 (v, zero), _mm256_unpackhi_epi16 (v, zero)));
+        }
+        h = _mm_add_epi32 (_mm256_castsi256_si128 (acc), _mm256_extracti128_si256 (acc, 1));
+        h = _mm_add_epi32 (h, _mm_shuffle_epi32 (h, 0x4e));
+        h = _mm_add_epi32 (h, _mm_shuffle_epi32 (h, 0xb1));
+        s = (unsigned int)_mm_cvtsi128_si32 (h);
+        for (; j < ngate; j++) s = s + wave[j];
+        sum[k] = s;
+    }
+}
+
+/* --------------------------------------------------------------- AVX-512 */
+
+__attribute__((target("avx512f,avx512dq")))
+static int in_range_avx512 (__m512d x, double lo) {
+    return ((_mm512_cmp_pd_mask (x, _mm512_set1_pd (lo), _CMP_GE_OQ)
+           & _mm512_cmp_pd_mask (x, _mm512_set1_pd (TWO31), _CMP_LT_OQ)) == 0xff);
+}
+
+__attribute__((target("avx512f,avx512dq")))
+static void round_avx512 (const int *in, int *out, size_t n, double scale, int wrap) {
+    __m512d vs = _mm512_set1_pd (scale), half = _mm512_set1_pd (.5), x;
+    __m256i r, c360 = _mm256_set1_epi32 (360000000), zero = _mm256_setzero_si256 ();
+    size_t  k;
+    for (k = 0; k + 8 <= n; k += 8) {
+        x = _mm512_add_pd (_mm512_div_pd (_mm512_cvtepi32_pd (_mm256_loadu_si256 ((const __m256i *)(in + k))), vs), half);
+        if (!in_range_avx512 (x, -TWO31 + 1.)) {
+            round_scalar (in + k, out + k, 8, scale, wrap);
+            continue;
+        }
+        r = _mm512_cvttpd_epi32 (_mm512_roundscale_pd (x, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC));
+        if (wrap) r = _mm256_add_epi32 (r, _mm256_and_si256 (_mm256_cmpgt_epi32 (zero, r), c360));
+        _mm256_storeu_si256 ((__m256i *)(out + k), r);
+    }
+    round_scalar (in + k, out + k, n - k, scale, wrap);
+}
+
+__attribute__((target("avx512f,avx512dq")))
+static void pack_avx512 (const int *in, int *out, size_t n, double a, double b) {
+    __m512d va = _mm512_set1_pd (a), vb = _mm512_set1_pd (b), half = _mm512_set1_pd (.5), x;
+    size_t  k;
+    for (k = 0; k + 8 <= n; k += 8) {
+        x = _mm512_cvtepi32_pd (_mm256_loadu_si256 ((const __m256i *)(in + k)));
+        x = _mm512_add_pd (_mm512_add_pd (_mm512_mul_pd (x, va), vb), half);
+        if (!in_range_avx512 (x, -TWO31 + 1.)) {
+            pack_scalar (in + k, out + k, 8, a, b);
+            continue;
+        }
+        _mm256_storeu_si256 ((__m256i *)(out + k), _mm512_cvttpd_epi32 (_mm512_roundscale_pd (x, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC)));
+    }
+    pack_scalar (in + k, out + k, n - k, a, b);
+}
+
+__attribute__((target("avx512f,avx512dq")))
+static void delay_avx512 (const long long *in, unsigned int *out, size_t n) {
+    __m512d c9 = _mm512_set1_pd (1.e-9), sol = _mm512_set1_pd (SOL), two = _mm512_set1_pd (2.), half = _mm512_set1_pd (0.5), x;
+    __m512i v, lim = _mm512_set1_epi64 (1LL << 53);
+    size_t  k;
+    for (k = 0; k + 8 <= n; k += 8) {
+        v = _mm512_loadu_si512 ((const void *)(in + k));
+        /* _mm512_cvtepi64_pd rounds like the scalar conversion, but keep to
+           |in| <= 2^53 where both are exact */
+        if (_mm512_cmpgt_epi64_mask (_mm512_abs_epi64 (v), lim)) {
+            delay_scalar (in + k, out + k, 8);
+            continue;
+        }
+        x = _mm512_add_pd (half, _mm512_div_pd (_mm512_mul_pd (_mm512_mul_pd (_mm512_cvtepi64_pd (v), c9), sol), two));
+        if (!in_range_avx512 (x, 0.)) {
+            delay_scalar (in + k, out + k, 8);
+            continue;
+        }
+        _mm256_storeu_si256 ((__m256i *)(out + k), _mm512_cvttpd_epi32 (_mm512_roundscale_pd (x, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC)));
+    }
+    delay_scalar (in + k, out + k, n - k);
+}
+
+__attribute__((target("avx512f,avx512dq")))
+static void time_avx512 (const double *in, unsigned int *sec, unsigned int *usec, size_t n, unsigned int nan) {
+    __m512d t, fl, mic = _mm512_set1_pd (1000000.0);
+    size_t  k;
+    for (k = 0; k + 8 <= n; k += 8) {
+        t = _mm512_loadu_pd (in + k);
+        if (!in_range_avx512 (t, 0.)) {
+            time_scalar (in + k, sec + k, usec + k, 8, nan);
+            continue;
+        }
+        fl = _mm512_roundscale_pd (t, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+        _mm256_storeu_si256 ((__m256i *)(sec + k), _mm512_cvttpd_epi32 (fl));
+        _mm256_storeu_si256 ((__m256i *)(usec + k), _mm512_cvttpd_epi32 (_mm512_roundscale_pd (
+            _mm512_mul_pd (mic, _mm512_sub_pd (t, fl)), _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC)));
+    }
+    time_scalar (in + k, sec + k, usec + k, n - k, nan);
+}
+
+__attribute__((target("avx512f,avx512dq")))
+static void sum_avx512 (const unsigned short *wave, size_t ngate, unsigned int *sum, size_t n) {
+    __m512i acc;
+    unsigned int s;
+    size_t  k, j;
+    for (k = 0; k < n; k++, wave += ngate) {
+        acc = _mm512_setzero_si512 ();
+        for (j = 0; j + 16 <= ngate; j += 16)
+            acc = _mm512_add_epi32 (acc, _mm512_cvtepu16_epi32 (_mm256_loadu_si256 ((const __m256i *)(wave + j))));
+        s = (unsigned int)_mm512_reduce_add_epi32 (acc);
+        for (; j < ngate; j++) s = s + wave[j];
+        sum[k] = s;
+    }
+}
+#endif /* CVT_X86 */
+
+/* -------------------------------------------------------------- dispatch */
+
+char *cvt_level_name (int lev) {
+    static char *names[] = {"scalar", "sse2", "avx2", "avx512"};
+    return ((lev >= CVT_SCALAR && lev <= CVT_AVX512) ? names[lev] : "unknown");
+}
+
+int cvt_set_level (int lev) {
+
+    /* Use kernel set lev, or the best one the CPU supports if it lacks lev.
+       Returns the level now in use. */
+
+    int best = CVT_SCALAR;
+#ifdef CVT_X86
+    __builtin_cpu_init ();
+    if (__builtin_cpu_supports ("sse2")) best = CVT_SSE2;
+    if (__builtin_cpu_supports ("avx2")) best = CVT_AVX2;
+    if (__builtin_cpu_supports ("avx512f") && __builtin_cpu_supports ("avx512dq")) best = CVT_AVX512;
+#endif
+    level = (lev < CVT_SCALAR || lev > best) ? best : lev;
+    return (level);
+}
+
+int cvt_level (void) {
+    char *env;
+    int  lev;
+    if (level < 0) {
+        lev = CVT_AVX512;
+        if ((env = getenv ("CVT_SIMD")) != NULL) {
+            for (lev = CVT_SCALAR; lev < CVT_AVX512; lev++) {
+                if (!strcmp (env, cvt_level_name (lev))) break;
+            }
+        }
+        cvt_set_level (lev);
+    }
+    return (level);
+}
+
+void cvt_round (const int *in, int *out, size_t n, double scale, int wrap) {
+    switch (cvt_level ()) {
+#ifdef CVT_X86
+        case CVT_AVX512: round_avx512 (in, out, n, scale, wrap); return;
+        case CVT_AVX2: round_avx2 (in, out, n, scale, wrap); return;
+        case CVT_SSE2: round_sse2 (in, out, n, scale, wrap); return;
+#endif
+    }
+    round_scalar (in, out, n, scale, wrap);
+}
+
+void cvt_pack (const int *in, int *out, size_t n, double a, double b) {
+    switch (cvt_level ()) {
+#ifdef CVT_X86
+        case CVT_AVX512: pack_avx512 (in, out, n, a, b); return;
+        case CVT_AVX2: pack_avx2 (in, out, n, a, b); return;
+        case CVT_SSE2: pack_sse2 (in, out, n, a, b); return;
+#endif
+    }
+    pack_scalar (in, out, n, a, b);
+}
+
+void cvt_delay (const long long *in, unsigned int *out, size_t n) {
+    switch (cvt_level ()) {
+#ifdef CVT_X86
+        case CVT_AVX512: delay_avx512 (in, out, n); return;
+        case CVT_AVX2: delay_avx2 (in, out, n); return;
+        case CVT_SSE2: delay_sse2 (in, out, n); return;
+#endif
+    }
+    delay_scalar (in, out, n);
+}
+
+void cvt_time (const double *in, unsigned int *sec, unsigned int *usec, size_t n, unsigned int nan) {
+    switch (cvt_level ()) {
+#ifdef CVT_X86
+        case CVT_AVX512: time_avx512 (in, sec, usec, n, nan); return;
+        case CVT_AVX2: time_avx2 (in, sec, usec, n, nan); return;
+        case CVT_SSE2: time_sse2 (in, sec, usec, n, nan); return;
+#endif
+    }
+    time_scalar (in, sec, usec, n, nan);
+}
+
+void cvt_wave_sum (const unsigned short *wave, size_t ngate, unsigned int *sum, size_t n) {
+    switch (cvt_level ()) {
+#ifdef CVT_X86
+        case CVT_AVX512: sum_avx512 (wave, ngate, sum, n); return;
+        case CVT_AVX2: sum_avx2 (wave, ngate, sum, n); return;
+        case CVT_SSE2: sum_sse2 (wave, ngate, sum, n); return;
+#endif
+    }
+    sum_scalar (wave, ngate, sum, n);
+}
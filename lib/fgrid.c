@@ -0,0 +1,68 @@
+/*  fgrid.c
+
+ Writer for the float grids of fgrid.h.  fgrid_create() writes the header
+ and sizes the file, so the rows can then go in with pwrite() in any order
+ and from any thread; rows never written read back as zeros.
+ */
+
+#define _XOPEN_SOURCE 600   /* pwrite() */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "fgrid.h"
+
+int fgrid_create (char *fname, struct FGRID_HEAD *h) {
+
+    /* A descriptor for a new grid file, or -1 on failure */
+
+    off_t   len;
+    int     fd;
+
+    memcpy (h->magic, FGRID_MAGIC, 8);
+    h->endian = FGRID_ENDIAN;
+    h->version = FGRID_VERSION;
+    len = (off_t)sizeof (*h) + (off_t)h->nplane * h->ny * h->nx * sizeof (float);
+    if ((fd = open (fname, O_RDWR | O_CREAT | O_TRUNC, 0666)) < 0) {
+        fprintf (stderr, "Failed to open %s\n", fname);
+        return (-1);
+    }
+    if (pwrite (fd, h, sizeof (*h), 0) != (ssize_t)sizeof (*h) || ftruncate (fd, len)) {
+        fprintf (stderr, "Failed to write %s\n", fname);
+        close (fd);
+        return (-1);
+    }
+    return (fd);
+}
+
+int fgrid_put (int fd, struct FGRID_HEAD *h, int plane, int row0, int nrow, float *v) {
+
+    /* Rows row0 .. row0+nrow-1 of a plane from v, nx a row; 0 on success */
+
+    size_t  len = (size_t)nrow * h->nx * sizeof (float), done;
+    off_t   off = (off_t)sizeof (*h) + ((off_t)plane * h->ny + row0) * h->nx * sizeof (float);
+    ssize_t k;
+
+    for (done = 0; done < len; done += (size_t)k) {
+        if ((k = pwrite (fd, (char *)v + done, len - done, off + (off_t)done)) <= 0) {
+            fprintf (stderr, "Failed to write grid rows %d to %d\n", row0, row0 + nrow - 1);
+            return (1);
+        }
+    }
+    return (0);
+}
+
+int fgrid_close (int fd) {
+
+    /* Returns 0 when everything reached the file */
+
+    int     err = (fsync (fd) != 0);
+
+    err |= (close (fd) != 0);
+    if (err) fprintf (stderr, "Failed to close grid\n");
+    return (err);
+}
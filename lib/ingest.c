@@ -0,0 +1,331 @@
+/*  ingest.c
+
+ Mission-independent driver for the stage 00 readers.  The body of
+ ingest_file() is what handle_one_file() in cryosat20hz.c grew into: open
+ the file, check its dimensions, resolve the mission's field table, then
+ read, convert and write the records window by window.  A file that
+ fails part way writes nothing: its windows are taken back off a seekable
+ output, or held in a scratch file until the last one when the output is
+ a pipe and there is more than one window.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/types.h>
+#include <netcdf.h>
+#include "ingest.h"
+#include "run_parallel.h"
+#include "wave_plane.h"
+#include "rec_file.h"
+#include "rec_index.h"
+
+static struct MISSION *mission;     /* for handle_one_file() in worker processes */
+
+static size_t    mem_cap = 0;       /* -m: bytes of record and column workspace per file, 0 for whole file */
+static int       map_mode = NCF_MAP_NEAREST;   /* -i: how 1 Hz corrections are expanded to 20 Hz */
+static char      *ofile = NULL;     /* -o: write a record container (rec_file.h) here instead of raw records to stdout */
+static int       zwave = 0;         /* -z: compress the container's waveforms (wave_codec.h) */
+static int       thin = 0;          /* -t: leave the waveforms out of the container */
+
+static int copy_out (FILE *from, char *fname) {
+
+    /* Append a file's scratch output to stdout; 0 on success */
+
+    static char buf[65536];
+    size_t  nr;
+
+    rewind (from);
+    while ((nr = fread (buf, 1, sizeof (buf), from)) > 0) {
+        if (fwrite (buf, 1, nr, stdout) != nr) break;
+    }
+    if (ferror (from) || ferror (stdout)) {
+        fprintf (stderr, "Failure writing output for file %s\n", fname);
+        return (1);
+    }
+    return (0);
+}
+
+static size_t handle_one_file (char *fname) {
+    return (ingest_file (mission, fname));
+}
+
+static void usage (struct MISSION *ms) {
+    fprintf (stderr, "usage: %s [-j njobs] [-f var1,var2,...] [-m MB] [-o file.rec [-z | -t]] [-i nearest|linear|index] file1.nc file2.nc ... > output_binary_%s_structures\n", ms->prog, ms->out);
+    fprintf (stderr, "\t-j  process up to njobs files at once in worker processes; output stays in file order\n");
+    fprintf (stderr, "\t-f  load only the listed NetCDF variables; other members are written as zero\n");
+    fprintf (stderr, "\t-m  stream each file in record windows using at most MB of workspace per worker\n");
+    fprintf (stderr, "\t-o  write the records to file.rec with a header giving mission, layout, count and time range,\n");
+    fprintf (stderr, "\t    so that later stages can check and mmap it (see rec_file.h), and a block index\n");
+    fprintf (stderr, "\t    file.rec.idx for rec_query\n");
+    fprintf (stderr, "\t-z  with -o, store the waveforms losslessly compressed; read such files with rec_get()\n");
+    fprintf (stderr, "\t-t  with -o, write thin records without the waveform, for stages that do not retrack\n");
+    fprintf (stderr, "\t-i  expand 1 Hz corrections by the nearest 1 Hz time (default), linearly in time,\n");
+    fprintf (stderr, "\t    or by the old index rule k/20 which assumes no gaps\n");
+    fprintf (stderr, "\tSet CVT_SIMD=scalar|sse2|avx2|avx512 to force a conversion kernel set (default: best available)\n");
+}
+
+int ingest_main (struct MISSION *ms, int argc, char **argv) {
+
+    struct timespec t0, t1;
+    struct NC_FIELD *ft = NULL;
+    struct REC_HEAD head;
+    char   *idxname;
+    double secs;
+    size_t n_out = 0;
+    int    c, k, m, njobs = 1;
+
+    mission = ms;
+    clock_gettime (CLOCK_MONOTONIC, &t0);
+    /* A table that no longer matches the struct's layout constant would write
+       records that downstream tools mistake for the old layout */
+    if (rec_layout (ms->fields, ms->nfields, ms->recsize) != ms->layout) {
+        fprintf (stderr, "Failed: %s field table has layout %08x, its header says %08x; update the header\n",
+            ms->prog, rec_layout (ms->fields, ms->nfields, ms->recsize), ms->layout);
+        return (EXIT_FAILURE);
+    }
+    while ((c = getopt (argc, argv, "j:f:m:po:i:zt")) != -1) {
+        switch (c) {
+            case 'j':   /* number of worker processes */
+                njobs = atoi (optarg);
+                break;
+            case 'f':   /* load only these NetCDF variables */
+                if (ncf_select (ms->fields, ms->nfields, optarg) <= 0) njobs = 0;
+                break;
+            case 'm':   /* stream each file in windows using at most this many MB */
+                mem_cap = (size_t)(atof (optarg) * 1024. * 1024.);
+                break;
+            case 'o':   /* record container */
+                ofile = optarg;
+                break;
+            case 'z':   /* compressed waveforms */
+                zwave = 1;
+                break;
+            case 't':   /* thin records */
+                thin = 1;
+                break;
+            case 'i':   /* 1 Hz to 20 Hz expansion */
+                if ((map_mode = ncf_map_mode (optarg)) < 0) njobs = 0;
+                break;
+            default:
+                njobs = 0;
+                break;
+        }
+    }
+    if ((zwave || thin) && (ofile == NULL || ms->scalar_size == ms->recsize)) njobs = 0;  /* -z and -t need -o and a waveform */
+    if (zwave && thin) njobs = 0;
+    if (ofile != NULL && njobs > 0) {
+        /* The container header says where time, position and surface flag are */
+        for (m = 0; m < ms->nfields; m++) {
+            if (ms->fields[m].conv == NCF_TIME) ft = &ms->fields[m];
+        }
+        if (ft == NULL) {
+            fprintf (stderr, "Failed: %s has no time field for the record file header\n", ms->prog);
+            return (EXIT_FAILURE);
+        }
+        memset (&head, 0, sizeof (head));
+        head.mission = ms->id;
+        head.recsize = (unsigned int)ms->recsize;
+        head.layout = ms->layout;
+        head.keys.sec = ft->offset;
+        head.keys.usec = ft->offset2;
+        head.keys.lat = ms->lat;
+        head.keys.lon = ms->lon;
+        head.keys.surf = ms->surf;
+        head.keys.nan = (unsigned int)ft->nan;
+        if (ms->scalar_size < ms->recsize) {
+            head.wave = (unsigned short)ms->scalar_size;
+            head.ngate = (unsigned short)((ms->recsize - ms->scalar_size) / sizeof (unsigned short));
+        }
+        head.flags = (zwave) ? REC_ZWAVE : (thin) ? REC_THIN : 0;
+        if (freopen (ofile, "w+b", stdout) == NULL) {
+            fprintf (stderr, "Failed to open %s\n", ofile);
+            return (EXIT_FAILURE);
+        }
+        if (rec_write_head (stdout, &head)) return (EXIT_FAILURE);
+    }
+    if (njobs > 1) {
+        n_out = run_parallel (argc - optind, &argv[optind], njobs, handle_one_file);
+    } else if (njobs == 1) {
+        for (k = optind; k < argc; k++) {
+            n_out += handle_one_file (argv[k]);
+        }
+    }
+    if (n_out == 0) {
+        usage (ms);
+        return (EXIT_FAILURE);
+    }
+    if (ofile != NULL) {
+        /* Header totals, and the block index beside the file as file.rec.idx */
+        if ((idxname = (char *) malloc (strlen (ofile) + 5)) == NULL) return (EXIT_FAILURE);
+        sprintf (idxname, "%s.idx", ofile);
+        if (rec_finish (stdout, idxname)) return (EXIT_FAILURE);
+        free ( (void *)idxname);
+    }
+    /* Wall-clock time and rate of the run */
+    clock_gettime (CLOCK_MONOTONIC, &t1);
+    secs = (t1.tv_sec - t0.tv_sec) + 1.e-9 * (t1.tv_nsec - t0.tv_nsec);
+    fprintf (stderr, "%s wrote %zu records to %s in %.2f s (%.0f records/s).\n", ms->prog, n_out,
+        (ofile != NULL) ? ofile : "stdout", secs,
+        (secs > 0.) ? n_out / secs : 0.);
+    return (EXIT_SUCCESS);
+}
+
+static int dim_length (int ncfid, char *fname, char *dim, size_t *len) {
+
+    /* Length of a named dimension; 0 on success. */
+
+    int     nc_err, ncdimid;
+
+    nc_err = nc_inq_dimid (ncfid, dim, &ncdimid);
+    if (nc_err != NC_NOERR) {
+        fprintf (stderr, "Failed to get %s dimension ID in %s\n", dim, fname);
+        fprintf (stderr, "NetCDF Error Message %s\n", nc_strerror(nc_err));
+        return (1);
+    }
+    nc_err = nc_inq_dimlen (ncfid, ncdimid, len);
+    if ( (nc_err != NC_NOERR) || (*len == 0) ) {
+        fprintf (stderr, "Failed to get %s dimension length in %s\n", dim, fname);
+        fprintf (stderr, "NetCDF Error Message %s\n", nc_strerror(nc_err));
+        return (1);
+    }
+    return (0);
+}
+
+size_t ingest_file (struct MISSION *ms, char *fname) {
+
+    /* Returns number of records successfully processed. */
+
+    struct NCF_VAR *vars, *tvar;
+    struct NCF_MAP map;
+    FILE    *out = stdout;
+    off_t   start;
+    char    *scal;
+    unsigned short *plane;
+    size_t  retval = 0, n20 = 0, n01 = 0, j;
+    size_t  k0, n, nwin;
+    int     nc_err, ncfid, ngate, m;
+
+    /* Open the file: */
+    nc_err = nc_open (fname, NC_NOWRITE, &ncfid);
+    if (nc_err != NC_NOERR) {
+        fprintf (stderr, "Failed to open %s\n", fname);
+        fprintf (stderr, "NetCDF Error Message %s\n", nc_strerror(nc_err));
+        return (retval);
+    }
+
+    fprintf (stderr, "Opened %s\n", fname);
+
+    /* Find out how many 20 Hz records and 1 Hz correction rows the file has */
+    if (dim_length (ncfid, fname, ms->dim20, &n20) || dim_length (ncfid, fname, ms->dim01, &n01)) {
+        nc_close (ncfid);
+        return (retval);
+    }
+    n20 = n20 * ms->nsub;
+
+    /* Resolve every variable in the table before reading anything: */
+    vars = ncf_resolve (ncfid, fname, ms->fields, ms->nfields, ms->nsub);
+    if (vars == NULL) {
+        nc_close (ncfid);
+        return (retval);
+    }
+
+    /* 1 Hz times, for matching corrections to records: */
+    if (ncf_map_open (ncfid, fname, &map, map_mode, ms->time01, n01, ms->nsub)) {
+        nc_close (ncfid);
+        ncf_free (vars, ms->nfields);
+        ncf_map_free (&map);
+        return (retval);
+    }
+
+    /* The table's 20 Hz time, which the map reads once for both of them */
+    for (m = 0, tvar = NULL; m < ms->nfields && tvar == NULL; m++) {
+        if (ms->fields[m].use && !strcmp (ms->fields[m].name, ms->time20)) tvar = &vars[m];
+    }
+
+    /* Waveforms are read straight into their own plane, not into the records */
+    ngate = ncf_use_plane (vars, ms->nfields);
+
+    /* Records per window: the whole file, or as many whole rows as fit in mem_cap */
+    nwin = n20;
+    if (mem_cap > 0) {
+        nwin = mem_cap / (ms->recsize + ncf_recbytes (vars, ms->nfields));
+        if (nwin < 20) nwin = 20;
+        nwin = nwin - nwin % ms->nsub;
+        if (nwin < (size_t)ms->nsub) nwin = ms->nsub;
+        if (nwin > n20) nwin = n20;
+    }
+
+    /* Allocate some workspace for the scalar records:  */
+    scal = (char *) malloc (nwin * ms->scalar_size);
+    if (scal == NULL) {
+        fprintf (stderr, "Failed to malloc data structure for %s\n", fname);
+        nc_close (ncfid);
+        ncf_free (vars, ms->nfields);
+        ncf_map_free (&map);
+        return (retval);
+    }
+
+    /* Where this file's records begin, to take them back if it fails */
+    fflush (stdout);
+    start = ftello (stdout);
+    if (start < 0 && nwin < n20 && (out = tmpfile ()) == NULL) {
+        fprintf (stderr, "Failed to open scratch output for %s\n", fname);
+        nc_close (ncfid);
+        ncf_free (vars, ms->nfields);
+        ncf_map_free (&map);
+        free ( (void *)scal);
+        return (retval);
+    }
+
+    for (k0 = 0; k0 < n20; k0 += n) {
+        n = (n20 - k0 < nwin) ? n20 - k0 : nwin;
+
+        /* Match records k0..k0+n-1 to their 1 Hz rows, once for all corrections */
+        if (ncf_map_window (ncfid, fname, &map, ms->time20, tvar, k0, n)) break;
+
+        /* Read each variable once for this window, then convert all fields in fused passes: */
+        if (ncf_load (ncfid, fname, vars, ms->nfields, k0, n, map.j0, map.j1 - map.j0 + 1)) break;
+        ncf_fill (vars, ms->nfields, &map, scal, ms->scalar_size, k0, n);
+        plane = ncf_plane (vars, ms->nfields);
+        if (ms->finish != NULL) ms->finish (scal, ms->scalar_size, k0, n);
+
+        /* Write out, as coded or thin records, or legacy interleaved records: */
+        if (zwave)
+            j = write_coded (out, scal, ms->scalar_size, plane, ngate, n,
+                (int)((ms->recsize - ms->scalar_size) / sizeof (unsigned short)));
+        else if (thin)
+            j = fwrite ((void *)scal, ms->scalar_size, n, out);
+        else
+            j = write_interleaved (out, scal, ms->scalar_size, plane, ngate, n, ms->recsize);
+        retval += j;
+        if (j != n) {
+            fprintf (stderr, "Failure writing output for file %s\n", fname);
+            break;
+        }
+    }
+    if (k0 < n20) {
+        /* failed: none of this file's records stay */
+        retval = 0;
+        if (out == stdout && start >= 0) {
+            fflush (stdout);
+            if (ftruncate (fileno (stdout), start) || fseeko (stdout, start, SEEK_SET))
+                fprintf (stderr, "Failed to take back the output of %s\n", fname);
+        }
+    }
+    else if (out != stdout && copy_out (out, fname)) retval = 0;
+    if (out != stdout) fclose (out);
+
+    /* -------------------------------------------------------------------- */
+    /* Done reading the NetCDF file. Close it: */
+    nc_close (ncfid);
+    ncf_free (vars, ms->nfields);
+    ncf_map_free (&map);
+    free ( (void *)scal);
+    return (retval);
+}
@@ -0,0 +1,166 @@
+/*  ncf_map.c
+
+ The 20 Hz -> 1 Hz correction mapping used by ncf_fill().  The 1 Hz times
+ are read once per file, then for each window of records one merge of the
+ window's 20 Hz times against them gives every record its 1 Hz row (and a
+ weight for linear interpolation).  All 1 Hz fields share that one index.
+
+ Unlike the legacy floor((k+1)/20.) rule this stays right when a file
+ starts part way through a 1 Hz interval and across gaps in either series.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "ncfield.h"
+
+int ncf_map_mode (char *name) {
+
+    /* NCF_MAP_* for "index", "nearest" or "linear"; -1 if unknown. */
+
+    if (!strcmp (name, "index")) return (NCF_MAP_INDEX);
+    if (!strcmp (name, "nearest")) return (NCF_MAP_NEAREST);
+    if (!strcmp (name, "linear")) return (NCF_MAP_LINEAR);
+    return (-1);
+}
+
+int ncf_map_open (int ncfid, char *fname, struct NCF_MAP *map, int mode, char *t01name, size_t n01, int nsub) {
+
+    /* Start a map for one file with n01 1 Hz rows and nsub 20 Hz records per
+       row of the 20 Hz time variable; reads the 1 Hz times unless mode is
+       NCF_MAP_INDEX.  Returns 0 on success. */
+
+    int     nc_err, ncvid;
+
+    memset ((void *)map, 0, sizeof (struct NCF_MAP));
+    map->mode = mode;
+    map->nsub = nsub;
+    map->n01 = n01;
+    if (mode == NCF_MAP_INDEX) return (0);
+
+    map->t01 = (double *) malloc (n01 * sizeof (double));
+    if (map->t01 == NULL) {
+        fprintf (stderr, "Failed to malloc workspace for %s\n", fname);
+        return (1);
+    }
+    nc_err = nc_inq_varid (ncfid, t01name, &ncvid);
+    if (nc_err == NC_NOERR) nc_err = nc_get_var_double (ncfid, ncvid, map->t01);
+    if (nc_err != NC_NOERR) {
+        fprintf (stderr, "Failed to load %s from %s\n", t01name, fname);
+        fprintf (stderr, "NetCDF Error Message %s\n", nc_strerror(nc_err));
+        return (1);
+    }
+    return (0);
+}
+
+static size_t find_row (double *t01, size_t n01, double t) {
+
+    /* Last row with t01 <= t, or 0 if t is before them all (binary search) */
+
+    size_t  lo = 0, hi = n01, mid;
+
+    while (hi - lo > 1) {
+        mid = lo + (hi - lo) / 2;
+        if (t01[mid] <= t) lo = mid; else hi = mid;
+    }
+    return (lo);
+}
+
+int ncf_map_window (int ncfid, char *fname, struct NCF_MAP *map, char *t20name, struct NCF_VAR *tv, size_t k0, size_t n) {
+
+    /* Map records k0..k0+n-1 (multiples of nsub) and set map->j0, map->j1
+       to the 1 Hz rows ncf_load() must read for them.  tv, if not NULL, is
+       the field table's entry for t20name: when it holds the times as
+       doubles they are read into its column, where ncf_load() finds them,
+       rather than twice.  Returns 0 on success. */
+
+    size_t  k, j = 0, start[2], count[2];
+    double  t, dt, *t01 = map->t01, *t20 = map->t20;
+    int     nc_err, ncvid;
+
+    if (n > map->cap) {
+        free ( (void *)map->t20);
+        free ( (void *)map->row);
+        free ( (void *)map->w);
+        map->t20 = (double *) malloc (n * sizeof (double));
+        map->row = (size_t *) malloc (n * sizeof (size_t));
+        map->w = (double *) malloc (n * sizeof (double));
+        map->cap = (map->t20 == NULL || map->row == NULL || map->w == NULL) ? 0 : n;
+        if (map->cap == 0) {
+            fprintf (stderr, "Failed to malloc workspace for %s\n", fname);
+            return (1);
+        }
+    }
+    map->k0 = k0;
+    map->n = n;
+
+    if (map->mode == NCF_MAP_INDEX) {
+        for (k = 0; k < n; k++) {
+            j = (map->nsub > 1) ? (k0+k) / map->nsub : (size_t)floor( (k0+k+1) / 20. );
+            map->row[k] = (j < map->n01) ? j : map->n01 - 1;
+            map->w[k] = 0.;
+        }
+    } else {
+        if (tv != NULL && tv->f->use && tv->alias < 0 && !tv->plane && tv->xtype == NC_DOUBLE
+            && tv->ncount == 1 && tv->nsub == map->nsub && !NCF_IS_01 (tv->f->rate)) {
+            if (ncf_load_var (ncfid, fname, tv, k0, n, 0, 0)) return (1);
+            t20 = (double *)tv->col;
+            tv->fresh = 1;
+        } else {
+            start[0] = k0 / map->nsub;
+            count[0] = n / map->nsub;
+            start[1] = 0;
+            count[1] = map->nsub;
+            nc_err = nc_inq_varid (ncfid, t20name, &ncvid);
+            if (nc_err == NC_NOERR) nc_err = nc_get_vara_double (ncfid, ncvid, start, count, t20);
+            if (nc_err != NC_NOERR) {
+                fprintf (stderr, "Failed to load %s from %s\n", t20name, fname);
+                fprintf (stderr, "NetCDF Error Message %s\n", nc_strerror(nc_err));
+                return (1);
+            }
+        }
+        /* One merge: j only moves forward while both series increase; a
+           record earlier than row j (time went backwards) is searched for. */
+        j = find_row (t01, map->n01, t20[0]);
+        for (k = 0; k < n; k++) {
+            t = t20[k];
+            if (isnan(t)) {     /* no time: keep the previous record's row */
+                map->row[k] = j;
+                map->w[k] = 0.;
+                continue;
+            }
+            if (t < t01[j]) j = find_row (t01, map->n01, t);
+            while (j + 1 < map->n01 && t01[j+1] <= t) j++;
+            map->row[k] = j;
+            map->w[k] = 0.;
+            if (j + 1 < map->n01 && t > t01[j]) {
+                dt = t01[j+1] - t01[j];
+                if (map->mode == NCF_MAP_NEAREST || dt > NCF_MAP_MAXGAP)
+                    map->w[k] = (t - t01[j] > t01[j+1] - t) ? 1. : 0.;   /* nearest; ties go to the earlier row */
+                else
+                    map->w[k] = (t - t01[j]) / dt;
+            }
+        }
+    }
+
+    /* Rows referenced: row, plus row+1 where it carries weight */
+    map->j0 = map->row[0];
+    map->j1 = map->row[0];
+    for (k = 0; k < n; k++) {
+        j = map->row[k] + (map->w[k] > 0. ? 1 : 0);
+        if (map->row[k] < map->j0) map->j0 = map->row[k];
+        if (j > map->j1) map->j1 = j;
+    }
+    return (0);
+}
+
+void ncf_map_free (struct NCF_MAP *map) {
+    free ( (void *)map->t01);
+    free ( (void *)map->t20);
+    free ( (void *)map->row);
+    free ( (void *)map->w);
+    memset ((void *)map, 0, sizeof (struct NCF_MAP));
+}
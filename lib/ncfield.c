@@ -0,0 +1,515 @@
+/*  ncfield.c
+
+ Engine behind the table-driven NetCDF readers.  See ncfield.h.
+
+ ncf_resolve() looks up every variable of a mission table once per file,
+ ncf_load() reads each distinct variable for a window of records with a
+ single nc_get_vara(), and ncf_fill() converts the raw columns into the
+ record array block by block, all fields per block, so each record is
+ pulled through cache once instead of once per variable.  The common 20 Hz
+ conversions of a block go through the vector kernels in cvt_kernels.c.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "ncfield.h"
+#include "cvt_kernels.h"
+
+#define SOL 299792458.0                 /* speed of light in vacuum */
+
+static size_t xtype_size (nc_type xtype) {
+    switch (xtype) {
+        case NC_BYTE: case NC_UBYTE: case NC_CHAR: return (1);
+        case NC_SHORT: case NC_USHORT: return (2);
+        case NC_INT: case NC_UINT: case NC_FLOAT: return (4);
+        case NC_INT64: case NC_UINT64: case NC_DOUBLE: return (8);
+    }
+    return (0);
+}
+
+struct NCF_VAR *ncf_resolve (int ncfid, char *fname, struct NC_FIELD *tab, int ntab, int nsub) {
+
+    /* Resolve varid, type and shape of every field in use.  20 Hz variables
+       are [record] or [record][value] when nsub is 1, and [row][nsub] or
+       [row][nsub][value] when each row holds nsub records (Jason, AltiKa).
+       1 Hz variables are [row] or [row][value].  Returns NULL on failure. */
+
+    struct NCF_VAR *v;
+    size_t  len;
+    double  sf, ao;
+    int     m, a, lead, nc_err, dimids[NC_MAX_VAR_DIMS];
+
+    v = (struct NCF_VAR *) calloc (ntab, sizeof (struct NCF_VAR));
+    if (v == NULL) {
+        fprintf (stderr, "Failed to malloc field table for %s\n", fname);
+        return (NULL);
+    }
+    for (m = 0; m < ntab; m++) {
+        v[m].f = &tab[m];
+        v[m].alias = -1;
+        if (!tab[m].use) continue;
+        for (a = 0; a < m; a++) {
+            if (tab[a].use && !strcmp (tab[a].name, tab[m].name)) break;
+        }
+        if (a < m) {
+            v[m] = v[a];
+            v[m].f = &tab[m];
+            v[m].alias = a;
+            continue;
+        }
+        nc_err = nc_inq_varid (ncfid, tab[m].name, &v[m].varid);
+        if (nc_err == NC_NOERR) nc_err = nc_inq_vartype (ncfid, v[m].varid, &v[m].xtype);
+        if (nc_err == NC_NOERR) nc_err = nc_inq_varndims (ncfid, v[m].varid, &v[m].ndims);
+        if (nc_err == NC_NOERR) nc_err = nc_inq_vardimid (ncfid, v[m].varid, dimids);
+        if (nc_err != NC_NOERR) {
+            fprintf (stderr, "Failed to get %s ID in %s\n", tab[m].name, fname);
+            fprintf (stderr, "NetCDF Error Message %s\n", nc_strerror(nc_err));
+            free ( (void *)v);
+            return (NULL);
+        }
+        v[m].xsize = xtype_size (v[m].xtype);
+        v[m].nsub = (NCF_IS_01 (tab[m].rate)) ? 1 : nsub;
+        lead = (v[m].nsub > 1) ? 2 : 1;
+        len = 1;
+        if (lead == 2 && v[m].ndims >= 2) nc_err = nc_inq_dimlen (ncfid, dimids[1], &len);
+        v[m].ncount = 1;
+        if (nc_err == NC_NOERR && v[m].ndims == lead + 1) nc_err = nc_inq_dimlen (ncfid, dimids[lead], &v[m].ncount);
+        if (nc_err != NC_NOERR || v[m].xsize == 0 || v[m].ndims < lead || v[m].ndims > lead + 1
+            || len != (size_t)v[m].nsub || v[m].ncount > (size_t)tab[m].count) {
+            fprintf (stderr, "Unexpected type or shape of %s in %s\n", tab[m].name, fname);
+            free ( (void *)v);
+            return (NULL);
+        }
+        /* values equal to _FillValue become the field's NaN sentinel, and are
+           never blended into their neighbours by a linear 1 Hz expansion */
+        if (nc_get_att_double (ncfid, v[m].varid, "_FillValue", &v[m].fill) == NC_NOERR)
+            v[m].any_fill = 1;
+        v[m].has_fill = (v[m].any_fill && tab[m].nan != 0);
+        /* repacking factors from the file's own scale_factor and add_offset */
+        if (tab[m].conv == NCF_PACK) {
+            if (nc_get_att_double (ncfid, v[m].varid, "scale_factor", &sf) != NC_NOERR) sf = 1.;
+            if (nc_get_att_double (ncfid, v[m].varid, "add_offset", &ao) != NC_NOERR) ao = 0.;
+            v[m].pa = sf / tab[m].scale;
+            v[m].pb = (ao - tab[m].base) / tab[m].scale;
+        }
+    }
+    return (v);
+}
+
+int ncf_load (int ncfid, char *fname, struct NCF_VAR *v, int ntab, size_t k0, size_t n20, size_t j0, size_t n01) {
+
+    /* Read records k0..k0+n20-1 of every 20 Hz variable and rows
+       j0..j0+n01-1 of every 1 Hz variable.  With nsub records per row, k0
+       and n20 must be multiples of nsub.  A column ncf_map_window() has
+       already read for the window is not read again.  Returns 0 on success. */
+
+    int     m;
+
+    for (m = 0; m < ntab; m++) {
+        if (!v[m].f->use || v[m].alias >= 0) continue;
+        if (v[m].fresh) {
+            v[m].fresh = 0;
+            continue;
+        }
+        if (ncf_load_var (ncfid, fname, &v[m], k0, n20, j0, n01)) return (1);
+    }
+    /* aliases share the column read for their first occurrence */
+    for (m = 0; m < ntab; m++) {
+        if (!v[m].f->use || v[m].alias < 0) continue;
+        v[m].col = v[v[m].alias].col;
+        v[m].row0 = v[v[m].alias].row0;
+        v[m].nrow = v[v[m].alias].nrow;
+    }
+    return (0);
+}
+
+int ncf_load_var (int ncfid, char *fname, struct NCF_VAR *v, size_t k0, size_t n20, size_t j0, size_t n01) {
+
+    /* ncf_load() for one variable.  Returns 0 on success. */
+
+    size_t  start[3], count[3], need;
+    int     d, nc_err;
+
+    d = 0;
+    if (NCF_IS_01 (v->f->rate)) {
+        start[d] = j0;
+        count[d++] = n01;
+    } else {
+        start[d] = k0 / v->nsub;
+        count[d++] = n20 / v->nsub;
+        if (v->nsub > 1) {
+            start[d] = 0;
+            count[d++] = v->nsub;
+        }
+    }
+    start[d] = 0;
+    count[d] = v->ncount;
+    need = n20 * v->ncount * v->xsize;
+    if (NCF_IS_01 (v->f->rate)) need = n01 * v->ncount * v->xsize;
+    if (need > v->cap) {
+        free ( (void *)v->col);
+        v->col = (char *) malloc (need);
+        v->cap = (v->col == NULL) ? 0 : need;
+        if (v->col == NULL) {
+            fprintf (stderr, "Failed to malloc workspace for %s\n", fname);
+            return (1);
+        }
+    }
+    if (v->plane)   /* straight into the plane, converted by netcdf if need be */
+        nc_err = nc_get_vara_ushort (ncfid, v->varid, start, count, (unsigned short *)v->col);
+    else
+        nc_err = nc_get_vara (ncfid, v->varid, start, count, v->col);
+    if (nc_err != NC_NOERR) {
+        fprintf (stderr, "Failed to load %s from %s\n", v->f->name, fname);
+        fprintf (stderr, "NetCDF Error Message %s\n", nc_strerror(nc_err));
+        return (1);
+    }
+    v->row0 = NCF_IS_01 (v->f->rate) ? j0 : k0;
+    v->nrow = NCF_IS_01 (v->f->rate) ? n01 : n20;
+    return (0);
+}
+
+static long long get_int (struct NCF_VAR *v, size_t i) {
+    switch (v->xtype) {
+        case NC_BYTE:   return ((signed char *)v->col)[i];
+        case NC_CHAR:   return ((char *)v->col)[i];
+        case NC_UBYTE:  return ((unsigned char *)v->col)[i];
+        case NC_SHORT:  return ((short int *)v->col)[i];
+        case NC_USHORT: return ((unsigned short int *)v->col)[i];
+        case NC_INT:    return ((int *)v->col)[i];
+        case NC_UINT:   return ((unsigned int *)v->col)[i];
+        case NC_INT64:  return ((long long *)v->col)[i];
+        case NC_UINT64: return (long long)((unsigned long long *)v->col)[i];
+        case NC_FLOAT:  return (long long)((float *)v->col)[i];
+        case NC_DOUBLE: return (long long)((double *)v->col)[i];
+    }
+    return (0);
+}
+
+static double get_double (struct NCF_VAR *v, size_t i) {
+    switch (v->xtype) {
+        case NC_FLOAT:  return ((float *)v->col)[i];
+        case NC_DOUBLE: return ((double *)v->col)[i];
+    }
+    return ((double)get_int (v, i));
+}
+
+static void put (char *p, int type, long long x) {
+    switch (type) {
+        case NCF_U4: *(unsigned int *)p = (unsigned int)x; break;
+        case NCF_I4: *(int *)p = (int)x; break;
+        case NCF_U2: *(unsigned short int *)p = (unsigned short int)x; break;
+        case NCF_I2: *(short int *)p = (short int)x; break;
+    }
+}
+
+static size_t type_size (int type) {
+    return ((type == NCF_U4 || type == NCF_I4) ? 4 : 2);
+}
+
+static int fill_kernel (struct NCF_VAR *v, char *rec, size_t recsize, size_t k, size_t nb) {
+
+    /* Convert one field for records k..k+nb-1 with a vector kernel.
+       Returns 0, having done nothing, if the field needs the general path. */
+
+    struct NC_FIELD *f = v->f;
+    unsigned int  a[NCF_BLOCK], b[NCF_BLOCK];
+    size_t  r, i = (k - v->row0) * v->ncount;
+    int     four = (f->type == NCF_U4 || f->type == NCF_I4);
+
+    if (f->rate != NCF_20HZ) return (0);
+    switch (f->conv) {
+        case NCF_ROUND:
+        case NCF_LON:
+            if (v->xtype != NC_INT || v->ncount != 1 || !four) return (0);
+            cvt_round ((int *)v->col + i, (int *)a, nb, f->scale, f->conv == NCF_LON);
+            break;
+        case NCF_PACK:
+            if (v->xtype != NC_INT || v->ncount != 1 || !four) return (0);
+            if (v->pa == 1. && v->pb == 0.) {   /* file already on the target grid */
+                for (r = 0; r < nb; r++) *(int *)(rec + r * recsize + f->offset) = ((int *)v->col)[i + r];
+                return (1);
+            }
+            cvt_pack ((int *)v->col + i, (int *)a, nb, v->pa, v->pb);
+            break;
+        case NCF_TIME:
+            if (v->xtype != NC_DOUBLE || !four) return (0);
+            cvt_time ((double *)v->col + i, a, b, nb, (unsigned int)f->nan);
+            for (r = 0; r < nb; r++) *(unsigned int *)(rec + r * recsize + f->offset2) = b[r];
+            break;
+        case NCF_DELAY:
+            if (v->xtype != NC_INT64 || !four) return (0);
+            cvt_delay ((long long *)v->col + i, a, nb);
+            break;
+        case NCF_WAVE:
+            if (v->xtype != NC_USHORT || f->type != NCF_U2) return (0);
+            cvt_wave_sum ((unsigned short *)v->col + i, v->ncount, a, nb);
+            if (!v->plane) {
+                for (r = 0; r < nb; r++)
+                    memcpy (rec + r * recsize + f->offset, (unsigned short *)v->col + i + r * v->ncount,
+                            v->ncount * sizeof (unsigned short));
+            }
+            for (r = 0; r < nb; r++) *(unsigned int *)(rec + r * recsize + f->offset2) = a[r];
+            return (1);
+        default:
+            return (0);
+    }
+    for (r = 0; r < nb; r++) *(unsigned int *)(rec + r * recsize + f->offset) = a[r];
+    return (1);
+}
+
+static void fill_block (struct NCF_VAR *v, char *rec, size_t recsize, size_t k, size_t nb) {
+
+    /* Convert one field for records k..k+nb-1 into rec[0..nb-1]. */
+
+    struct NC_FIELD *f = v->f;
+    size_t  r, e, i, tsize = type_size (f->type);
+    unsigned int  sum, sec;
+    long long  x;
+    double  t;
+    int     ix;
+    char    *p;
+
+    if (fill_kernel (v, rec, recsize, k, nb)) return;
+    for (r = 0; r < nb; r++, k++) {
+        i = (k - v->row0) * v->ncount;
+        p = rec + r * recsize + f->offset;
+        switch (f->conv) {
+            case NCF_COPY:
+                for (e = 0; e < v->ncount; e++) put (p + e * tsize, f->type, get_int (v, i + e));
+                break;
+            case NCF_ROUND:
+            case NCF_LON:
+                for (e = 0; e < v->ncount; e++) {
+                    ix = (int)floor(get_double (v, i + e)/f->scale + .5);
+                    if (f->conv == NCF_LON && ix < 0) ix = ix + 360000000;
+                    put (p + e * tsize, f->type, ix);
+                }
+                break;
+            case NCF_TIME:
+                t = get_double (v, i);
+                if (isnan(t)) {
+                    put (p, f->type, f->nan);
+                    put (rec + r * recsize + f->offset2, f->type, f->nan);
+                } else {
+                    sec = floor(t); /* double to unsigned int */
+                    put (p, f->type, sec);
+                    put (rec + r * recsize + f->offset2, f->type, (unsigned int)floor(1000000.0 * (t - sec)));
+                }
+                break;
+            case NCF_PACK:
+                for (e = 0; e < v->ncount; e++)
+                    put (p + e * tsize, f->type, (int)floor(get_double (v, i + e)*v->pa + v->pb + .5));
+                break;
+            case NCF_FLAG:
+                if (get_int (v, i) == 0) break;
+                if (tsize == 4) *(unsigned int *)p |= f->bit;
+                else *(unsigned short int *)p |= f->bit;
+                break;
+            case NCF_DELAY:
+                x = get_int (v, i);
+                put (p, f->type, (unsigned int) floor(0.5 + x*1.e-9*SOL/2.));
+                break;
+            case NCF_WAVE:
+                sum = 0;
+                if (v->plane) {
+                    for (e = 0; e < v->ncount; e++) sum = sum + ((unsigned short int *)v->col)[i + e];
+                } else {
+                    for (e = 0; e < v->ncount; e++) {
+                        put (p + e * tsize, f->type, get_int (v, i + e));
+                        sum = sum + ((unsigned short int *)p)[e];
+                    }
+                }
+                *(unsigned int *)(rec + r * recsize + f->offset2) = sum;
+                break;
+        }
+    }
+}
+
+static void fill_01 (struct NCF_VAR *v, struct NCF_MAP *map, char *rec, size_t recsize, size_t k, size_t nb) {
+
+    /* Expand one 1 Hz field to records k..k+nb-1 through the shared map.
+       Linear weights apply to NCF_01HZ values converted by NCF_COPY,
+       NCF_ROUND or NCF_PACK; everything else takes the row the map points at. */
+
+    struct NC_FIELD *f = v->f;
+    size_t  r, e, m, i, j, last = v->row0 + v->nrow - 1, tsize = type_size (f->type);
+    double  w, a, b;
+    int     lin = (map->mode == NCF_MAP_LINEAR && f->rate == NCF_01HZ
+                   && (f->conv == NCF_COPY || f->conv == NCF_ROUND || f->conv == NCF_PACK));
+    int     fa, fb;
+    char    *p;
+
+    for (r = 0, m = k - map->k0; r < nb; r++, m++) {
+        w = map->w[m];
+        i = map->row[m];
+        if (!lin && w > 0.5) i++;   /* nearest of the bracketing rows */
+        if (i > last) i = last;
+        i = (i - v->row0) * v->ncount;
+        p = rec + r * recsize + f->offset;
+        for (e = 0; e < v->ncount; e++) {
+            /* a _FillValue row is never blended in, whatever f->nan says */
+            fa = (v->any_fill && get_double (v, i + e) == v->fill);
+            fb = (v->any_fill && lin && w > 0. && get_double (v, i + v->ncount + e) == v->fill);
+            if (v->has_fill && (fa || fb)) {
+                put (p + e * tsize, f->type, f->nan);
+            }
+            else if (lin && w > 0. && (fa || fb)) {
+                /* no sentinel: take the bracketing row that has a value */
+                j = (fa && !fb) ? i + v->ncount + e : i + e;
+                if (f->conv == NCF_PACK)
+                    put (p + e * tsize, f->type, (int)floor(get_double (v, j)*v->pa + v->pb + .5));
+                else if (f->conv == NCF_ROUND)
+                    put (p + e * tsize, f->type, (int)floor(get_double (v, j)/f->scale + .5));
+                else
+                    put (p + e * tsize, f->type, get_int (v, j));
+            }
+            else if (lin && w > 0.) {
+                a = get_double (v, i + e);
+                b = get_double (v, i + v->ncount + e);
+                a = a + w * (b - a);
+                if (f->conv == NCF_PACK)
+                    put (p + e * tsize, f->type, (long long)floor(a*v->pa + v->pb + .5));
+                else
+                    put (p + e * tsize, f->type, (long long)floor(a/f->scale + .5));
+            }
+            else if (f->conv == NCF_PACK)
+                put (p + e * tsize, f->type, (int)floor(get_double (v, i + e)*v->pa + v->pb + .5));
+            else if (f->conv == NCF_ROUND)
+                put (p + e * tsize, f->type, (int)floor(get_double (v, i + e)/f->scale + .5));
+            else
+                put (p + e * tsize, f->type, get_int (v, i + e));
+        }
+    }
+}
+
+static void apply_fill (struct NCF_VAR *v, char *rec, size_t recsize, size_t k, size_t nb) {
+
+    /* Replace members converted from _FillValue source values by the NaN sentinel. */
+
+    struct NC_FIELD *f = v->f;
+    size_t  r, e, i, tsize = type_size (f->type);
+
+    for (r = 0; r < nb; r++, k++) {
+        i = (k - v->row0) * v->ncount;
+        for (e = 0; e < v->ncount; e++) {
+            if (get_double (v, i + e) != v->fill) continue;
+            put (rec + r * recsize + f->offset + e * tsize, f->type, f->nan);
+            if (f->conv == NCF_TIME) put (rec + r * recsize + f->offset2, f->type, f->nan);
+        }
+    }
+}
+
+void ncf_fill (struct NCF_VAR *v, int ntab, struct NCF_MAP *map, void *rec, size_t recsize, size_t k0, size_t n20) {
+
+    /* Fill records k0..k0+n20-1 into rec[0..n20-1], expanding 1 Hz fields
+       through map (built by ncf_map_window for this window).  Members not
+       covered by a field in use are set to zero. */
+
+    size_t  b, nb;
+    int     m;
+    char    *out = (char *)rec;
+
+    for (b = 0; b < n20; b += NCF_BLOCK) {
+        nb = (n20 - b < NCF_BLOCK) ? n20 - b : NCF_BLOCK;
+        memset (out + b * recsize, 0, nb * recsize);
+        for (m = 0; m < ntab; m++) {
+            if (!v[m].f->use) continue;
+            if (NCF_IS_01 (v[m].f->rate))
+                fill_01 (&v[m], map, out + b * recsize, recsize, k0 + b, nb);
+            else {
+                fill_block (&v[m], out + b * recsize, recsize, k0 + b, nb);
+                if (v[m].has_fill) apply_fill (&v[m], out + b * recsize, recsize, k0 + b, nb);
+            }
+        }
+    }
+}
+
+int ncf_use_plane (struct NCF_VAR *v, int ntab) {
+
+    /* Load the waveform field (NCF_WAVE, unsigned short target) as a
+       contiguous plane instead of into the records.  Call after ncf_resolve().
+       Returns gates per waveform in the plane, 0 if no waveform is in use. */
+
+    int     m;
+
+    for (m = 0; m < ntab; m++) {
+        if (v[m].f->use && v[m].alias < 0 && v[m].f->conv == NCF_WAVE && v[m].f->type == NCF_U2) {
+            v[m].plane = 1;
+            v[m].xtype = NC_USHORT;
+            v[m].xsize = sizeof (unsigned short);
+            return ((int)v[m].ncount);
+        }
+    }
+    return (0);
+}
+
+unsigned short *ncf_plane (struct NCF_VAR *v, int ntab) {
+
+    /* The plane loaded by the last ncf_load(), rows in record order. */
+
+    int     m;
+
+    for (m = 0; m < ntab; m++) {
+        if (v[m].plane) return ((unsigned short *)v[m].col);
+    }
+    return (NULL);
+}
+
+size_t ncf_recbytes (struct NCF_VAR *v, int ntab) {
+
+    /* Column bytes needed per 20 Hz record, for sizing streaming windows.
+       1 Hz variables are counted at one row per record, which over-covers
+       the window's 1 Hz rows plus the row straddling its edge. */
+
+    size_t  nbytes = 0;
+    int     m;
+
+    for (m = 0; m < ntab; m++) {
+        if (v[m].f->use && v[m].alias < 0) nbytes += v[m].xsize * v[m].ncount;
+    }
+    return (nbytes);
+}
+
+void ncf_free (struct NCF_VAR *v, int ntab) {
+    int m;
+    if (v == NULL) return;
+    for (m = 0; m < ntab; m++) {
+        if (v[m].f->use && v[m].alias < 0) free ( (void *)v[m].col);
+    }
+    free ( (void *)v);
+}
+
+int ncf_select (struct NC_FIELD *tab, int ntab, char *list) {
+
+    /* Use only the fields named in a comma-separated list of NetCDF variable
+       names.  Returns the number of fields selected, or -1 for an unknown name. */
+
+    char    *copy, *name;
+    int     m, found, nsel = 0;
+
+    if ((copy = (char *) malloc (strlen (list) + 1)) == NULL) return (-1);
+    strcpy (copy, list);
+    for (m = 0; m < ntab; m++) tab[m].use = 0;
+    for (name = strtok (copy, ","); name != NULL; name = strtok (NULL, ",")) {
+        found = 0;
+        for (m = 0; m < ntab; m++) {
+            if (!strcmp (tab[m].name, name)) {
+                if (!tab[m].use) nsel++;
+                tab[m].use = 1;
+                found = 1;
+            }
+        }
+        if (!found) {
+            fprintf (stderr, "Unknown field %s\n", name);
+            free ( (void *)copy);
+            return (-1);
+        }
+    }
+    free ( (void *)copy);
+    return (nsel);
+}
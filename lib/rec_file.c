@@ -0,0 +1,337 @@
+/*  rec_file.c
+
+ Writer and mmap reader for the record container in rec_file.h.
+
+ The writer puts a provisional header at the top of a seekable output,
+ lets the records be written after it in the usual way (serially or by
+ run_parallel), and rec_finish() then fills in the record count and time
+ range, rewrites the header and writes the block index sidecar in the same
+ pass over the records.
+
+ rec_get() and rec_put() move whole structs in and out of a container of
+ any kind, coding and decoding the waveforms of a REC_ZWAVE container and
+ dropping or zero-filling those of a REC_THIN one on the way, so that
+ tools need not care which kind they were given.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "rec_file.h"
+#include "rec_index.h"
+#include "wave_codec.h"
+
+#define MAXGATE 256     /* longest wave[] a compressed container may have */
+
+static unsigned int fnv (unsigned int h, unsigned int x) {
+    int b;
+    for (b = 0; b < 4; b++, x >>= 8) h = (h ^ (x & 0xff)) * 16777619u;
+    return (h);
+}
+
+unsigned int rec_layout (struct NC_FIELD *tab, int ntab, size_t recsize) {
+
+    /* 32-bit FNV-1a hash of where and how every field of the table lands
+       in the record.  NetCDF names and scales do not enter, so a product
+       rename does not change it, but moving or retyping a member does. */
+
+    unsigned int h = 2166136261u;
+    int m;
+
+    h = fnv (h, (unsigned int)recsize);
+    for (m = 0; m < ntab; m++) {
+        h = fnv (h, (unsigned int)tab[m].offset);
+        h = fnv (h, (unsigned int)tab[m].offset2);
+        h = fnv (h, (unsigned int)tab[m].type);
+        h = fnv (h, (unsigned int)tab[m].count);
+    }
+    return (h);
+}
+
+int rec_write_head (FILE *fp, struct REC_HEAD *head) {
+
+    /* Write a header for an empty container, padded to REC_BODY, taking
+       mission, recsize, layout, keys, wave, ngate and flags from head (the
+       header of an input container, or one filled in by a reader).
+       Returns 0 on success. */
+
+    struct REC_HEAD h;
+    char    pad[REC_BODY];
+
+    if ((head->flags & REC_STORE) && ((head->flags & REC_STORE) == REC_STORE || head->ngate == 0 || head->ngate > MAXGATE
+        || head->wave + 2 * (size_t)head->ngate > head->recsize)) {
+        fprintf (stderr, "Failed: cannot compress or thin records without a waveform\n");
+        return (1);
+    }
+    memset (pad, 0, REC_BODY);
+    memset (&h, 0, sizeof (h));
+    memcpy (h.magic, REC_MAGIC, 8);
+    h.endian = REC_ENDIAN;
+    h.version = REC_VERSION;
+    h.mission = head->mission;
+    h.recsize = head->recsize;
+    h.layout = head->layout;
+    h.body = REC_BODY;
+    h.keys = head->keys;
+    h.wave = head->wave;
+    h.ngate = head->ngate;
+    h.flags = head->flags;
+    memcpy (pad, &h, sizeof (h));
+    if (fwrite (pad, 1, REC_BODY, fp) != REC_BODY) {
+        fprintf (stderr, "Failed to write record file header\n");
+        return (1);
+    }
+    return (0);
+}
+
+int rec_finish (FILE *fp, char *idxname) {
+
+    /* Complete the header of a container written to fp: count the records
+       and find their time range (records with time 0 or nan are skipped),
+       and write the block index to idxname unless it is NULL.  fp must be seekable and opened for update.
+       Returns 0 on success. */
+
+    struct REC_HEAD h;
+    struct REC_IXW ix;
+    struct REC_KEYS *keys;
+    char    *buf;
+    unsigned int sec, usec;
+    long    end;
+    size_t  n;
+    double  t;
+
+    fflush (fp);
+    if (fseek (fp, 0L, SEEK_END) || (end = ftell (fp)) < REC_BODY || fseek (fp, 0L, SEEK_SET)
+        || fread (&h, sizeof (h), 1, fp) != 1) {
+        fprintf (stderr, "Failed to finish record file: output is not a seekable file\n");
+        return (1);
+    }
+    h.nrec = 0;     /* counted below; compressed records have no fixed size */
+    h.tmin = h.tmax = 0.;
+    keys = &h.keys;
+    if (idxname != NULL && rec_index_open (&ix, idxname, &h)) return (1);
+    if ((buf = (char *) malloc (h.recsize)) == NULL) {
+        fprintf (stderr, "Failed to malloc record buffer\n");
+        return (1);
+    }
+    fseek (fp, (long)REC_BODY, SEEK_SET);
+    for (n = 0; rec_get (fp, &h, buf, 1) == 1; h.nrec++) {
+        if (idxname != NULL) rec_index_add (&ix, buf);
+        memcpy (&sec, buf + keys->sec, sizeof (sec));
+        memcpy (&usec, buf + keys->usec, sizeof (usec));
+        if (sec == 0 || sec == keys->nan) continue;
+        t = sec + 1.e-6 * usec;
+        if (n == 0 || t < h.tmin) h.tmin = t;
+        if (n == 0 || t > h.tmax) h.tmax = t;
+        n++;
+    }
+    free ( (void *)buf);
+    if (idxname != NULL && rec_index_close (&ix)) return (1);
+    if (fseek (fp, 0L, SEEK_SET) || fwrite (&h, sizeof (h), 1, fp) != 1 || fflush (fp)) {
+        fprintf (stderr, "Failed to rewrite record file header\n");
+        return (1);
+    }
+    return (0);
+}
+
+static int check_head (struct REC_HEAD *h, char *fname, unsigned int mission, size_t recsize, unsigned int layout) {
+
+    /* 0 if h is a container header of the given mission, size and layout
+       (REC_ANY, 0 and 0 skip those checks) */
+
+    if (memcmp (h->magic, REC_MAGIC, 8)) {
+        fprintf (stderr, "Failed: %s is not a record file\n", fname);
+        return (1);
+    }
+    if (h->endian != REC_ENDIAN || h->version < 2 || h->version > REC_VERSION) {
+        fprintf (stderr, "Failed: %s has the wrong byte order or version %u\n", fname, h->version);
+        return (1);
+    }
+    if ((mission != REC_ANY && h->mission != mission) || (recsize != 0 && h->recsize != recsize)
+        || (layout != 0 && h->layout != layout)) {
+        fprintf (stderr, "Failed: %s holds mission %u records of %u bytes, layout %08x; expected mission %u, %u bytes, layout %08x\n",
+            fname, h->mission, h->recsize, h->layout, mission, (unsigned int)recsize, layout);
+        return (1);
+    }
+    if (h->version < 3) h->wave = h->ngate = h->flags = 0;
+    if (h->recsize == 0 || h->nrec < 0 || h->body < sizeof (*h) || (h->flags & ~(REC_STORE | REC_FIT1 | REC_FIT2))
+        || (h->flags & REC_STORE) == REC_STORE || ((h->flags & REC_STORE) && (h->wave == 0 || h->ngate > MAXGATE
+        || h->wave + 2 * (size_t)h->ngate > h->recsize))) {
+        fprintf (stderr, "Failed: %s has a damaged header\n", fname);
+        return (1);
+    }
+    return (0);
+}
+
+int rec_open (struct REC_FILE *rf, char *fname, unsigned int mission, size_t recsize, unsigned int layout) {
+
+    /* Open and map a container, checking that it holds records of the given
+       mission, size and layout (REC_ANY, 0 and 0 skip the checks).
+       Returns 0 on success. */
+
+    struct stat st;
+    ssize_t nr;
+
+    memset (rf, 0, sizeof (*rf));
+    rf->fd = open (fname, O_RDONLY);
+    if (rf->fd < 0) {
+        fprintf (stderr, "Failed to open %s\n", fname);
+        return (1);
+    }
+    nr = read (rf->fd, &rf->h, sizeof (rf->h));
+    if (nr != (ssize_t)sizeof (rf->h)) memset (&rf->h, 0, sizeof (rf->h));
+    if (check_head (&rf->h, fname, mission, recsize, layout)) {
+        close (rf->fd);
+        return (1);
+    }
+    if (rf->h.flags & REC_ZWAVE) {
+        fprintf (stderr, "Failed: %s has compressed waveforms and cannot be mapped; read it with rec_get()\n", fname);
+        close (rf->fd);
+        return (1);
+    }
+    rf->stride = (rf->h.flags & REC_THIN) ? rf->h.wave : rf->h.recsize;
+    if (fstat (rf->fd, &st) || (off_t)rf->h.body + (off_t)rf->h.nrec * (off_t)rf->stride > st.st_size) {
+        fprintf (stderr, "Failed: %s is truncated\n", fname);
+        close (rf->fd);
+        return (1);
+    }
+    rf->maplen = (size_t)rf->h.body + (size_t)rf->h.nrec * rf->stride;
+    rf->map = mmap (NULL, rf->maplen, PROT_READ, MAP_SHARED, rf->fd, 0);
+    if (rf->map == MAP_FAILED) {
+        fprintf (stderr, "Failed to mmap %s\n", fname);
+        close (rf->fd);
+        rf->map = NULL;
+        return (1);
+    }
+    rf->rec = (char *)rf->map + rf->h.body;
+    return (0);
+}
+
+FILE *rec_stream (char *fname, struct REC_HEAD *h, unsigned int mission, size_t recsize, unsigned int layout) {
+
+    /* Open a container for reading its records in order with rec_get(), "-"
+       for stdin, so a pipe works too.  Checks the header as rec_open() does
+       and returns the stream positioned at the first record, or NULL. */
+
+    FILE    *fp;
+    size_t  skip;
+    int     c;
+
+    fp = (strcmp (fname, "-")) ? fopen (fname, "rb") : stdin;
+    if (fp == NULL) {
+        fprintf (stderr, "Failed to open %s\n", fname);
+        return (NULL);
+    }
+    if (fread (h, sizeof (*h), 1, fp) != 1) memset (h, 0, sizeof (*h));
+    if (check_head (h, fname, mission, recsize, layout)) {
+        if (fp != stdin) fclose (fp);
+        return (NULL);
+    }
+    for (skip = h->body - sizeof (*h); skip > 0 && (c = getc (fp)) != EOF; skip--);
+    if (skip > 0) {
+        fprintf (stderr, "Failed: %s is truncated\n", fname);
+        if (fp != stdin) fclose (fp);
+        return (NULL);
+    }
+    return (fp);
+}
+
+void rec_close (struct REC_FILE *rf) {
+    if (rf->map == NULL) return;
+    munmap (rf->map, rf->maplen);
+    close (rf->fd);
+    rf->map = NULL;
+    rf->rec = NULL;
+}
+
+size_t rec_get (FILE *fp, struct REC_HEAD *h, char *rec, size_t n) {
+
+    /* Read up to n records of the container with header h into rec, as
+       whole structs of h->recsize bytes.  Returns the number read; a short
+       count means end of file or a damaged record. */
+
+    unsigned char code[WAVE_MAXCODE (MAXGATE)];
+    size_t  k, ncls, len, tail;
+
+    if (h->flags & REC_THIN) {
+        /* read them packed, then spread them out from the last one down */
+        n = fread (rec, h->wave, n, fp);
+        for (k = n; k-- > 0; ) {
+            memmove (rec + k * h->recsize, rec + k * h->wave, h->wave);
+            memset (rec + k * h->recsize + h->wave, 0, h->recsize - h->wave);
+        }
+        return (n);
+    }
+    if (!(h->flags & REC_ZWAVE)) return (fread (rec, h->recsize, n, fp));
+    ncls = WAVE_NCLASS (h->ngate);
+    tail = h->recsize - h->wave - 2 * (size_t)h->ngate;     /* padding after wave[] */
+    for (k = 0; k < n; k++, rec += h->recsize) {
+        if (fread (rec, h->wave, 1, fp) != 1 || fread (code, ncls, 1, fp) != 1) break;
+        len = wave_code_len (code, h->ngate);
+        if (fread (code + ncls, len - ncls, 1, fp) != 1 && len > ncls) break;
+        wave_decode (code, h->ngate, (unsigned short *)(rec + h->wave));
+        memset (rec + h->recsize - tail, 0, tail);
+    }
+    return (k);
+}
+
+size_t rec_put (FILE *fp, struct REC_HEAD *h, char *rec, size_t n) {
+
+    /* Write n whole structs to a container with header h, coding their
+       waveforms if it is compressed and dropping them if it is thin.
+       Returns the number written. */
+
+    unsigned char code[WAVE_MAXCODE (MAXGATE)];
+    size_t  k, len;
+
+    if (h->flags & REC_THIN) {
+        for (k = 0; k < n && fwrite (rec + k * h->recsize, h->wave, 1, fp) == 1; k++);
+        return (k);
+    }
+    if (!(h->flags & REC_ZWAVE)) return (fwrite (rec, h->recsize, n, fp));
+    for (k = 0; k < n; k++, rec += h->recsize) {
+        len = wave_encode ((unsigned short *)(rec + h->wave), h->ngate, code);
+        if (fwrite (rec, h->wave, 1, fp) != 1 || fwrite (code, len, 1, fp) != 1) break;
+    }
+    return (k);
+}
+
+int rec_cut (struct REC_CUT *c, struct REC_HEAD *h, char *rec, double gap) {
+
+    /* Pass splitting.  Feed the records of a file in order, starting from
+       a zeroed c.  Returns 1 if rec starts a new pass (the latitude turns,
+       or time jumps by more than gap or goes backwards), 0 if it continues
+       the current one, and -1 if it has no time or position (it belongs to
+       the current pass but says nothing).  c->t, c->lat and c->asc then
+       hold the record's time, latitude and the direction of its pass. */
+
+    unsigned int sec, usec;
+    int     lat, dir, cut;
+    double  t;
+
+    memcpy (&sec, rec + h->keys.sec, sizeof (sec));
+    memcpy (&usec, rec + h->keys.usec, sizeof (usec));
+    memcpy (&lat, rec + h->keys.lat, sizeof (lat));
+    if (sec == 0 || sec == h->keys.nan || lat == (int)h->keys.nan) return (-1);
+    t = sec + 1.e-6 * usec;
+    /* direction from the latitude step; a flat step says nothing */
+    dir = (c->nvalid == 0 || lat == c->lat) ? -1 : (lat > c->lat);
+    cut = (c->nvalid > 0 && (t - c->t > gap || t < c->t || (dir >= 0 && c->asc >= 0 && dir != c->asc)));
+    if (cut) {
+        c->nvalid = 0;
+        dir = -1;
+    }
+    if (c->nvalid == 0) c->asc = -1;
+    if (c->asc < 0) c->asc = dir;
+    c->t = t;
+    c->lat = lat;
+    c->nvalid++;
+    return (cut);
+}
@@ -0,0 +1,196 @@
+/*  rec_index.c
+
+ Writer, reader and matching for the block index in rec_index.h.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "rec_index.h"
+
+static void block_reset (struct REC_IXW *ix) {
+    memset (&ix->b, 0, sizeof (ix->b));
+    ix->nb = 0;
+}
+
+int rec_index_open (struct REC_IXW *ix, char *idxname, struct REC_HEAD *head) {
+
+    /* Start an index for the container whose header is head.  Returns 0 on success. */
+
+    memset (ix, 0, sizeof (*ix));
+    if ((ix->fp = fopen (idxname, "wb")) == NULL) {
+        fprintf (stderr, "Failed to open %s\n", idxname);
+        return (1);
+    }
+    memcpy (ix->h.magic, REC_IXMAGIC, 8);
+    ix->h.endian = REC_ENDIAN;
+    ix->h.version = REC_VERSION;
+    ix->h.mission = head->mission;
+    ix->h.layout = head->layout;
+    ix->h.recsize = head->recsize;
+    ix->h.block = REC_IXBLOCK;
+    ix->h.keys = head->keys;
+    if (fwrite (&ix->h, sizeof (ix->h), 1, ix->fp) != 1) {
+        fprintf (stderr, "Failed to write %s\n", idxname);
+        fclose (ix->fp);
+        return (1);
+    }
+    block_reset (ix);
+    return (0);
+}
+
+static void block_flush (struct REC_IXW *ix) {
+    if (ix->nb == 0) return;
+    if (fwrite (&ix->b, sizeof (ix->b), 1, ix->fp) != 1) ix->err = 1;
+    ix->h.nblock++;
+    ix->h.nrec += ix->nb;
+    block_reset (ix);
+}
+
+void rec_index_add (struct REC_IXW *ix, char *rec) {
+
+    /* Add the next record of the container. */
+
+    struct REC_KEYS *k = &ix->h.keys;
+    struct REC_BLOCK *b = &ix->b;
+    unsigned int sec, usec;
+    unsigned short surf;
+    int     lat, lon;
+    double  t;
+
+    memcpy (&sec, rec + k->sec, sizeof (sec));
+    memcpy (&usec, rec + k->usec, sizeof (usec));
+    memcpy (&lat, rec + k->lat, sizeof (lat));
+    memcpy (&lon, rec + k->lon, sizeof (lon));
+    memcpy (&surf, rec + k->surf, sizeof (surf));
+    b->nsurf[(surf < REC_NSURF) ? surf : REC_NSURF - 1]++;
+    if (sec != 0 && sec != k->nan && lat != (int)k->nan && lon != (int)k->nan) {
+        t = sec + 1.e-6 * usec;
+        if (b->nvalid == 0) {
+            b->tmin = b->tmax = t;
+            b->latmin = b->latmax = lat;
+            b->lonmin = b->lonmax = lon;
+        }
+        if (t < b->tmin) b->tmin = t;
+        if (t > b->tmax) b->tmax = t;
+        if (lat < b->latmin) b->latmin = lat;
+        if (lat > b->latmax) b->latmax = lat;
+        if (lon < b->lonmin) b->lonmin = lon;
+        if (lon > b->lonmax) b->lonmax = lon;
+        b->nvalid++;
+    }
+    if (++ix->nb == REC_IXBLOCK) block_flush (ix);
+}
+
+int rec_index_close (struct REC_IXW *ix) {
+
+    /* Write the last partial block and the final header.  Returns 0 on success. */
+
+    block_flush (ix);
+    if (!ix->err) ix->err = (fseek (ix->fp, 0L, SEEK_SET) || fwrite (&ix->h, sizeof (ix->h), 1, ix->fp) != 1);
+    if (fclose (ix->fp) || ix->err) {
+        fprintf (stderr, "Failed to write record index\n");
+        return (1);
+    }
+    return (0);
+}
+
+struct REC_BLOCK *rec_index_read (char *idxname, struct REC_HEAD *head, struct REC_INDEX *h) {
+
+    /* Read an index and check that it belongs to the container whose header
+       is head.  Returns the malloc'ed blocks, or NULL on failure. */
+
+    struct REC_BLOCK *b;
+    FILE    *fp;
+
+    if ((fp = fopen (idxname, "rb")) == NULL) {
+        fprintf (stderr, "Failed to open %s\n", idxname);
+        return (NULL);
+    }
+    if (fread (h, sizeof (*h), 1, fp) != 1 || memcmp (h->magic, REC_IXMAGIC, 8)
+        || h->endian != REC_ENDIAN || h->version < 2 || h->version > REC_VERSION) {
+        fprintf (stderr, "Failed: %s is not a record index\n", idxname);
+        fclose (fp);
+        return (NULL);
+    }
+    if (h->mission != head->mission || h->layout != head->layout || h->recsize != head->recsize
+        || h->nrec != head->nrec || h->block == 0) {
+        fprintf (stderr, "Failed: %s does not index this record file; rebuild it\n", idxname);
+        fclose (fp);
+        return (NULL);
+    }
+    b = (struct REC_BLOCK *) malloc ((h->nblock + 1) * sizeof (struct REC_BLOCK));
+    if (b == NULL || fread (b, sizeof (struct REC_BLOCK), h->nblock, fp) != h->nblock) {
+        fprintf (stderr, "Failed to read %s\n", idxname);
+        free ( (void *)b);
+        fclose (fp);
+        return (NULL);
+    }
+    fclose (fp);
+    return (b);
+}
+
+static int in_arc (double lon, double start, double len) {
+    /* lon (deg) lies within len degrees east of start */
+    return (fmod (lon - start + 720., 360.) <= len);
+}
+
+static int lon_match (double lon1, double lon2, struct REC_QUERY *q) {
+
+    /* The longitude arc from lon1 east to lon2 (1e-6 deg, either convention)
+       meets the query's west-east arc. */
+
+    double  qlen = q->east - q->west, len = 1.e-6 * (lon2 - lon1);
+
+    if (qlen < 0.) qlen += 360.;
+    if (q->east - q->west >= 360. || len >= 360.) return (1);
+    return (in_arc (1.e-6 * lon1, q->west, qlen) || in_arc (q->west, 1.e-6 * lon1, len));
+}
+
+int rec_block_match (struct REC_BLOCK *b, struct REC_QUERY *q) {
+
+    /* Could any record of block b satisfy q? */
+
+    unsigned int f;
+    int     any = 0;
+
+    if (q->surf != 0) {
+        for (f = 0; f < REC_NSURF; f++) {
+            if (b->nsurf[f] > 0 && (q->surf & (1u << f))) any = 1;
+        }
+        if (!any) return (0);
+    }
+    if (!q->use_t && !q->use_r) return (1);
+    if (b->nvalid == 0) return (0);
+    if (q->use_t && (b->tmax < q->t0 || b->tmin > q->t1)) return (0);
+    if (q->use_r && (1.e-6 * b->latmax < q->south || 1.e-6 * b->latmin > q->north)) return (0);
+    if (q->use_r && !lon_match ((double)b->lonmin, (double)b->lonmax, q)) return (0);
+    return (1);
+}
+
+int rec_match (char *rec, struct REC_KEYS *k, struct REC_QUERY *q) {
+
+    /* Does one record satisfy q? */
+
+    unsigned int sec, usec;
+    unsigned short surf;
+    int     lat, lon;
+    double  t;
+
+    memcpy (&surf, rec + k->surf, sizeof (surf));
+    if (q->surf != 0 && !(q->surf & (1u << ((surf < REC_NSURF) ? surf : REC_NSURF - 1)))) return (0);
+    if (!q->use_t && !q->use_r) return (1);
+    memcpy (&sec, rec + k->sec, sizeof (sec));
+    memcpy (&usec, rec + k->usec, sizeof (usec));
+    memcpy (&lat, rec + k->lat, sizeof (lat));
+    memcpy (&lon, rec + k->lon, sizeof (lon));
+    if (sec == 0 || sec == k->nan || lat == (int)k->nan || lon == (int)k->nan) return (0);
+    t = sec + 1.e-6 * usec;
+    if (q->use_t && (t < q->t0 || t > q->t1)) return (0);
+    if (q->use_r && (1.e-6 * lat < q->south || 1.e-6 * lat > q->north)) return (0);
+    if (q->use_r && !lon_match ((double)lon, (double)lon, q)) return (0);
+    return (1);
+}
@@ -0,0 +1,171 @@
+/*  run_parallel.c
+
+ Process several input files concurrently but keep the output in the order
+ the files were given.  Each file is handled in a forked worker whose stdout
+ is an unlinked scratch file of its own, so a worker never waits on the
+ parent or on the others however much it writes.  The parent reaps workers
+ as they finish, starts the next file in the freed slot, and copies the
+ finished scratch files to our stdout oldest first, so records reach it
+ exactly as the serial loop would have written them.  Each worker reports
+ its handler's record count on a pipe; a file whose handler reports none
+ has failed, and its scratch is dropped, so a failed file writes nothing.
+ At most AHEAD times njobs files are started ahead of the oldest one still
+ unwritten, which bounds the scratch space a slow file can hold up.
+ Workers are processes, not threads, because netcdf-c is not reliably
+ thread-safe.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "run_parallel.h"
+
+#define COPY_BUF 65536
+#define AHEAD    4
+
+struct JOB {
+    pid_t   pid;
+    FILE    *spill;     /* the worker's stdout */
+    int     cfd;        /* read end of the pipe carrying the worker's record count */
+    int     done;       /* reaped */
+    size_t  n;          /* the worker's record count, 0 if it failed */
+};
+
+static int start_job (struct JOB *job, char *fname, file_handler handle, struct JOB *jobs, int njob) {
+
+    /* Fork a worker for one file.  Returns 0 on success. */
+
+    int     c[2], m;
+    size_t  n;
+
+    job->n = 0;
+    if ((job->spill = tmpfile ()) == NULL) {
+        fprintf (stderr, "run_parallel: no scratch file for %s: %s\n", fname, strerror (errno));
+        return (1);
+    }
+    if (pipe (c) < 0) {
+        fprintf (stderr, "run_parallel: pipe failed for %s: %s\n", fname, strerror (errno));
+        fclose (job->spill);
+        job->spill = NULL;
+        return (1);
+    }
+    fflush (stdout);    /* don't let the child inherit unwritten output */
+    fflush (stderr);
+    job->pid = fork ();
+    if (job->pid < 0) {
+        fprintf (stderr, "run_parallel: fork failed for %s: %s\n", fname, strerror (errno));
+        fclose (job->spill);
+        job->spill = NULL;
+        close (c[0]);
+        close (c[1]);
+        return (1);
+    }
+    if (job->pid == 0) {
+        /* Worker: drop the other workers' count pipes, write our records into our scratch. */
+        for (m = 0; m < njob; m++) {
+            if (&jobs[m] != job && jobs[m].cfd >= 0) close (jobs[m].cfd);
+        }
+        close (c[0]);
+        if (dup2 (fileno (job->spill), STDOUT_FILENO) < 0) _exit (EXIT_FAILURE);
+        n = handle (fname);
+        if (fflush (stdout)) n = 0;
+        if (write (c[1], &n, sizeof (n)) != sizeof (n)) _exit (EXIT_FAILURE);
+        _exit (n > 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+    close (c[1]);
+    job->cfd = c[0];
+    job->done = 0;
+    return (0);
+}
+
+static void reap_job (struct JOB *job) {
+
+    /* The count of a worker that has exited */
+
+    ssize_t nr;
+
+    while ((nr = read (job->cfd, &job->n, sizeof (job->n))) < 0 && errno == EINTR);
+    if (nr != sizeof (job->n)) job->n = 0;
+    close (job->cfd);
+    job->cfd = -1;
+    job->done = 1;
+}
+
+static size_t emit_job (struct JOB *job, char *fname) {
+
+    /* Copy a finished worker's scratch to our stdout and drop it; returns
+       the worker's record count, or 0 if it failed */
+
+    static char buf[COPY_BUF];
+    size_t  nr;
+
+    if (job->spill == NULL) return (0);
+    if (job->n > 0) {
+        rewind (job->spill);
+        while ((nr = fread (buf, 1, COPY_BUF, job->spill)) > 0) {
+            if (fwrite (buf, 1, nr, stdout) != nr) {
+                fprintf (stderr, "Failure writing output for file %s\n", fname);
+                break;
+            }
+        }
+        if (ferror (job->spill)) fprintf (stderr, "run_parallel: read failed for %s\n", fname);
+    }
+    fclose (job->spill);
+    job->spill = NULL;
+    return (job->n);
+}
+
+size_t run_parallel (int nfiles, char **fnames, int njobs, file_handler handle) {
+
+    /* Returns the total number of records written to stdout. */
+
+    struct JOB *jobs;
+    size_t  n_out = 0;
+    pid_t   pid;
+    int     k, next = 0, emit = 0, running = 0, status;
+
+    if (njobs > nfiles) njobs = nfiles;
+    if (njobs < 1) return (0);
+
+    jobs = (struct JOB *) malloc (nfiles * sizeof (struct JOB));
+    if (jobs == NULL) {
+        fprintf (stderr, "run_parallel: failed to malloc job table\n");
+        return (0);
+    }
+    for (k = 0; k < nfiles; k++) {
+        jobs[k].cfd = -1;
+        jobs[k].spill = NULL;
+        jobs[k].done = 1;
+        jobs[k].n = 0;
+    }
+
+    while (emit < nfiles) {
+        /* fill the free slots, then write out whatever is finished in order */
+        while (running < njobs && next < nfiles && next - emit < AHEAD * njobs) {
+            if (start_job (&jobs[next], fnames[next], handle, jobs, next) == 0) running++;
+            next++;
+        }
+        while (emit < next && jobs[emit].done) {
+            n_out += emit_job (&jobs[emit], fnames[emit]);
+            emit++;
+        }
+        if (running == 0) continue;
+        while ((pid = waitpid (-1, &status, 0)) < 0 && errno == EINTR);
+        if (pid < 0) break;
+        for (k = emit; k < next; k++) {
+            if (!jobs[k].done && jobs[k].pid == pid) {
+                reap_job (&jobs[k]);
+                running--;
+                break;
+            }
+        }
+    }
+    free ((void *)jobs);
+    return (n_out);
+}
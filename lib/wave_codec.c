@@ -0,0 +1,182 @@
+/*  wave_codec.c
+
+ Gate-delta, zigzag, block bit-width code for waveforms (wave_codec.h).
+
+ Decoding a full block with SSE2 is one or two loads, a widen to 16 bits,
+ the zigzag undo and an 8-lane prefix sum in three shifted adds, with the
+ running gate carried across vectors in a register; blocks shorter than
+ WAVE_BGATE (the tail of a 104-gate waveform) take the scalar path.  The
+ result is the same either way, as the code is exact integer arithmetic.
+ */
+
+#include <string.h>
+#include "wave_codec.h"
+#include "cvt_kernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define WC_X86 1
+#include <emmintrin.h>
+#endif
+
+#define CLASS(code, b)  (((code)[(b) >> 2] >> (2 * ((b) & 3))) & 3)
+
+static size_t block_bytes (int cls, int n) {
+    /* bytes of a block of n gates in width class cls: 0, 4, 8 or 16 bits */
+    return ((cls == 0) ? 0 : (cls == 1) ? (size_t)(n + 1) / 2 : (cls == 2) ? (size_t)n : 2 * (size_t)n);
+}
+
+size_t wave_encode (const unsigned short *wave, int ngate, unsigned char *code) {
+
+    /* Code ngate gates into code[], at most WAVE_MAXCODE(ngate) bytes.
+       Returns the bytes used. */
+
+    unsigned short zz[WAVE_BGATE], prev = 0, d;
+    unsigned char *p;
+    int     b, j, n, cls;
+    unsigned int max;
+
+    memset (code, 0, WAVE_NCLASS (ngate));
+    p = code + WAVE_NCLASS (ngate);
+    for (b = 0; b * WAVE_BGATE < ngate; b++) {
+        n = (ngate - b * WAVE_BGATE < WAVE_BGATE) ? ngate - b * WAVE_BGATE : WAVE_BGATE;
+        for (max = 0, j = 0; j < n; j++) {
+            d = (unsigned short)(wave[b*WAVE_BGATE+j] - prev);
+            prev = wave[b*WAVE_BGATE+j];
+            zz[j] = (unsigned short)((d << 1) ^ ((d & 0x8000) ? 0xffff : 0));
+            max |= zz[j];
+        }
+        cls = (max == 0) ? 0 : (max < 16) ? 1 : (max < 256) ? 2 : 3;
+        code[b >> 2] |= (unsigned char)(cls << (2 * (b & 3)));
+        switch (cls) {
+            case 1:
+                for (j = 0; j < n; j += 2) *p++ = (unsigned char)(zz[j] | ((j + 1 < n) ? zz[j+1] << 4 : 0));
+                break;
+            case 2:
+                for (j = 0; j < n; j++) *p++ = (unsigned char)zz[j];
+                break;
+            case 3:     /* little endian, whatever the host */
+                for (j = 0; j < n; j++) {
+                    *p++ = (unsigned char)(zz[j] & 0xff);
+                    *p++ = (unsigned char)(zz[j] >> 8);
+                }
+                break;
+        }
+    }
+    return ((size_t)(p - code));
+}
+
+size_t wave_code_len (const unsigned char *code, int ngate) {
+
+    /* Length of a code from its class bytes, so a reader can fetch the rest */
+
+    size_t  len = WAVE_NCLASS (ngate);
+    int     b, n;
+
+    for (b = 0; b * WAVE_BGATE < ngate; b++) {
+        n = (ngate - b * WAVE_BGATE < WAVE_BGATE) ? ngate - b * WAVE_BGATE : WAVE_BGATE;
+        len += block_bytes (CLASS (code, b), n);
+    }
+    return (len);
+}
+
+static unsigned short unzig (unsigned int z) {
+    return ((unsigned short)((z >> 1) ^ ((z & 1) ? 0xffff : 0)));
+}
+
+static const unsigned char *block_scalar (const unsigned char *p, int cls, int n, unsigned short *w, unsigned short *prev) {
+
+    /* Decode one block of n gates from p; returns the end of the block */
+
+    int     j;
+    unsigned int z;
+
+    for (j = 0; j < n; j++) {
+        switch (cls) {
+            case 0: z = 0; break;
+            case 1: z = (j & 1) ? p[j>>1] >> 4 : p[j>>1] & 0x0f; break;
+            case 2: z = p[j]; break;
+            default: z = p[2*j] | (p[2*j+1] << 8); break;
+        }
+        *prev = (unsigned short)(*prev + unzig (z));
+        w[j] = *prev;
+    }
+    return (p + block_bytes (cls, n));
+}
+
+static size_t decode_scalar (const unsigned char *code, int ngate, unsigned short *wave) {
+    const unsigned char *p = code + WAVE_NCLASS (ngate);
+    unsigned short prev = 0;
+    int     b, n;
+
+    for (b = 0; b * WAVE_BGATE < ngate; b++) {
+        n = (ngate - b * WAVE_BGATE < WAVE_BGATE) ? ngate - b * WAVE_BGATE : WAVE_BGATE;
+        p = block_scalar (p, CLASS (code, b), n, wave + b * WAVE_BGATE, &prev);
+    }
+    return ((size_t)(p - code));
+}
+
+#ifdef WC_X86
+/* ------------------------------------------------------------------ SSE2 */
+
+static __m128i sum8_sse2 (__m128i z, __m128i *carry) {
+    /* undo zigzag, prefix sum the 8 steps onto carry, and carry the last gate on */
+    __m128i one = _mm_set1_epi16 (1), d, t;
+    d = _mm_xor_si128 (_mm_srli_epi16 (z, 1), _mm_sub_epi16 (_mm_setzero_si128 (), _mm_and_si128 (z, one)));
+    d = _mm_add_epi16 (d, _mm_slli_si128 (d, 2));
+    d = _mm_add_epi16 (d, _mm_slli_si128 (d, 4));
+    d = _mm_add_epi16 (d, _mm_slli_si128 (d, 8));
+    d = _mm_add_epi16 (d, *carry);
+    t = _mm_shufflehi_epi16 (d, 0xff);
+    *carry = _mm_unpackhi_epi64 (t, t);
+    return (d);
+}
+
+static size_t decode_sse2 (const unsigned char *code, int ngate, unsigned short *wave) {
+    const unsigned char *p = code + WAVE_NCLASS (ngate);
+    __m128i zero = _mm_setzero_si128 (), nib = _mm_set1_epi8 (0x0f), carry = zero, v, lo, hi;
+    unsigned short prev;
+    int     b, cls;
+
+    for (b = 0; (b + 1) * WAVE_BGATE <= ngate; b++) {
+        cls = CLASS (code, b);
+        switch (cls) {
+            case 0:
+                lo = hi = zero;
+                break;
+            case 1:     /* 8 bytes of nibbles, low nibble first */
+                v = _mm_loadl_epi64 ((const __m128i *)p);
+                v = _mm_unpacklo_epi8 (_mm_and_si128 (v, nib), _mm_and_si128 (_mm_srli_epi16 (v, 4), nib));
+                lo = _mm_unpacklo_epi8 (v, zero);
+                hi = _mm_unpackhi_epi8 (v, zero);
+                break;
+            case 2:
+                v = _mm_loadu_si128 ((const __m128i *)p);
+                lo = _mm_unpacklo_epi8 (v, zero);
+                hi = _mm_unpackhi_epi8 (v, zero);
+                break;
+            default:
+                lo = _mm_loadu_si128 ((const __m128i *)p);
+                hi = _mm_loadu_si128 ((const __m128i *)(p + 16));
+                break;
+        }
+        _mm_storeu_si128 ((__m128i *)(wave + b * WAVE_BGATE), sum8_sse2 (lo, &carry));
+        _mm_storeu_si128 ((__m128i *)(wave + b * WAVE_BGATE + 8), sum8_sse2 (hi, &carry));
+        p += block_bytes (cls, WAVE_BGATE);
+    }
+    if (b * WAVE_BGATE < ngate) {
+        prev = (unsigned short)_mm_cvtsi128_si32 (carry);
+        p = block_scalar (p, CLASS (code, b), ngate - b * WAVE_BGATE, wave + b * WAVE_BGATE, &prev);
+    }
+    return ((size_t)(p - code));
+}
+#endif /* WC_X86 */
+
+size_t wave_decode (const unsigned char *code, int ngate, unsigned short *wave) {
+
+    /* Decode ngate gates; returns the bytes of code used */
+
+#ifdef WC_X86
+    if (cvt_level () >= CVT_SSE2) return (decode_sse2 (code, ngate, wave));
+#endif
+    return (decode_scalar (code, ngate, wave));
+}
@@ -0,0 +1,74 @@
+/*  wave_plane.c
+
+ Writers of records from the structure-of-arrays layout in wave_plane.h.
+ write_interleaved() is the compatibility path that rebuilds the legacy
+ interleaved structs (scalars followed by wave[]) from the two arrays;
+ write_coded() writes the records of a compressed container (REC_ZWAVE in
+ rec_file.h) straight from them.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "wave_plane.h"
+#include "wave_codec.h"
+
+#define STAGE 256   /* records staged per fwrite by write_interleaved */
+
+size_t write_interleaved (FILE *fp, char *scalars, size_t scalar_size, unsigned short *plane, int ngate, size_t n, size_t recsize) {
+
+    /* Write n legacy records of recsize bytes: the scalar members, then the
+       waveform, zero-padded past ngate gates.  Returns records written. */
+
+    static char *stage = NULL;
+    static size_t stage_size = 0;
+    size_t  k, b, nb, nout = 0;
+    char    *r;
+
+    if (stage_size < STAGE * recsize) {
+        free ( (void *)stage);
+        stage = (char *) malloc (STAGE * recsize);
+        stage_size = (stage == NULL) ? 0 : STAGE * recsize;
+        if (stage == NULL) return (0);
+    }
+    memset (stage, 0, stage_size);
+    for (b = 0; b < n; b += nb) {
+        nb = (n - b < STAGE) ? n - b : STAGE;
+        for (k = 0; k < nb; k++) {
+            r = stage + k * recsize;
+            memcpy (r, scalars + (b + k) * scalar_size, scalar_size);
+            if (ngate > 0) memcpy (r + scalar_size, plane + (b + k) * ngate, ngate * sizeof (unsigned short));
+        }
+        k = fwrite ((void *)stage, recsize, nb, fp);
+        nout += k;
+        if (k != nb) break;
+    }
+    return (nout);
+}
+
+size_t write_coded (FILE *fp, char *scalars, size_t scalar_size, unsigned short *plane, int ngate, size_t n, int mgate) {
+
+    /* Write n records as the scalar members and then the waveform, zero
+       padded past ngate to the mgate gates of wave[], in wave_codec.h code.
+       Returns records written. */
+
+    unsigned short *w;
+    unsigned char *code;
+    size_t  k, len;
+
+    w = (unsigned short *) calloc (mgate, sizeof (unsigned short));
+    code = (unsigned char *) malloc (WAVE_MAXCODE (mgate));
+    if (w == NULL || code == NULL || ngate > mgate) {
+        free ( (void *)w);
+        free ( (void *)code);
+        return (0);
+    }
+    for (k = 0; k < n; k++) {
+        if (ngate > 0) memcpy (w, plane + k * ngate, ngate * sizeof (unsigned short));
+        len = wave_encode (w, mgate, code);
+        if (fwrite ((void *)(scalars + k * scalar_size), scalar_size, 1, fp) != 1 || fwrite ((void *)code, len, 1, fp) != 1) break;
+    }
+    free ( (void *)w);
+    free ( (void *)code);
+    return (k);
+}
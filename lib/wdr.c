@@ -0,0 +1,93 @@
+/*  wdr.c
+
+ Sea surface height from a retracked 20 Hz record (wdr.h).  Members are
+ found by offset, as in retrack, so the same code serves every mission
+ whose struct has the usual height and correction members.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include "wdr.h"
+#include "cryosat20hz.h"
+#include "jason20hz.h"
+#include "altika40hz.h"
+
+#define WDR(S) sizeof (struct S), offsetof (struct S, alt), offsetof (struct S, range), \
+    offsetof (struct S, trackbits), offsetof (struct S, surf_flag), offsetof (struct S, drange), \
+    offsetof (struct S, hotide), offsetof (struct S, hltide), offsetof (struct S, hstide), \
+    offsetof (struct S, hptide), offsetof (struct S, hiono), offsetof (struct S, hwet), \
+    offsetof (struct S, hdry), offsetof (struct S, hinvb), offsetof (struct S, hdopp)
+
+static struct WDR_MISSION missions[] = {
+    {REC_CRYOSAT, CRYOSAT20HZ_LAYOUT, WDR(CRYOSAT20HZ), 1},
+    {REC_JASON,   JASON20HZ_LAYOUT,   WDR(JASON20HZ),   0},
+    {REC_ALTIKA,  SARAL40HZ_LAYOUT,   WDR(SARAL40HZ),   0},
+};
+#define NMISSIONS (int)(sizeof (missions) / sizeof (missions[0]))
+
+struct WDR_MISSION *wdr_mission (struct REC_HEAD *h) {
+
+    /* The height members of the records in a container, or NULL */
+
+    int     i;
+
+    for (i = 0; i < NMISSIONS; i++) {
+        if (missions[i].mission == h->mission && missions[i].layout == h->layout
+            && missions[i].recsize == h->recsize) return (&missions[i]);
+    }
+    fprintf (stderr, "Failed: no sea surface height for mission %u records, layout %08x\n", h->mission, h->layout);
+    return (NULL);
+}
+
+static int get_i2 (char *rec, size_t off, double *sum) {
+
+    /* Add a short member, mm, to sum in m; 1 if it is missing */
+
+    short   i2;
+
+    memcpy (&i2, rec + off, sizeof (i2));
+    if (i2 == I2NaN) return (1);
+    *sum += 1.e-3 * i2;
+    return (0);
+}
+
+int wdr_point (struct WDR_MISSION *m, struct REC_HEAD *h, char *rec, int slot, struct WDR_POINT *p) {
+
+    /* Height, corrections, time and position of one record, using the
+       retracker's drange[slot].  Returns 0, or 1 if the record is flagged,
+       not ocean, or missing something the height needs. */
+
+    unsigned int sec, usec, alt, range, bits;
+    unsigned short surf;
+    int     lat, lon, bad;
+    double  cor = 0.;
+    short   dr;
+
+    memcpy (&bits, rec + m->trackbits, sizeof (bits));
+    memcpy (&surf, rec + m->surf, sizeof (surf));
+    if ((bits & (WDR_BADBITS | WDR_FITBITS (slot))) || surf > 1) return (1);     /* ocean and closed seas */
+    memcpy (&sec, rec + h->keys.sec, sizeof (sec));
+    memcpy (&usec, rec + h->keys.usec, sizeof (usec));
+    memcpy (&lat, rec + h->keys.lat, sizeof (lat));
+    memcpy (&lon, rec + h->keys.lon, sizeof (lon));
+    if (sec == 0 || sec == h->keys.nan || lat == (int)h->keys.nan || lon == (int)h->keys.nan) return (1);
+    memcpy (&alt, rec + m->alt, sizeof (alt));
+    memcpy (&range, rec + m->range, sizeof (range));
+    memcpy (&dr, rec + m->drange + slot * sizeof (dr), sizeof (dr));
+    if (alt == 0 || range == 0 || alt == (unsigned int)I4NaN || range == (unsigned int)I4NaN) return (1);
+
+    bad = get_i2 (rec, m->hdry, &cor) | get_i2 (rec, m->hwet, &cor) | get_i2 (rec, m->hiono, &cor)
+        | get_i2 (rec, m->hdopp, &cor) | get_i2 (rec, m->hotide, &cor) | get_i2 (rec, m->hstide, &cor)
+        | get_i2 (rec, m->hptide, &cor) | get_i2 (rec, m->hinvb, &cor);
+    if (m->load) bad |= get_i2 (rec, m->hltide, &cor);
+    if (bad) return (1);
+
+    p->t = sec + 1.e-6 * usec;
+    p->lat = 1.e-6 * lat;
+    p->lon = 1.e-6 * lon;
+    p->cor = cor;
+    /* alt and range share any product offset (1300 km for Jason), which cancels */
+    p->h = 1.e-3 * ((double)alt - (double)range - dr) - cor;
+    return (0);
+}
@@ -0,0 +1,62 @@
+/*  xover.c
+
+ Reader and writer for the crossover files of xover.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "xover.h"
+
+int xo_write (char *fname, struct XOVER *x, size_t n) {
+
+    /* Returns 0 on success */
+
+    struct XO_HEAD h;
+    FILE    *fp;
+    int     err;
+
+    memset (&h, 0, sizeof (h));
+    memcpy (h.magic, XO_MAGIC, 8);
+    h.endian = XO_ENDIAN;
+    h.version = XO_VERSION;
+    h.n = (long long)n;
+    if ((fp = fopen (fname, "wb")) == NULL) {
+        fprintf (stderr, "Failed to open %s\n", fname);
+        return (1);
+    }
+    err = (fwrite (&h, sizeof (h), 1, fp) != 1 || fwrite (x, sizeof (struct XOVER), n, fp) != n);
+    err |= (fclose (fp) != 0);
+    if (err) fprintf (stderr, "Failure writing %s\n", fname);
+    return (err);
+}
+
+struct XOVER *xo_read (char *fname, size_t *n) {
+
+    /* The crossovers in fname, malloc'ed, or NULL on failure */
+
+    struct XO_HEAD h;
+    struct XOVER *x;
+    FILE    *fp;
+
+    if ((fp = fopen (fname, "rb")) == NULL) {
+        fprintf (stderr, "Failed to open %s\n", fname);
+        return (NULL);
+    }
+    if (fread (&h, sizeof (h), 1, fp) != 1 || memcmp (h.magic, XO_MAGIC, 8)
+        || h.endian != XO_ENDIAN || h.version != XO_VERSION || h.n < 0) {
+        fprintf (stderr, "Failed: %s is not a crossover file\n", fname);
+        fclose (fp);
+        return (NULL);
+    }
+    x = (struct XOVER *) malloc (((size_t)h.n + 1) * sizeof (struct XOVER));
+    if (x == NULL || fread (x, sizeof (struct XOVER), (size_t)h.n, fp) != (size_t)h.n) {
+        fprintf (stderr, "Failed to read %s\n", fname);
+        free ( (void *)x);
+        fclose (fp);
+        return (NULL);
+    }
+    fclose (fp);
+    *n = (size_t)h.n;
+    return (x);
+}
@@ -0,0 +1,72 @@
+/*  altika40hz.c
+
+ For reading SARAL/AltiKa SGDR data and dumping the 40Hz values we want.
+ AltiKa is a single Ka-band altimeter sampling at 40 Hz, twice the rate
+ of the Ku-band missions, so its 40 Hz variables are [time][meas_ind] with
+ 40 records per 1 Hz row and each 1 Hz correction is spread over 40
+ records.  With no second frequency the ionosphere comes from the GIM
+ model, and the second-band members of struct SARAL40HZ stay zero.
+ Same command line and output modes as cryosat20hz.
+ */
+
+#include "altika40hz.h"
+#include "ingest.h"
+#include "rec_file.h"
+
+/* SGDR schema: NetCDF variable -> struct SARAL40HZ member.  Values are
+   read unpacked, so lat/lon are already 1e-6 deg and heights 1e-4 m;
+   alt and range keep the product's 1300 km offset.  AltiKa is Ka-band
+   only, so range_c and agc_c stay zero, as do the members filled by
+   retracking (pamp, pswh, rchisq, pnoise, drange, decay, beam, hdopp, new_tide). */
+#define SA(m) offsetof(struct SARAL40HZ, m)
+static struct NC_FIELD altika_fields[] = {
+    /* name                      conv       type    offset          offset2         count rate     scale nan    use */
+    {"time_40hz",               NCF_TIME,  NCF_U4, SA(sec2000),    SA(microsec),   1,   NCF_20HZ, 1.,  I4NaN, 1},
+    {"lat_40hz",                NCF_COPY,  NCF_I4, SA(lat),        0,              1,   NCF_20HZ, 1.,  I4NaN, 1},
+    {"lon_40hz",                NCF_LON,   NCF_I4, SA(lon),        0,              1,   NCF_20HZ, 1.,  I4NaN, 1},
+    {"alt_40hz",                NCF_ROUND, NCF_U4, SA(alt),        0,              1,   NCF_20HZ, 10., 0,     1},
+    {"range_40hz",              NCF_ROUND, NCF_U4, SA(range),      0,              1,   NCF_20HZ, 10., I4NaN, 1},
+    {"agc_40hz",                NCF_COPY,  NCF_I4, SA(agc),        0,              1,   NCF_20HZ, 1.,  0,     1},
+    {"alt_dot",                 NCF_COPY,  NCF_U4, SA(alt_rate),   0,              1,   NCF_01HZ, 1.,  0,     1},
+    {"off_nadir_angle_wf",      NCF_COPY,  NCF_I4, SA(off_nadir[0]),0,             1,   NCF_01HZ, 1.,  0,     1},
+    {"surface_type",            NCF_COPY,  NCF_U2, SA(surf_flag),  0,              1,   NCF_01FLAG, 1., 0,    1},
+    {"mean_sea_surface",        NCF_ROUND, NCF_I4, SA(mss),        0,              1,   NCF_01HZ, 10., I4NaN, 1},
+    {"ocean_tide_sol1",         NCF_ROUND, NCF_I2, SA(hotide),     0,              1,   NCF_01HZ, 10., I2NaN, 1},
+    {"load_tide_sol1",          NCF_ROUND, NCF_I2, SA(hltide),     0,              1,   NCF_01HZ, 10., I2NaN, 1},
+    {"solid_earth_tide",        NCF_ROUND, NCF_I2, SA(hstide),     0,              1,   NCF_01HZ, 10., I2NaN, 1},
+    {"pole_tide",               NCF_ROUND, NCF_I2, SA(hptide),     0,              1,   NCF_01HZ, 10., I2NaN, 1},
+    {"iono_corr_gim",           NCF_ROUND, NCF_I2, SA(hiono),      0,              1,   NCF_01HZ, 10., I2NaN, 1},
+    {"model_wet_tropo_corr",    NCF_ROUND, NCF_I2, SA(hwet),       0,              1,   NCF_01HZ, 10., I2NaN, 1},
+    {"model_dry_tropo_corr",    NCF_ROUND, NCF_I2, SA(hdry),       0,              1,   NCF_01HZ, 10., I2NaN, 1},
+    {"inv_bar_corr",            NCF_ROUND, NCF_I2, SA(hinvb),      0,              1,   NCF_01HZ, 10., I2NaN, 1},
+    {"waveforms_40hz",          NCF_WAVE,  NCF_U2, SA(wave),       SA(csum),       128, NCF_20HZ, 1.,  0,     1},
+};
+#define NFIELDS (int)(sizeof (altika_fields) / sizeof (altika_fields[0]))
+
+static void finish (char *scal, size_t scalar_size, size_t k0, size_t n) {
+
+    /* number the 40 Hz records within the file and flag those with no time
+       or no Ka-band range, which with one band leaves nothing to use */
+
+    struct SARAL40HZ *r;
+    size_t  k;
+
+    for (k = 0; k < n; k++) {
+        r = (struct SARAL40HZ *)(scal + k * scalar_size);   /* scalar members only */
+        r->kframe = (unsigned int)(k0 + k);
+        if(r->sec2000 <= 0 || r->sec2000 == I4NaN || r->range == I4NaN) r->trackbits = 1;
+    }
+}
+
+static struct MISSION altika = {
+    "altika40hz", "saral40hz", REC_ALTIKA, SARAL40HZ_LAYOUT,
+    altika_fields, NFIELDS,
+    sizeof (struct SARAL40HZ), SA(wave),
+    SA(lat), SA(lon), SA(surf_flag),
+    "time", 40, "time", "time_40hz", "time",
+    finish
+};
+
+int main (int argc, char **argv) {
+    exit (ingest_main (&altika, argc, argv));
+}
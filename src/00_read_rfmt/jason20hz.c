@@ -0,0 +1,69 @@
+/*  jason20hz.c
+
+ For reading Jason-2 and Jason-3 (S)GDR-D data and dumping the 20Hz values we want.
+ Same command line and output modes as cryosat20hz; the products differ in
+ storing 20 Hz variables as [time][meas_ind] with 20 records per 1 Hz row.
+ */
+
+#include "jason20hz.h"
+#include "ingest.h"
+#include "rec_file.h"
+
+/* (S)GDR-D schema: NetCDF variable -> struct JASON20HZ member.  Values are
+   read unpacked, so lat/lon are already 1e-6 deg and heights 1e-4 m;
+   alt and range keep the product's 1300 km offset.  Members not listed
+   (pamp, pswh, rchisq, pnoise, drange, decay, beam, hdopp, new_tide) are
+   zero until retracking fills them. */
+#define JS(m) offsetof(struct JASON20HZ, m)
+static struct NC_FIELD jason_fields[] = {
+    /* name                      conv       type    offset          offset2         count rate     scale nan    use */
+    {"time_20hz",               NCF_TIME,  NCF_U4, JS(sec2000),    JS(microsec),   1,   NCF_20HZ, 1.,  I4NaN, 1},
+    {"lat_20hz",                NCF_COPY,  NCF_I4, JS(lat),        0,              1,   NCF_20HZ, 1.,  I4NaN, 1},
+    {"lon_20hz",                NCF_LON,   NCF_I4, JS(lon),        0,              1,   NCF_20HZ, 1.,  I4NaN, 1},
+    {"alt_20hz",                NCF_ROUND, NCF_U4, JS(alt),        0,              1,   NCF_20HZ, 10., 0,     1},
+    {"range_20hz_ku",           NCF_ROUND, NCF_U4, JS(range),      0,              1,   NCF_20HZ, 10., I4NaN, 1},
+    {"range_20hz_c",            NCF_ROUND, NCF_U4, JS(range_c),    0,              1,   NCF_20HZ, 10., I4NaN, 1},
+    {"agc_20hz_ku",             NCF_COPY,  NCF_I4, JS(agc_ku),     0,              1,   NCF_20HZ, 1.,  0,     1},
+    {"agc_20hz_c",              NCF_COPY,  NCF_I4, JS(agc_c),      0,              1,   NCF_20HZ, 1.,  0,     1},
+    {"alt_dot",                 NCF_COPY,  NCF_U4, JS(alt_rate),   0,              1,   NCF_01HZ, 1.,  0,     1},
+    {"off_nadir_angle_wf_ku",   NCF_COPY,  NCF_I4, JS(off_nadir[0]),0,             1,   NCF_01HZ, 1.,  0,     1},
+    {"surface_type",            NCF_COPY,  NCF_U2, JS(surf_flag),  0,              1,   NCF_01FLAG, 1., 0,    1},
+    {"mean_sea_surface",        NCF_ROUND, NCF_I4, JS(mss),        0,              1,   NCF_01HZ, 10., I4NaN, 1},
+    {"ocean_tide_sol1",         NCF_ROUND, NCF_I2, JS(hotide),     0,              1,   NCF_01HZ, 10., I2NaN, 1},
+    {"load_tide_sol1",          NCF_ROUND, NCF_I2, JS(hltide),     0,              1,   NCF_01HZ, 10., I2NaN, 1},
+    {"solid_earth_tide",        NCF_ROUND, NCF_I2, JS(hstide),     0,              1,   NCF_01HZ, 10., I2NaN, 1},
+    {"pole_tide",               NCF_ROUND, NCF_I2, JS(hptide),     0,              1,   NCF_01HZ, 10., I2NaN, 1},
+    {"iono_corr_gim_ku",        NCF_ROUND, NCF_I2, JS(hiono),      0,              1,   NCF_01HZ, 10., I2NaN, 1},
+    {"model_wet_tropo_corr",    NCF_ROUND, NCF_I2, JS(hwet),       0,              1,   NCF_01HZ, 10., I2NaN, 1},
+    {"model_dry_tropo_corr",    NCF_ROUND, NCF_I2, JS(hdry),       0,              1,   NCF_01HZ, 10., I2NaN, 1},
+    {"inv_bar_corr",            NCF_ROUND, NCF_I2, JS(hinvb),      0,              1,   NCF_01HZ, 10., I2NaN, 1},
+    {"waveforms_20hz_ku",       NCF_WAVE,  NCF_U2, JS(wave),       JS(csum),       128, NCF_20HZ, 1.,  0,     1},
+};
+#define NFIELDS (int)(sizeof (jason_fields) / sizeof (jason_fields[0]))
+
+static void finish (char *scal, size_t scalar_size, size_t k0, size_t n) {
+
+    /* number the records within the file and flag those with no time or range */
+
+    struct JASON20HZ *r;
+    size_t  k;
+
+    for (k = 0; k < n; k++) {
+        r = (struct JASON20HZ *)(scal + k * scalar_size);   /* scalar members only */
+        r->kframe = (unsigned int)(k0 + k);
+        if(r->sec2000 <= 0 || r->sec2000 == I4NaN || r->range == I4NaN) r->trackbits = 1;
+    }
+}
+
+static struct MISSION jason = {
+    "jason20hz", "jason20hz", REC_JASON, JASON20HZ_LAYOUT,
+    jason_fields, NFIELDS,
+    sizeof (struct JASON20HZ), JS(wave),
+    JS(lat), JS(lon), JS(surf_flag),
+    "time", 20, "time", "time_20hz", "time",
+    finish
+};
+
+int main (int argc, char **argv) {
+    exit (ingest_main (&jason, argc, argv));
+}
@@ -0,0 +1,157 @@
+/*  rec_passes.c
+
+ Split the record stream of one or more containers into passes: a new pass
+ starts where the latitude turns (ascending <-> descending), where time
+ jumps by more than the gap or goes backwards, and at each input file.
+ One linear pass over the records with a single record in memory, so it
+ runs at read speed on any size of archive.
+
+ Writes a table of passes to stdout, one line each:
+   file  pass  first_record  nrec  asc(1)/desc(0)/unknown(-1)  t0  t1  lat0  lat1
+ and with -d, each pass as its own container dir/<name>_<pass>_<a|d|u>.rec
+ (with index), ready for pass-level parallel processing downstream.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "rec_file.h"
+
+struct PASS {
+    long long k0, n;        /* first record in the input file, records */
+    int     asc;            /* 1 ascending, 0 descending, -1 not known yet */
+    int     ipass;
+    double  t0, t1;         /* first and last valid time */
+    int     lat0, lat1;     /* first and last valid latitude, 1e-6 deg */
+    int     nvalid;
+    FILE    *fp;            /* -d output */
+    char    name[1024];
+};
+
+static char    *outdir = NULL;
+
+static int pass_open (struct PASS *p, struct REC_HEAD *h, char *fname) {
+
+    /* Start the -d output container for pass p */
+
+    char    *base, *dot;
+    size_t  len;
+
+    if (outdir == NULL) return (0);
+    base = strrchr (fname, '/');
+    base = (base == NULL) ? fname : base + 1;
+    if (!strcmp (fname, "-")) base = "stdin";
+    dot = strrchr (base, '.');
+    len = (dot == NULL) ? strlen (base) : (size_t)(dot - base);
+    if (len > 512) len = 512;
+    sprintf (p->name, "%.400s/%.*s_%05d.rec", outdir, (int)len, base, p->ipass);
+    if ((p->fp = fopen (p->name, "w+b")) == NULL) {
+        fprintf (stderr, "Failed to open %s\n", p->name);
+        return (1);
+    }
+    return (rec_write_head (p->fp, h));
+}
+
+static int pass_close (struct PASS *p, char *fname) {
+
+    /* Report pass p, and finish its container, renamed for its direction */
+
+    char    idx[1040], final[1032];
+    int     err = 0;
+
+    if (p->n == 0) return (0);
+    printf ("%s %d %lld %lld %d %.6f %.6f %.6f %.6f\n", fname, p->ipass, p->k0, p->n, p->asc,
+        p->t0, p->t1, 1.e-6 * p->lat0, 1.e-6 * p->lat1);
+    if (p->fp == NULL) return (0);
+    sprintf (final, "%.*s_%c.rec", (int)(strlen (p->name) - 4), p->name, (p->asc == 1) ? 'a' : (p->asc == 0) ? 'd' : 'u');
+    sprintf (idx, "%s.idx", final);
+    err = rec_finish (p->fp, idx);
+    if (fclose (p->fp) || err || rename (p->name, final)) {
+        fprintf (stderr, "Failed to write %s\n", final);
+        err = 1;
+    }
+    p->fp = NULL;
+    return (err);
+}
+
+int main (int argc, char **argv) {
+
+    struct REC_HEAD h;
+    struct PASS p;
+    struct REC_CUT cut;
+    FILE    *fp;
+    char    *rec = NULL;
+    long long k;
+    double  gap = 2.0;
+    int     c, r, bad = 0, npass = 0, nfail = 0;
+
+    while ((c = getopt (argc, argv, "g:d:")) != -1) {
+        switch (c) {
+            case 'g':   /* seconds without data that end a pass */
+                gap = atof (optarg);
+                break;
+            case 'd':   /* one container per pass in this directory */
+                outdir = optarg;
+                break;
+            default:
+                bad = 1;
+                break;
+        }
+    }
+    if (bad || optind >= argc) {
+        fprintf (stderr, "usage: rec_passes [-g gap_seconds] [-d directory] file1.rec file2.rec ... > pass_table\n");
+        fprintf (stderr, "\t-g  a time gap longer than this ends a pass (default 2 s)\n");
+        fprintf (stderr, "\t-d  also write each pass as directory/<file>_<pass>_<a|d|u>.rec\n");
+        fprintf (stderr, "\tUse - to read a container from stdin.\n");
+        exit (EXIT_FAILURE);
+    }
+
+    for (; optind < argc; optind++) {
+        if ((fp = rec_stream (argv[optind], &h, REC_ANY, 0, 0)) == NULL) {
+            nfail++;
+            continue;
+        }
+        free ( (void *)rec);
+        if ((rec = (char *) malloc (h.recsize)) == NULL) {
+            fprintf (stderr, "Failed to malloc record buffer\n");
+            exit (EXIT_FAILURE);
+        }
+        memset (&p, 0, sizeof (p));
+        memset (&cut, 0, sizeof (cut));
+        p.asc = -1;
+        for (k = 0; rec_get (fp, &h, rec, 1) == 1; k++) {
+            if ((r = rec_cut (&cut, &h, rec, gap)) >= 0) {
+                if (r == 1) {
+                    nfail += pass_close (&p, argv[optind]);
+                    p.ipass++;
+                    p.k0 = k;
+                    p.n = 0;
+                    p.nvalid = 0;
+                }
+                if (p.nvalid == 0) {
+                    p.t0 = cut.t;
+                    p.lat0 = cut.lat;
+                }
+                p.asc = cut.asc;
+                p.t1 = cut.t;
+                p.lat1 = cut.lat;
+                p.nvalid++;
+            }
+            if (p.n == 0 && pass_open (&p, &h, argv[optind])) exit (EXIT_FAILURE);
+            if (p.fp != NULL && rec_put (p.fp, &h, rec, 1) != 1) {
+                fprintf (stderr, "Failure writing %s\n", p.name);
+                exit (EXIT_FAILURE);
+            }
+            p.n++;
+        }
+        nfail += pass_close (&p, argv[optind]);
+        npass += p.ipass + (p.n > 0);
+        if (fp != stdin) fclose (fp);
+    }
+    free ( (void *)rec);
+    fprintf (stderr, "rec_passes found %d passes.\n", npass);
+    exit ((nfail) ? EXIT_FAILURE : EXIT_SUCCESS);
+}
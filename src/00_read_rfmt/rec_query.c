@@ -0,0 +1,142 @@
+/*  rec_query.c
+
+ Pull the records of one region, time span or surface type out of record
+ containers written by the stage 00 readers with -o.  The block index
+ (file.rec.idx) is read first, and only blocks that can match are touched
+ in the mapped container, so a small region costs a small fraction of the
+ file instead of a full scan.  A container with compressed waveforms
+ (REC_ZWAVE) cannot be mapped and is read through in order instead, still
+ matching record by record only inside the blocks that can match.  Thin
+ containers (REC_THIN) are mapped at their own stride, and their records
+ come out whole, with the waveform zeroed, like those of any other.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "rec_file.h"
+#include "rec_index.h"
+
+static size_t query_stream (FILE *fp, struct REC_HEAD *h, struct REC_BLOCK *b, struct REC_INDEX *ih, struct REC_QUERY *q, size_t *nhit) {
+
+    /* The blocks of an open stream that match q, to stdout; returns records written */
+
+    char    *buf;
+    size_t  k, n, n_out = 0;
+    unsigned int i;
+
+    if ((buf = (char *) malloc ((size_t)ih->block * h->recsize)) == NULL) {
+        fprintf (stderr, "Failed to malloc block buffer\n");
+        exit (EXIT_FAILURE);
+    }
+    for (i = 0; i < ih->nblock && (n = rec_get (fp, h, buf, ih->block)) > 0; i++) {
+        if (!rec_block_match (&b[i], q)) continue;
+        (*nhit)++;
+        for (k = 0; k < n; k++) {
+            if (!rec_match (buf + k * h->recsize, &ih->keys, q)) continue;
+            if (fwrite (buf + k * h->recsize, h->recsize, 1, stdout) != 1) {
+                fprintf (stderr, "Failure writing output\n");
+                exit (EXIT_FAILURE);
+            }
+            n_out++;
+        }
+    }
+    free ( (void *)buf);
+    return (n_out);
+}
+
+int main (int argc, char **argv) {
+
+    struct REC_QUERY q;
+    struct REC_FILE rf;
+    struct REC_INDEX ih;
+    struct REC_BLOCK *b;
+    struct REC_HEAD h;
+    FILE    *fp;
+    char    *idxname, *s, *zero;
+    size_t  k, k1, n_out = 0, nhit = 0;
+    unsigned int i, recsize = 0;
+    int     c, f, verbose = 0, bad = 0;
+
+    memset (&q, 0, sizeof (q));
+    while ((c = getopt (argc, argv, "T:R:s:v")) != -1) {
+        switch (c) {
+            case 'T':   /* t0/t1, seconds since 2000 */
+                q.use_t = 1;
+                if (sscanf (optarg, "%lf/%lf", &q.t0, &q.t1) != 2) bad = 1;
+                break;
+            case 'R':   /* west/east/south/north, degrees */
+                q.use_r = 1;
+                if (sscanf (optarg, "%lf/%lf/%lf/%lf", &q.west, &q.east, &q.south, &q.north) != 4) bad = 1;
+                break;
+            case 's':   /* accepted surface flags */
+                for (s = strtok (optarg, ","); s != NULL; s = strtok (NULL, ",")) {
+                    f = atoi (s);
+                    if (f < 0 || f >= REC_NSURF) bad = 1;
+                    else q.surf |= 1u << f;
+                }
+                break;
+            case 'v':
+                verbose = 1;
+                break;
+            default:
+                bad = 1;
+                break;
+        }
+    }
+    if (bad || optind >= argc) {
+        fprintf (stderr, "usage: rec_query [-T t0/t1] [-R west/east/south/north] [-s flag1,flag2,...] [-v] file1.rec file2.rec ... > output_binary_structures\n");
+        fprintf (stderr, "\t-T  keep records timed t0 to t1, seconds since 2000\n");
+        fprintf (stderr, "\t-R  keep records inside the region, degrees; west > east wraps through 0\n");
+        fprintf (stderr, "\t-s  keep records with these surface flags (0 ocean, 1 closed sea, 2 continental ice, 3 land)\n");
+        fprintf (stderr, "\t-v  report blocks touched per file\n");
+        fprintf (stderr, "\tEach file.rec needs the file.rec.idx its reader wrote beside it.\n");
+        exit (EXIT_FAILURE);
+    }
+
+    for (; optind < argc; optind++) {
+        if ((fp = rec_stream (argv[optind], &h, REC_ANY, recsize, 0)) == NULL) exit (EXIT_FAILURE);
+        recsize = h.recsize;        /* later files must match the first */
+        if ((idxname = (char *) malloc (strlen (argv[optind]) + 5)) == NULL) exit (EXIT_FAILURE);
+        sprintf (idxname, "%s.idx", argv[optind]);
+        if ((b = rec_index_read (idxname, &h, &ih)) == NULL) exit (EXIT_FAILURE);
+        nhit = 0;
+        if (h.flags & REC_ZWAVE) {
+            n_out += query_stream (fp, &h, b, &ih, &q, &nhit);
+            if (fp != stdin) fclose (fp);
+            if (verbose) fprintf (stderr, "%s: matched %zu of %u blocks\n", argv[optind], nhit, ih.nblock);
+            free ( (void *)b);
+            free ( (void *)idxname);
+            continue;
+        }
+        if (fp != stdin) fclose (fp);
+        if (rec_open (&rf, argv[optind], REC_ANY, recsize, 0)) exit (EXIT_FAILURE);
+        if ((zero = (char *) calloc (recsize, 1)) == NULL) exit (EXIT_FAILURE);
+
+        for (i = 0; i < ih.nblock; i++) {
+            if (!rec_block_match (&b[i], &q)) continue;
+            nhit++;
+            k1 = (size_t)(i + 1) * ih.block;
+            if (k1 > (size_t)rf.h.nrec) k1 = (size_t)rf.h.nrec;
+            for (k = (size_t)i * ih.block; k < k1; k++) {
+                if (!rec_match (rf.rec + k * rf.stride, &ih.keys, &q)) continue;
+                if (fwrite (rf.rec + k * rf.stride, rf.stride, 1, stdout) != 1
+                    || (rf.stride < recsize && fwrite (zero, recsize - rf.stride, 1, stdout) != 1)) {
+                    fprintf (stderr, "Failure writing output for file %s\n", argv[optind]);
+                    exit (EXIT_FAILURE);
+                }
+                n_out++;
+            }
+        }
+        if (verbose) fprintf (stderr, "%s: read %zu of %u blocks\n", argv[optind], nhit, ih.nblock);
+        free ( (void *)b);
+        free ( (void *)idxname);
+        free ( (void *)zero);
+        rec_close (&rf);
+    }
+    fprintf (stderr, "rec_query wrote %zu records to stdout.\n", n_out);
+    exit (EXIT_SUCCESS);
+}
@@ -0,0 +1,65 @@
+/*  s3ab20hz.c
+
+ For reading Sentinel-3A/B SRAL L2 enhanced_measurement.nc files and dumping
+ the 20Hz values we want as compact 60-byte struct S3AB20HZ records.
+ Same command line as cryosat20hz; there is no waveform, so -z and -t
+ do not apply.
+ */
+
+#include "s3ab20hz.h"
+#include "ingest.h"
+#include "rec_file.h"
+
+/* L2 SRAL schema: NetCDF variable -> struct S3AB20HZ member.  Heights are
+   repacked onto the struct's 0.1 mm grid (700 km offset for alt and range,
+   see s3ab20hz.h) from each variable's own scale_factor and add_offset, which
+   is a plain copy when the file already uses that packing.  Nonzero quality
+   flags set their bit in flagbits. */
+#define S3(m) offsetof(struct S3AB20HZ, m)
+static struct NC_FIELD s3ab_fields[] = {
+    /* name                      conv       type    offset            offset2       count rate     scale  nan    use bit base */
+    {"time_20_ku",              NCF_TIME,  NCF_I4, S3(utcsec2000),   S3(microsec), 1,   NCF_20HZ, 1.,    I4NaN, 1,  0,  0.},
+    {"lon_20_ku",               NCF_COPY,  NCF_I4, S3(lon_20_ku),    0,            1,   NCF_20HZ, 1.,    I4NaN, 1,  0,  0.},
+    {"lat_20_ku",               NCF_COPY,  NCF_I4, S3(lat_20_ku),    0,            1,   NCF_20HZ, 1.,    I4NaN, 1,  0,  0.},
+    {"alt_20_ku",               NCF_PACK,  NCF_I4, S3(alt_20_ku),    0,            1,   NCF_20HZ, 1.e-4, I4NaN, 1,  0,  700000.},
+    {"range_ocean_20_ku",       NCF_PACK,  NCF_I4, S3(range_ocean_20_ku), 0,       1,   NCF_20HZ, 1.e-4, I4NaN, 1,  0,  700000.},
+    {"range_ocog_20_ku",        NCF_PACK,  NCF_I4, S3(range_ocog_20_ku),  0,       1,   NCF_20HZ, 1.e-4, I4NaN, 1,  0,  700000.},
+    {"mean_sea_surf_sol1_20_ku",NCF_PACK,  NCF_I4, S3(mss),          0,            1,   NCF_20HZ, 1.e-4, I4NaN, 1,  0,  0.},
+    {"mqe_ocean_20_ku",         NCF_COPY,  NCF_I4, S3(mqe),          0,            1,   NCF_20HZ, 1.,    I4NaN, 1,  0,  0.},
+    {"range_ocean_qual_20_ku",  NCF_FLAG,  NCF_I4, S3(flagbits),     0,            1,   NCF_20HZ, 1.,    0,     1,  1,  0.},
+    {"sig0_ocean_qual_20_ku",   NCF_FLAG,  NCF_I4, S3(flagbits),     0,            1,   NCF_20HZ, 1.,    0,     1,  2,  0.},
+    {"swh_ocean_qual_20_ku",    NCF_FLAG,  NCF_I4, S3(flagbits),     0,            1,   NCF_20HZ, 1.,    0,     1,  4,  0.},
+    {"surf_type_01",            NCF_COPY,  NCF_I2, S3(surf_type_1),  0,            1,   NCF_01FLAG, 1.,  0,     1,  0,  0.},
+    {"surf_class_20_ku",        NCF_COPY,  NCF_I2, S3(surf_type_2),  0,            1,   NCF_20HZ, 1.,    0,     1,  0,  0.},
+    {"orb_alt_rate_20_ku",      NCF_PACK,  NCF_I2, S3(alt_rate),     0,            1,   NCF_20HZ, 0.01,  I2NaN, 1,  0,  0.},
+    {"swh_ocean_20_ku",         NCF_PACK,  NCF_I2, S3(swh),          0,            1,   NCF_20HZ, 0.001, I2NaN, 1,  0,  0.},
+    {"sig0_ocean_20_ku",        NCF_PACK,  NCF_I2, S3(sig0),         0,            1,   NCF_20HZ, 0.01,  I2NaN, 1,  0,  0.},
+};
+#define NFIELDS (int)(sizeof (s3ab_fields) / sizeof (s3ab_fields[0]))
+
+static void finish (char *scal, size_t scalar_size, size_t k0, size_t n) {
+
+    /* number the records within the file; a missing ocean range is as bad as a flagged one */
+
+    struct S3AB20HZ *r;
+    size_t  k;
+
+    for (k = 0; k < n; k++) {
+        r = (struct S3AB20HZ *)(scal + k * scalar_size);
+        r->krecord = (int)(k0 + k);
+        if (r->range_ocean_20_ku == I4NaN) r->flagbits |= 1;
+    }
+}
+
+static struct MISSION s3ab = {
+    "s3ab20hz", "s3ab20hz", REC_S3AB, S3AB20HZ_LAYOUT,
+    s3ab_fields, NFIELDS,
+    sizeof (struct S3AB20HZ), sizeof (struct S3AB20HZ),
+    S3(lat_20_ku), S3(lon_20_ku), S3(surf_type_1),
+    "time_20_ku", 1, "time_01", "time_20_ku", "time_01",
+    finish
+};
+
+int main (int argc, char **argv) {
+    exit (ingest_main (&s3ab, argc, argv));
+}
@@ -0,0 +1,546 @@
+/*  retrack.c
+
+ Stage 01: fit a Brown-type model (brown.h) to the waveform of every record
+ in one or more record containers written by the stage 00 readers, and fill
+ the retracker members of the record:
+
+   drange[0]  leading edge offset from the tracking gate, mm
+   pswh[0]    significant wave height from the leading edge width, mm
+   pamp[0]    plateau amplitude, counts
+   pnoise[0]  noise floor, counts
+   rchisq[0]  rms misfit of the fit, counts
+   decay[0]   plateau decay, 1e-4 per gate
+
+ Records that are empty (trackbits 1) or have no power are passed through
+ untouched.  A fit that fails sets trackbits 8192; a drange that does not
+ fit in a short sets trackbits 2048.  The second fit of -2 has bits of its
+ own, 8 and 4, so that a record keeps its first fit when only the second
+ one fails.
+
+ Records are read in batches and the batch is split across threads; the
+ fits share nothing, so the work scales with the cores and the output is
+ in input order.  Threads are safe here because we never call netcdf.
+
+ With -2 each file is retracked twice, and the second fit goes in the [1]
+ slots.  The second pass holds the leading edge width (so pswh) at the
+ along-track boxcar mean of the first-pass widths, which takes out most of
+ the range noise that the free width trades with the epoch.  It starts
+ each fit from the first-pass solution, so it needs only a few iterations
+ of a four-parameter fit.  The mean never reaches across a pass (split as
+ rec_passes does).  The records still stream through in batches: each
+ batch gets its first fits, and a record gets its second fit and is
+ written once the window after it is fitted or its pass has ended, so
+ only a batch and a window either side are held however long the file.
+
+ The model is evaluated by one of the kernels in brown_kernels.h, chosen
+ with -k: ref (libm), double, or float, the fastest.  A fast kernel is first
+ checked against ref and refused if its model error exceeds BROWN_KTOL.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include "cryosat20hz.h"
+#include "jason20hz.h"
+#include "altika40hz.h"
+#include "rec_file.h"
+#include "brown.h"
+#include "brown_kernels.h"
+
+#define BATCH       4096        /* records per batch */
+#define GAP         2.0         /* seconds without data that end a pass (-2) */
+#define MAXTHREAD   256
+#define SIGMA_PTR   0.513       /* point target response width, gates */
+
+/* trackbits of each slot: the fit failed, drange[slot] out of bounds */
+static unsigned int failbit[2] = {8192, 8};
+static unsigned int rangebit[2] = {2048, 4};
+
+/* Where a mission keeps its waveform and retracker members, and its gates */
+struct TRACKER {
+    unsigned int mission, layout;
+    size_t  recsize;
+    size_t  trackbits, csum, pamp, pswh, rchisq, pnoise, drange, decay, wave;
+    int     ngate;          /* gates fitted, from wave[0] */
+    double  track;          /* gate at the tracker's range */
+    double  spacing;        /* gate spacing, m */
+};
+
+#define TRK(S) sizeof (struct S), offsetof (struct S, trackbits), offsetof (struct S, csum), \
+    offsetof (struct S, pamp), offsetof (struct S, pswh), offsetof (struct S, rchisq), \
+    offsetof (struct S, pnoise), offsetof (struct S, drange), offsetof (struct S, decay), offsetof (struct S, wave)
+
+static struct TRACKER trackers[] = {
+    {REC_CRYOSAT, CRYOSAT20HZ_LAYOUT, TRK(CRYOSAT20HZ), 128, 64., 0.4684},  /* 320 MHz */
+    {REC_JASON,   JASON20HZ_LAYOUT,   TRK(JASON20HZ),   104, 32., 0.4684},  /* 320 MHz */
+    {REC_ALTIKA,  SARAL40HZ_LAYOUT,   TRK(SARAL40HZ),   128, 51., 0.3123},  /* 480 MHz */
+};
+#define NTRACKERS (int)(sizeof (trackers) / sizeof (trackers[0]))
+
+struct WORK {
+    struct TRACKER *t;
+    char    *rec;
+    size_t  n;
+    size_t  nfit, nfail;
+};
+
+/* -2: the records of one file streamed through a window.  The front
+   nctx records are written already and kept only for their first-pass
+   widths; the rest await their second fit or are the batch just read. */
+struct HOLD {
+    struct TRACKER *t;
+    char    *rec;
+    double  *p;                 /* first-pass fit of each, BROWN_NPAR a record */
+    char    *ok;                /* 1 fitted, 0 failed, -1 not retracked */
+    int     *seg;               /* pass number, so windows stay within a pass */
+    size_t  n, nctx, cap;
+    int     half;               /* smoothing half width, records */
+    size_t  nfit[2], nfail[2], niter[2];
+};
+
+/* -2: one thread's share of a fit over records k0 to k1-1 */
+struct SLICE {
+    struct HOLD *q;
+    size_t  k0, k1;
+    int     fit;                /* 0 first, 1 second */
+    size_t  nfit, nfail, niter;
+};
+
+static unsigned short clip_u2 (double x) {
+    return ((x <= 0.) ? 0 : (x >= 65535.) ? 65535 : (unsigned short)floor (x + 0.5));
+}
+
+static int skip_record (struct TRACKER *t, char *rec) {
+
+    /* Empty records and records with no power are not retracked */
+
+    unsigned int bits, csum;
+
+    memcpy (&bits, rec + t->trackbits, sizeof (bits));
+    memcpy (&csum, rec + t->csum, sizeof (csum));
+    return ((bits & 1) || csum == 0);
+}
+
+static void set_bits (struct TRACKER *t, char *rec, unsigned int set) {
+
+    unsigned int bits;
+
+    memcpy (&bits, rec + t->trackbits, sizeof (bits));
+    bits |= set;
+    memcpy (rec + t->trackbits, &bits, sizeof (bits));
+}
+
+static void store_fit (struct TRACKER *t, char *rec, int slot, double *p, struct BROWN_STAT *st) {
+
+    /* Put fit p into the retracker members' [slot] */
+
+    unsigned short u2;
+    double  x, sig2;
+    short   i2;
+    int     i4;
+
+    x = floor (1000. * t->spacing * (p[BROWN_T0] - t->track) + 0.5);
+    if (fabs (x) > 32767.) {
+        set_bits (t, rec, rangebit[slot]);
+        x = (x > 0.) ? 32767. : -32767.;
+    }
+    i2 = (short)x;
+    memcpy (rec + t->drange + slot * sizeof (i2), &i2, sizeof (i2));
+    /* SWH = 4 x the leading edge width in range, after removing the PTR */
+    sig2 = p[BROWN_SIGMA] * p[BROWN_SIGMA] - SIGMA_PTR * SIGMA_PTR;
+    u2 = clip_u2 (4000. * t->spacing * ((sig2 > 0.) ? sqrt (sig2) : 0.));
+    memcpy (rec + t->pswh + slot * sizeof (u2), &u2, sizeof (u2));
+    i4 = (int)floor (p[BROWN_AMP] + 0.5);
+    memcpy (rec + t->pamp + slot * sizeof (i4), &i4, sizeof (i4));
+    u2 = clip_u2 (p[BROWN_NOISE]);
+    memcpy (rec + t->pnoise + slot * sizeof (u2), &u2, sizeof (u2));
+    u2 = clip_u2 (st->rms);
+    memcpy (rec + t->rchisq + slot * sizeof (u2), &u2, sizeof (u2));
+    i2 = (short)floor (1.e4 * p[BROWN_DECAY] + 0.5);
+    memcpy (rec + t->decay + slot * sizeof (i2), &i2, sizeof (i2));
+}
+
+static int fit_record (struct TRACKER *t, char *rec, int slot, double *p, int free, struct BROWN_STAT *st) {
+
+    /* Fit the record's waveform from start p, holding the parameters not
+       in free, and store the result in [slot].  Returns 0, or 1 if the fit
+       failed (and failbit[slot] is set in trackbits). */
+
+    unsigned short wave[128];
+
+    memcpy (wave, rec + t->wave, t->ngate * sizeof (wave[0]));
+    if (brown_fit (wave, t->ngate, p, free, st)) {
+        set_bits (t, rec, failbit[slot]);
+        return (1);
+    }
+    store_fit (t, rec, slot, p, st);
+    return (0);
+}
+
+static void *retrack_work (void *arg) {
+
+    struct WORK *w = (struct WORK *)arg;
+    struct BROWN_STAT st;
+    unsigned short wave[128];
+    double  p[BROWN_NPAR];
+    char    *rec;
+    size_t  k;
+
+    for (k = 0; k < w->n; k++) {
+        rec = w->rec + k * w->t->recsize;
+        if (skip_record (w->t, rec)) continue;
+        memcpy (wave, rec + w->t->wave, w->t->ngate * sizeof (wave[0]));
+        brown_guess (wave, w->t->ngate, p);
+        w->nfit++;
+        w->nfail += fit_record (w->t, rec, 0, p, BROWN_ALL, &st);
+    }
+    return (NULL);
+}
+
+static int retrack_batch (struct TRACKER *t, char *buf, size_t n, int nthread, size_t *nfit, size_t *nfail) {
+
+    /* Retrack n records in buf with nthread threads, in contiguous slices */
+
+    pthread_t tid[MAXTHREAD];
+    struct WORK w[MAXTHREAD];
+    size_t  k0, k1;
+    int     i, err = 0;
+
+    for (i = 0; i < nthread; i++) {
+        k0 = n * i / nthread;
+        k1 = n * (i + 1) / nthread;
+        w[i].t = t;
+        w[i].rec = buf + k0 * t->recsize;
+        w[i].n = k1 - k0;
+        w[i].nfit = w[i].nfail = 0;
+        if (i > 0 && pthread_create (&tid[i], NULL, retrack_work, &w[i])) {
+            fprintf (stderr, "Failed to start retracking thread\n");
+            nthread = i;
+            err = 1;
+            break;
+        }
+    }
+    if (!err) retrack_work (&w[0]);     /* slice 0 on this thread */
+    for (i = 1; i < nthread; i++) pthread_join (tid[i], NULL);
+    for (i = 0; i < nthread; i++) {
+        *nfit += w[i].nfit;
+        *nfail += w[i].nfail;
+    }
+    return (err);
+}
+
+static void first_fit (struct SLICE *w) {
+
+    /* Free fits, the start of the second fit and its width */
+
+    struct HOLD *q = w->q;
+    struct TRACKER *t = q->t;
+    struct BROWN_STAT st;
+    unsigned short wave[128];
+    double  *pk;
+    char    *rec;
+    size_t  k;
+
+    for (k = w->k0; k < w->k1; k++) {
+        rec = q->rec + k * t->recsize;
+        pk = q->p + k * BROWN_NPAR;
+        if (skip_record (t, rec)) {
+            q->ok[k] = -1;
+            continue;
+        }
+        memcpy (wave, rec + t->wave, t->ngate * sizeof (wave[0]));
+        brown_guess (wave, t->ngate, pk);
+        q->ok[k] = !fit_record (t, rec, 0, pk, BROWN_ALL, &st);
+        w->nfit++;
+        w->nfail += !q->ok[k];
+        w->niter += st.iter;
+        if (!q->ok[k]) brown_guess (wave, t->ngate, pk);  /* the second fit starts afresh */
+    }
+}
+
+static void second_fit (struct SLICE *w) {
+
+    /* Fits with the width held at the mean of the good first-pass widths
+       within half records either side in the same pass.  The window is
+       summed afresh for each record, so the result does not depend on
+       where the threads or batches split the records. */
+
+    struct HOLD *q = w->q;
+    struct TRACKER *t = q->t;
+    struct BROWN_STAT st;
+    double  p[BROWN_NPAR], sum;
+    char    *rec;
+    size_t  k, j, j1;
+    int     cnt;
+
+    for (k = w->k0; k < w->k1; k++) {
+        if (q->ok[k] < 0) continue;
+        rec = q->rec + k * t->recsize;
+        j = (k > (size_t)q->half) ? k - q->half : 0;
+        j1 = (k + q->half < q->n) ? k + q->half + 1 : q->n;
+        for (sum = 0., cnt = 0; j < j1; j++) if (q->ok[j] == 1 && q->seg[j] == q->seg[k]) {
+            sum += q->p[j*BROWN_NPAR+BROWN_SIGMA];
+            cnt++;
+        }
+        w->nfit++;
+        if (cnt == 0) {     /* nothing good nearby to hold it at */
+            set_bits (t, rec, failbit[1]);
+            w->nfail++;
+            continue;
+        }
+        memcpy (p, q->p + k * BROWN_NPAR, sizeof (p));
+        p[BROWN_SIGMA] = sum / cnt;
+        w->nfail += fit_record (t, rec, 1, p, BROWN_ALL & ~(1 << BROWN_SIGMA), &st);
+        w->niter += st.iter;
+    }
+}
+
+static void *slice_work (void *arg) {
+
+    struct SLICE *w = (struct SLICE *)arg;
+
+    if (w->fit == 0) first_fit (w);
+    else second_fit (w);
+    return (NULL);
+}
+
+static int hold_fit (struct HOLD *q, int fit, size_t k0, size_t k1, int nthread) {
+
+    /* One fit of records k0 to k1-1 of the window, in contiguous slices */
+
+    pthread_t tid[MAXTHREAD];
+    struct SLICE w[MAXTHREAD];
+    int     i, err = 0;
+
+    for (i = 0; i < nthread; i++) {
+        w[i].q = q;
+        w[i].fit = fit;
+        w[i].k0 = k0 + (k1 - k0) * i / nthread;
+        w[i].k1 = k0 + (k1 - k0) * (i + 1) / nthread;
+        w[i].nfit = w[i].nfail = w[i].niter = 0;
+        if (i > 0 && pthread_create (&tid[i], NULL, slice_work, &w[i])) {
+            fprintf (stderr, "Failed to start retracking thread\n");
+            nthread = i;
+            err = 1;
+            break;
+        }
+    }
+    if (!err) slice_work (&w[0]);
+    for (i = 1; i < nthread; i++) pthread_join (tid[i], NULL);
+    for (i = 0; i < nthread; i++) {
+        q->nfit[fit] += w[i].nfit;
+        q->nfail[fit] += w[i].nfail;
+        q->niter[fit] += w[i].niter;
+    }
+    return (err);
+}
+
+static int retrack_stream (struct HOLD *q, FILE *fp, struct REC_HEAD *h, struct REC_HEAD *h0, int nthread, size_t *nrec) {
+
+    /* -2: retrack one file a batch at a time.  A record gets its second fit
+       and is written once the records up to half after it have their first
+       fit or its pass has ended; then all but the last half records written
+       and those still waiting are dropped from the window. */
+
+    struct TRACKER *t = q->t;
+    struct REC_CUT cut;
+    size_t  k, m, n, r, c;
+    int     seg = 0, end = 0;
+
+    memset (&cut, 0, sizeof (cut));
+    q->n = q->nctx = 0;
+    while (!end) {
+        m = rec_get (fp, h, q->rec + q->n * t->recsize, q->cap - q->n);
+        end = (m == 0);
+        for (k = q->n; k < q->n + m; k++) {
+            if (rec_cut (&cut, h, q->rec + k * t->recsize, GAP) == 1) seg++;
+            q->seg[k] = seg;
+        }
+        if (m > 0 && hold_fit (q, 0, q->n, q->n + m, nthread)) return (1);
+        n = q->n += m;
+
+        /* records before r have everything their window needs */
+        r = n;
+        if (!end) {
+            while (r > 0 && q->seg[r-1] == q->seg[n-1]) r--;
+            if (n - r > (size_t)q->half) r = n - q->half;
+            if (r < q->nctx) r = q->nctx;
+        }
+        if (r > q->nctx && hold_fit (q, 1, q->nctx, r, nthread)) return (1);
+        if (r > q->nctx && rec_put (stdout, h0, q->rec + q->nctx * t->recsize, r - q->nctx) != r - q->nctx) {
+            fprintf (stderr, "Failure writing records\n");
+            return (1);
+        }
+        *nrec += r - q->nctx;
+
+        c = (r > (size_t)q->half) ? r - q->half : 0;
+        memmove (q->rec, q->rec + c * t->recsize, (n - c) * t->recsize);
+        memmove (q->p, q->p + c * BROWN_NPAR, (n - c) * BROWN_NPAR * sizeof (double));
+        memmove (q->ok, q->ok + c, n - c);
+        memmove (q->seg, q->seg + c, (n - c) * sizeof (int));
+        q->n = n - c;
+        q->nctx = r - c;
+    }
+    return (0);
+}
+
+int main (int argc, char **argv) {
+
+    struct REC_HEAD h, h0;
+    struct TRACKER *t = NULL;
+    struct HOLD q;
+    struct timespec c0, c1;
+    FILE    *fp;
+    char    *buf = NULL, *ofile = NULL, *idxname;
+    size_t  n, nrec = 0, nfit = 0, nfail = 0;
+    double  secs;
+    double  merr, jerr;
+    int     c, i, bad = 0, nfile = 0, nthread, twopass = 0, thin = 0, kern;
+
+    memset (&q, 0, sizeof (q));
+    q.half = 20;
+    nthread = (int)sysconf (_SC_NPROCESSORS_ONLN);
+    kern = brown_kernel ();
+    while ((c = getopt (argc, argv, "2j:k:o:tw:")) != -1) {
+        switch (c) {
+            case 'k':   /* model kernel */
+                for (kern = BROWN_REF; kern <= BROWN_FLOAT && strcmp (optarg, brown_kernel_name (kern)); kern++);
+                if (kern > BROWN_FLOAT) bad = 1;
+                break;
+            case '2':   /* second fit with the width held at its along-track mean */
+                twopass = 1;
+                break;
+            case 'w':   /* smoothing window, records */
+                q.half = atoi (optarg) / 2;
+                break;
+            case 'j':   /* threads */
+                nthread = atoi (optarg);
+                break;
+            case 'o':   /* write a container rather than raw records to stdout */
+                ofile = optarg;
+                break;
+            case 't':   /* thin container */
+                thin = 1;
+                break;
+            default:
+                bad = 1;
+                break;
+        }
+    }
+    if (bad || optind >= argc || (thin && ofile == NULL)) {
+        fprintf (stderr, "usage: retrack [-2] [-w window] [-j nthreads] [-k ref|double|float] [-o out.rec [-t]] file1.rec file2.rec ... > output\n");
+        fprintf (stderr, "\t-2  retrack again with pswh held at its along-track mean, into the [1] slots\n");
+        fprintf (stderr, "\t-w  -2 smoothing window, records (default 41)\n");
+        fprintf (stderr, "\t-j  retrack with this many threads (default one per online CPU)\n");
+        fprintf (stderr, "\t-k  model kernel: ref (libm erf), double (default) or float (fastest, about 1e-6 of amplitude)\n");
+        fprintf (stderr, "\t-o  write a record container (with out.rec.idx) instead of raw records to stdout\n");
+        fprintf (stderr, "\t-t  with -o, write thin records without the waveforms once they are retracked\n");
+        fprintf (stderr, "\tInputs are containers from the stage 00 readers (cryosat20hz, jason20hz, altika40hz -o);\n");
+        fprintf (stderr, "\tall must be of the same mission.  Use - to read a container from stdin.\n");
+        exit (EXIT_FAILURE);
+    }
+    if (nthread < 1) nthread = 1;
+    if (nthread > MAXTHREAD) nthread = MAXTHREAD;
+    if (q.half < 0) q.half = 0;
+    if (kern != BROWN_REF) {
+        merr = brown_kernel_check (kern, &jerr);
+        if (!(merr <= BROWN_KTOL)) {
+            fprintf (stderr, "retrack: %s kernel (%s) is off by %.2g of amplitude; using ref\n",
+                brown_kernel_name (kern), brown_kernel_isa (kern), merr);
+            kern = BROWN_REF;
+        }
+        else fprintf (stderr, "retrack: %s kernel (%s), model within %.2g of amplitude and Jacobian within %.2g of ref\n",
+            brown_kernel_name (kern), brown_kernel_isa (kern), merr, jerr);
+    }
+    brown_set_kernel (kern);
+    clock_gettime (CLOCK_MONOTONIC, &c0);
+
+    for (; optind < argc; optind++) {
+        if ((fp = rec_stream (argv[optind], &h, (t == NULL) ? REC_ANY : t->mission,
+            (t == NULL) ? 0 : t->recsize, (t == NULL) ? 0 : t->layout)) == NULL) exit (EXIT_FAILURE);
+        if (h.flags & REC_THIN) {
+            fprintf (stderr, "Failed: %s holds thin records, without waveforms to retrack\n", argv[optind]);
+            exit (EXIT_FAILURE);
+        }
+        if (t == NULL) {
+            for (i = 0; i < NTRACKERS && trackers[i].mission != h.mission; i++);
+            if (i == NTRACKERS || trackers[i].layout != h.layout || trackers[i].recsize != h.recsize) {
+                fprintf (stderr, "Failed: retrack does not know the records in %s (mission %u, layout %08x)\n",
+                    argv[optind], h.mission, h.layout);
+                exit (EXIT_FAILURE);
+            }
+            t = &trackers[i];
+            h0 = h;
+            h0.flags = (h.flags & REC_STORE) | REC_FIT1 | ((twopass) ? REC_FIT2 : 0);
+            if (ofile == NULL) h0.flags = 0;    /* raw records to stdout are never compressed */
+            if (thin) h0.flags = REC_THIN | (h0.flags & ~REC_STORE);
+            if ((buf = (char *) malloc (BATCH * t->recsize)) == NULL) {
+                fprintf (stderr, "Failed to malloc record buffer\n");
+                exit (EXIT_FAILURE);
+            }
+            if (twopass) {      /* a batch and a window either side */
+                q.t = t;
+                q.cap = BATCH + 2 * (size_t)q.half;
+                q.rec = (char *) malloc (q.cap * t->recsize);
+                q.p = (double *) malloc (q.cap * BROWN_NPAR * sizeof (double));
+                q.ok = (char *) malloc (q.cap);
+                q.seg = (int *) malloc (q.cap * sizeof (int));
+                if (q.rec == NULL || q.p == NULL || q.ok == NULL || q.seg == NULL) {
+                    fprintf (stderr, "Failed to malloc retracking window\n");
+                    exit (EXIT_FAILURE);
+                }
+            }
+            if (ofile != NULL) {
+                if (freopen (ofile, "w+b", stdout) == NULL) {
+                    fprintf (stderr, "Failed to open %s\n", ofile);
+                    exit (EXIT_FAILURE);
+                }
+                if (rec_write_head (stdout, &h0)) exit (EXIT_FAILURE);
+            }
+        }
+        nfile++;
+        if (twopass) {
+            if (retrack_stream (&q, fp, &h, &h0, nthread, &nrec)) exit (EXIT_FAILURE);
+        }
+        else while ((n = rec_get (fp, &h, buf, BATCH)) > 0) {
+            if (retrack_batch (t, buf, n, nthread, &nfit, &nfail)) exit (EXIT_FAILURE);
+            if (rec_put (stdout, &h0, buf, n) != n) {
+                fprintf (stderr, "Failure writing records\n");
+                exit (EXIT_FAILURE);
+            }
+            nrec += n;
+        }
+        if (fp != stdin) fclose (fp);
+    }
+
+    if (ofile != NULL) {
+        if ((idxname = (char *) malloc (strlen (ofile) + 5)) == NULL) exit (EXIT_FAILURE);
+        sprintf (idxname, "%s.idx", ofile);
+        if (rec_finish (stdout, idxname)) exit (EXIT_FAILURE);
+        free ( (void *)idxname);
+    }
+    free ( (void *)buf);
+    free ( (void *)q.rec);
+    free ( (void *)q.p);
+    free ( (void *)q.ok);
+    free ( (void *)q.seg);
+
+    clock_gettime (CLOCK_MONOTONIC, &c1);
+    secs = (c1.tv_sec - c0.tv_sec) + 1.e-9 * (c1.tv_nsec - c0.tv_nsec);
+    if (twopass) {
+        for (i = 0; i < 2; i++) fprintf (stderr, "retrack pass %d: %lu fits, %lu failed, %.1f iterations per fit.\n",
+            i + 1, (unsigned long)q.nfit[i], (unsigned long)q.nfail[i], (q.nfit[i]) ? (double)q.niter[i] / q.nfit[i] : 0.);
+        nfit = q.nfit[0] + q.nfit[1];
+        nfail = q.nfail[0] + q.nfail[1];
+    }
+    fprintf (stderr, "retrack read %lu records from %d files and fitted %lu waveforms (%lu failed) with %d threads in %.2f s (%.0f waveforms/s).\n",
+        (unsigned long)nrec, nfile, (unsigned long)nfit, (unsigned long)nfail, nthread, secs,
+        (secs > 0.) ? nfit / secs : 0.);
+    exit (EXIT_SUCCESS);
+}
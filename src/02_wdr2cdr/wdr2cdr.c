@@ -0,0 +1,405 @@
+/*  wdr2cdr.c
+
+ Stage 02: turn retracked 20 Hz record containers (stage 01 retrack -o)
+ into condensed data records, one CDR file per pass.  Each record becomes
+ a sea surface height (wdr.h); the pass is low-pass filtered along track
+ and decimated to one point every idt milliseconds, with the along-track
+ slope, by along.h (recursive sums, O(n) per pass; -D for the direct sums,
+ and -c to run both and report how far apart they are); and the points
+ are written as dir/<name>_<pass>.cdr in the packed format of cdr.h, or
+ with -a added to one CDR archive (cdr_arch.h).
+
+ Passes are split as rec_passes splits them, so pass numbers match its
+ table.  The main thread reads the records in order, keeping only the
+ heights of the pass it is in, and hands each finished pass to a pool of
+ worker threads that filter and write it; at most twice as many passes as
+ workers are in memory at once, so the run needs the same memory for a
+ day or a mission.  Workers take passes in the order they were read and,
+ with -a, add them to the archive in that order too, each waiting its turn
+ on its own lock, so pass ids do not depend on the threads.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include "rec_file.h"
+#include "wdr.h"
+#include "along.h"
+#include "cdr.h"
+#include "cdr_arch.h"
+
+#define BATCH       4096        /* records per read */
+#define MAXTHREAD   256
+#define MINOUT      2           /* least points worth a CDR file */
+
+struct JOB {
+    struct WDR_POINT *p;        /* usable records of the pass, in time order */
+    size_t  n, cap;
+    struct CDR_HEAD head;
+    char    name[1024];
+    long    seq;                /* order read, for -a */
+};
+
+/* Passes handed from the reader to the workers */
+struct POOL {
+    struct JOB *job;
+    int     *free, nfree;       /* jobs the reader may fill */
+    int     *ready, rhead, nready;  /* jobs waiting for a worker, oldest at rhead */
+    int     njob;
+    int     done;               /* no more jobs will come */
+    double  tscale, dt;
+    int     direct, check;      /* -D, -c */
+    pthread_mutex_t lock;
+    pthread_cond_t more, room;
+    size_t  npass, npoint;
+    size_t  ncheck, nmiss;      /* -c: points compared, points only one filter kept */
+    double  esh, edsh;          /* -c: worst differences */
+    int     err;
+    long    nput;               /* jobs handed to the workers */
+    struct CDR_ARCHW *arch;     /* -a, written under alock */
+    long    nwrite;             /* -a: next job to add */
+    pthread_mutex_t alock;      /* arch and nwrite */
+    pthread_cond_t turn;
+};
+
+static int write_pass (char *name, struct CDR_HEAD *head, struct CDR *c, size_t n) {
+
+    /* One CDR file */
+
+    FILE    *fp;
+    int     err;
+
+    if ((fp = fopen (name, "wb")) == NULL) {
+        fprintf (stderr, "Failed to open %s\n", name);
+        return (1);
+    }
+    err = cdr_write (fp, head, c, n);
+    err |= (fclose (fp) != 0);
+    if (err) fprintf (stderr, "Failure writing %s\n", name);
+    return (err);
+}
+
+static void check_pass (struct POOL *q, struct JOB *j, struct CDR *out, size_t nout) {
+
+    /* -c: filter the pass again by direct sums and keep the worst differences */
+
+    struct CDR *ref;
+    size_t  a, b, nref, nmiss = 0;
+    double  esh = 0., edsh = 0.;
+
+    if ((ref = (struct CDR *) malloc ((along_nout (j->p, j->n, q->dt) + 1) * sizeof (struct CDR))) == NULL) return;
+    nref = along_direct (j->p, j->n, q->tscale, q->dt, ref);
+    for (a = b = 0; a < nout || b < nref; ) {
+        if (b == nref || (a < nout && out[a].time_1 < ref[b].time_1)) {
+            nmiss++;
+            a++;
+        }
+        else if (a == nout || ref[b].time_1 < out[a].time_1) {
+            nmiss++;
+            b++;
+        }
+        else {
+            if (fabs (out[a].sh - ref[b].sh) > esh) esh = fabs (out[a].sh - ref[b].sh);
+            if (fabs (out[a].dsh - ref[b].dsh) > edsh) edsh = fabs (out[a].dsh - ref[b].dsh);
+            a++;
+            b++;
+        }
+    }
+    free ( (void *)ref);
+    pthread_mutex_lock (&q->lock);
+    q->ncheck += nref;
+    q->nmiss += nmiss;
+    if (esh > q->esh) q->esh = esh;
+    if (edsh > q->edsh) q->edsh = edsh;
+    pthread_mutex_unlock (&q->lock);
+}
+
+static void *pass_work (void *arg) {
+
+    struct POOL *q = (struct POOL *)arg;
+    struct JOB *j;
+    struct CDR *out;
+    size_t  nout;
+    int     i, err;
+
+    for (;;) {
+        pthread_mutex_lock (&q->lock);
+        while (q->nready == 0 && !q->done) pthread_cond_wait (&q->more, &q->lock);
+        if (q->nready == 0) {
+            pthread_mutex_unlock (&q->lock);
+            return (NULL);
+        }
+        i = q->ready[q->rhead];
+        q->rhead = (q->rhead + 1) % q->njob;
+        q->nready--;
+        pthread_mutex_unlock (&q->lock);
+
+        j = &q->job[i];
+        err = 0;
+        if ((out = (struct CDR *) malloc ((along_nout (j->p, j->n, q->dt) + 1) * sizeof (struct CDR))) == NULL) {
+            fprintf (stderr, "Failed to malloc CDR points for %s\n", j->name);
+            err = 1;
+            nout = 0;
+        }
+        else if (q->direct) nout = along_direct (j->p, j->n, q->tscale, q->dt, out);
+        else {
+            nout = along_recursive (j->p, j->n, q->tscale, q->dt, out);
+            if (q->check) check_pass (q, j, out, nout);
+        }
+        if (q->arch != NULL) {
+            pthread_mutex_lock (&q->alock);
+            while (q->nwrite != j->seq) pthread_cond_wait (&q->turn, &q->alock);
+            if (nout >= MINOUT) err = (cdr_arch_add (q->arch, &j->head, out, nout) < 0);
+            q->nwrite++;
+            pthread_cond_broadcast (&q->turn);
+            pthread_mutex_unlock (&q->alock);
+        }
+        else if (nout >= MINOUT) err = write_pass (j->name, &j->head, out, nout);
+        free ( (void *)out);
+
+        pthread_mutex_lock (&q->lock);
+        if (nout >= MINOUT && !err) {
+            q->npass++;
+            q->npoint += nout;
+        }
+        q->err |= err;
+        q->free[q->nfree++] = i;
+        pthread_cond_signal (&q->room);
+        pthread_mutex_unlock (&q->lock);
+    }
+}
+
+static struct JOB *get_job (struct POOL *q) {
+
+    /* A free job for the reader, waiting for a worker to finish one */
+
+    int     i;
+
+    pthread_mutex_lock (&q->lock);
+    while (q->nfree == 0) pthread_cond_wait (&q->room, &q->lock);
+    i = q->free[--q->nfree];
+    pthread_mutex_unlock (&q->lock);
+    q->job[i].n = 0;
+    return (&q->job[i]);
+}
+
+static void put_job (struct POOL *q, struct JOB *j) {
+
+    /* Hand a filled job to the workers, or back to the free list if empty */
+
+    pthread_mutex_lock (&q->lock);
+    if (j->n > 0) {
+        j->seq = q->nput++;
+        q->ready[(q->rhead + q->nready++) % q->njob] = (int)(j - q->job);
+        pthread_cond_signal (&q->more);
+    }
+    else q->free[q->nfree++] = (int)(j - q->job);
+    pthread_mutex_unlock (&q->lock);
+}
+
+static void start_job (struct JOB *j, struct REC_HEAD *h, char *outdir, char *fname, int ipass, int idt) {
+
+    /* Header and file name of pass ipass of fname */
+
+    char    *base, *dot;
+    size_t  len;
+
+    memset (&j->head, 0, sizeof (j->head));
+    j->head.isat = (int)h->mission;
+    j->head.iasc = -1;
+    j->head.ifile = ipass;
+    j->head.idt = idt;
+
+    base = strrchr (fname, '/');
+    base = (base == NULL) ? fname : base + 1;
+    if (!strcmp (fname, "-")) base = "stdin";
+    dot = strrchr (base, '.');
+    len = (dot == NULL) ? strlen (base) : (size_t)(dot - base);
+    if (len > 512) len = 512;
+    sprintf (j->name, "%.400s/%.*s_%05d.cdr", outdir, (int)len, base, ipass);
+}
+
+static int add_point (struct JOB *j, struct WDR_POINT *p) {
+
+    struct WDR_POINT *np;
+
+    if (j->n == j->cap) {
+        j->cap = (j->cap) ? 2 * j->cap : BATCH;
+        if ((np = (struct WDR_POINT *) realloc (j->p, j->cap * sizeof (*np))) == NULL) {
+            fprintf (stderr, "Failed to realloc pass buffer\n");
+            return (1);
+        }
+        j->p = np;
+    }
+    j->p[j->n++] = *p;
+    return (0);
+}
+
+int main (int argc, char **argv) {
+
+    struct POOL q;
+    struct CDR_ARCHW arch;
+    struct REC_HEAD h;
+    struct REC_CUT cut;
+    struct WDR_MISSION *m;
+    struct WDR_POINT pt;
+    struct JOB *j;
+    struct timespec c0, c1;
+    pthread_t tid[MAXTHREAD];
+    FILE    *fp;
+    char    *buf = NULL, *rec, *outdir = NULL, *archname = NULL;
+    size_t  k, n, nbuf = 0, nrec = 0, nused = 0;
+    double  gap = 2., secs;
+    int     c, i, r, bad = 0, nfile = 0, nthread, slot = 0, idt = 200, ipass, asc;
+
+    memset (&q, 0, sizeof (q));
+    q.tscale = 0.2;
+    nthread = (int)sysconf (_SC_NPROCESSORS_ONLN);
+    while ((c = getopt (argc, argv, "2a:cDd:g:i:j:T:")) != -1) {
+        switch (c) {
+            case '2':   /* heights from the second retracking pass */
+                slot = 1;
+                break;
+            case 'a':   /* output archive */
+                archname = optarg;
+                break;
+            case 'c':   /* check the recursive filter against direct sums */
+                q.check = 1;
+                break;
+            case 'D':   /* direct sums */
+                q.direct = 1;
+                break;
+            case 'd':   /* output directory */
+                outdir = optarg;
+                break;
+            case 'g':   /* pass gap, s */
+                gap = atof (optarg);
+                break;
+            case 'i':   /* point spacing, ms */
+                idt = atoi (optarg);
+                break;
+            case 'j':   /* threads */
+                nthread = atoi (optarg);
+                break;
+            case 'T':   /* filter scale, s */
+                q.tscale = atof (optarg);
+                break;
+            default:
+                bad = 1;
+                break;
+        }
+    }
+    if (bad || optind >= argc || (outdir == NULL) == (archname == NULL) || idt < 1 || !(q.tscale > 0.) || !(gap > 0.) || (q.direct && q.check)) {
+        fprintf (stderr, "usage: wdr2cdr -d directory | -a archive [-i idt_ms] [-T scale] [-g gap] [-2] [-D | -c] [-j nthreads] file1.rec file2.rec ...\n");
+        fprintf (stderr, "\t-d  write each pass as directory/<file>_<pass>.cdr\n");
+        fprintf (stderr, "\t-a  add the passes to this CDR archive, creating it if it does not exist\n");
+        fprintf (stderr, "\t-i  CDR point spacing, milliseconds (default 200)\n");
+        fprintf (stderr, "\t-T  along-track filter scale, seconds (default 0.2; half amplitude at about 10 T of ground track)\n");
+        fprintf (stderr, "\t-g  a time gap longer than this ends a pass (default 2 s)\n");
+        fprintf (stderr, "\t-2  use the second retracking (retrack -2) rather than the first\n");
+        fprintf (stderr, "\t-D  filter by direct sums over each window (slow; the reference)\n");
+        fprintf (stderr, "\t-c  filter by recursive sums (the default) and also by direct sums, and report the differences\n");
+        fprintf (stderr, "\t-j  filter passes with this many threads (default one per online CPU)\n");
+        fprintf (stderr, "\tInputs are retracked containers (retrack -o, or retrack -2 -o for -2), full, compressed or thin.  Use - to read stdin.\n");
+        exit (EXIT_FAILURE);
+    }
+    if (nthread < 1) nthread = 1;
+    if (nthread > MAXTHREAD) nthread = MAXTHREAD;
+    q.dt = 1.e-3 * idt;
+
+    /* two jobs per worker: one being filtered while the next is read */
+    q.job = (struct JOB *) calloc (2 * nthread, sizeof (struct JOB));
+    q.free = (int *) malloc (2 * nthread * sizeof (int));
+    q.ready = (int *) malloc (2 * nthread * sizeof (int));
+    if (q.job == NULL || q.free == NULL || q.ready == NULL) {
+        fprintf (stderr, "Failed to malloc pass pool\n");
+        exit (EXIT_FAILURE);
+    }
+    q.njob = 2 * nthread;
+    for (i = 0; i < q.njob; i++) q.free[q.nfree++] = i;
+    if (archname != NULL) {
+        if (cdr_arch_create (&arch, archname, 1)) exit (EXIT_FAILURE);
+        q.arch = &arch;
+        outdir = ".";           /* pass names then only label messages */
+    }
+    pthread_mutex_init (&q.lock, NULL);
+    pthread_mutex_init (&q.alock, NULL);
+    pthread_cond_init (&q.more, NULL);
+    pthread_cond_init (&q.room, NULL);
+    pthread_cond_init (&q.turn, NULL);
+    for (i = 0; i < nthread; i++) {
+        if (pthread_create (&tid[i], NULL, pass_work, &q)) {
+            fprintf (stderr, "Failed to start thread %d\n", i);
+            exit (EXIT_FAILURE);
+        }
+    }
+    clock_gettime (CLOCK_MONOTONIC, &c0);
+
+    for (; optind < argc; optind++) {
+        if ((fp = rec_stream (argv[optind], &h, REC_ANY, 0, 0)) == NULL) exit (EXIT_FAILURE);
+        if ((m = wdr_mission (&h)) == NULL) exit (EXIT_FAILURE);
+        if (!(h.flags & ((slot) ? REC_FIT2 : REC_FIT1))) {
+            fprintf (stderr, "Failed: %s has no drange[%d]; retrack%s it first\n", argv[optind], slot, (slot) ? " -2" : "");
+            exit (EXIT_FAILURE);
+        }
+        if (nbuf < BATCH * (size_t)h.recsize) {
+            free ( (void *)buf);
+            nbuf = BATCH * (size_t)h.recsize;
+            if ((buf = (char *) malloc (nbuf)) == NULL) {
+                fprintf (stderr, "Failed to malloc record buffer\n");
+                exit (EXIT_FAILURE);
+            }
+        }
+        memset (&cut, 0, sizeof (cut));
+        ipass = 0;
+        asc = -1;
+        j = get_job (&q);
+        start_job (j, &h, outdir, argv[optind], ipass, idt);
+        while ((n = rec_get (fp, &h, buf, BATCH)) > 0) {
+            for (k = 0, rec = buf; k < n; k++, rec += h.recsize) {
+                if ((r = rec_cut (&cut, &h, rec, gap)) == 1) {
+                    j->head.iasc = asc;
+                    put_job (&q, j);
+                    j = get_job (&q);
+                    start_job (j, &h, outdir, argv[optind], ++ipass, idt);
+                    asc = -1;
+                }
+                if (r >= 0) asc = cut.asc;
+                if (wdr_point (m, &h, rec, slot, &pt)) continue;
+                if (add_point (j, &pt)) exit (EXIT_FAILURE);
+                nused++;
+            }
+            nrec += n;
+        }
+        j->head.iasc = asc;
+        put_job (&q, j);
+        if (fp != stdin) fclose (fp);
+        nfile++;
+    }
+
+    pthread_mutex_lock (&q.lock);
+    q.done = 1;
+    pthread_cond_broadcast (&q.more);
+    pthread_mutex_unlock (&q.lock);
+    for (i = 0; i < nthread; i++) pthread_join (tid[i], NULL);
+    clock_gettime (CLOCK_MONOTONIC, &c1);
+    if (q.arch != NULL) q.err |= cdr_arch_finish (q.arch);
+    secs = (c1.tv_sec - c0.tv_sec) + 1.e-9 * (c1.tv_nsec - c0.tv_nsec);
+
+    for (i = 0; i < 2 * nthread; i++) free ( (void *)q.job[i].p);
+    free ( (void *)q.job);
+    free ( (void *)q.free);
+    free ( (void *)q.ready);
+    free ( (void *)buf);
+    fprintf (stderr, "wdr2cdr read %lu records (%lu usable) from %d files and wrote %lu passes of %lu points with %d threads in %.2f s.\n",
+        (unsigned long)nrec, (unsigned long)nused, nfile, (unsigned long)q.npass, (unsigned long)q.npoint, nthread, secs);
+    if (q.check) fprintf (stderr, "wdr2cdr -c: over %lu points, recursive and direct sums agree to %.2g m in sh and %.2g urad in dsh; %lu points kept by only one.\n",
+        (unsigned long)q.ncheck, q.esh, q.edsh, (unsigned long)q.nmiss);
+    exit ((q.err) ? EXIT_FAILURE : EXIT_SUCCESS);
+}
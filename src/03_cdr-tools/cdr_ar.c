@@ -0,0 +1,127 @@
+/*  cdr_ar.c
+
+ Build and read CDR archives (cdr_arch.h), as ar does for object files:
+
+   cdr_ar -c archive.cda inputs ...     new archive of the inputs' passes
+   cdr_ar -r archive.cda inputs ...     add them to an archive (made if missing)
+   cdr_ar -t archive.cda                list the pass directory
+   cdr_ar -x archive.cda id             write pass id to stdout as a CDR file
+
+ Inputs are CDR files or other archives; passes of an archive are copied
+ packed, with their directory entries, without unpacking the points.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "cdr.h"
+#include "cdr_arch.h"
+
+static int add_input (struct CDR_ARCHW *w, char *fname) {
+
+    /* Every pass of fname into w */
+
+    struct CDR_ARCH a;
+    struct CDR_PASS d;
+    struct CDR_HEAD h;
+    struct CDR *p;
+    size_t  n;
+    long    id;
+    int     err = 0;
+
+    if (!cdr_is_arch (fname)) {
+        if ((p = cdr_load (fname, &h, &n)) == NULL) return (1);
+        err = (cdr_arch_add (w, &h, p, n) < 0);
+        free ( (void *)p);
+        return (err);
+    }
+    if (cdr_arch_open (&a, fname)) return (1);
+    for (id = 0; id < a.npass && !err; id++) {
+        err = (cdr_arch_pass (&a, id, &d) || cdr_arch_copy (w, &d, cdr_arch_raw (&a, &d)) < 0);
+    }
+    cdr_arch_close (&a);
+    return (err);
+}
+
+static int list (char *fname) {
+    struct CDR_ARCH a;
+    struct CDR_PASS d;
+    long    id;
+
+    if (cdr_arch_open (&a, fname)) return (1);
+    printf ("#   id isat iasc  ifile  idt  points            t0            t1    south    north     west     east\n");
+    for (id = 0; id < a.npass; id++) {
+        if (cdr_arch_pass (&a, id, &d)) {
+            cdr_arch_close (&a);
+            return (1);
+        }
+        printf ("%6ld %4d %4d %6d %4d %7ld %13.3f %13.3f %8.4f %8.4f %8.4f %8.4f\n",
+            id, d.isat, d.iasc, d.ifile, d.idt, d.n, d.t0, d.t1, d.south, d.north, d.west, d.east);
+    }
+    cdr_arch_close (&a);
+    return (0);
+}
+
+static int extract (char *fname, long id) {
+    struct CDR_ARCH a;
+    struct CDR_PASS d;
+    size_t  len;
+    int     err;
+
+    if (cdr_arch_open (&a, fname)) return (1);
+    if (cdr_arch_pass (&a, id, &d)) {
+        cdr_arch_close (&a);
+        return (1);
+    }
+    len = CDR_HEADSIZE + (size_t)d.n * CDR_PACKED;
+    err = (fwrite (cdr_arch_raw (&a, &d), 1, len, stdout) != len || fflush (stdout));
+    if (err) fprintf (stderr, "Failure writing pass %ld\n", id);
+    cdr_arch_close (&a);
+    return (err);
+}
+
+int main (int argc, char **argv) {
+
+    struct CDR_ARCHW w;
+    char    mode = 0, *name;
+    int     c, bad = 0, err = 0;
+
+    while ((c = getopt (argc, argv, "crtx")) != -1) {
+        switch (c) {
+            case 'c':
+            case 'r':
+            case 't':
+            case 'x':
+                if (mode) bad = 1;
+                mode = (char)c;
+                break;
+            default:
+                bad = 1;
+                break;
+        }
+    }
+    if (bad || !mode || optind >= argc || (mode == 't' && argc - optind != 1) || (mode == 'x' && argc - optind != 2)) {
+        fprintf (stderr, "usage: cdr_ar -c | -r archive.cda file1.cdr | archive1.cda ...\n");
+        fprintf (stderr, "       cdr_ar -t archive.cda\n");
+        fprintf (stderr, "       cdr_ar -x archive.cda pass > pass.cdr\n");
+        fprintf (stderr, "\t-c  create the archive from the passes of the inputs\n");
+        fprintf (stderr, "\t-r  add the passes of the inputs to the archive, creating it if it does not exist\n");
+        fprintf (stderr, "\t-t  list the archive's passes: id, header, points, time span and lat/lon box\n");
+        fprintf (stderr, "\t-x  write one pass as a CDR file\n");
+        exit (EXIT_FAILURE);
+    }
+
+    if (mode == 't') err = list (argv[optind]);
+    else if (mode == 'x') err = extract (argv[optind], atol (argv[optind+1]));
+    else {
+        name = argv[optind];
+        if (cdr_arch_create (&w, name, mode == 'r')) exit (EXIT_FAILURE);
+        for (optind++; optind < argc && !err; optind++) err = add_input (&w, argv[optind]);
+        err |= cdr_arch_finish (&w);
+        if (!err) fprintf (stderr, "cdr_ar: %s holds %ld passes.\n", name, w.npass);
+    }
+    exit ((err) ? EXIT_FAILURE : EXIT_SUCCESS);
+}
@@ -0,0 +1,73 @@
+/*  cdr_read.c
+
+ Print CDR passes as text: for each pass a line with its header, then one
+ line per point.  Inputs are CDR files or CDR archives (cdr_arch.h); with
+ -p only the given pass of an archive is printed.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "cdr.h"
+#include "cdr_arch.h"
+
+static void print_pass (struct CDR_HEAD *h, struct CDR *p, size_t n) {
+    size_t  k;
+
+    printf ("isat: %d, iasc: %d, ifile: %d, dt: %d, points: %lu\n", h->isat, h->iasc, h->ifile, h->idt, (unsigned long)n);
+    for (k = 0; k < n; k++) printf ("%f, %f, %f, %f, %f, %f\n", p[k].time_1, p[k].lat, p[k].lon, p[k].sh, p[k].dsh, p[k].cor);
+}
+
+int main (int argc, char **argv) {
+
+    struct CDR_ARCH a;
+    struct CDR_HEAD h;
+    struct CDR *p;
+    size_t  n;
+    long    id, id0 = 0, id1 = -1;
+    int     c, bad = 0, err = 0;
+
+    while ((c = getopt (argc, argv, "p:")) != -1) {
+        switch (c) {
+            case 'p':   /* one pass of an archive */
+                id0 = id1 = atol (optarg);
+                break;
+            default:
+                bad = 1;
+                break;
+        }
+    }
+    if (bad || optind >= argc) {
+        fprintf (stderr, "usage: cdr_read [-p pass] file1.cdr | archive.cda ...\n");
+        fprintf (stderr, "\t-p  print only this pass id of an archive (cdr_ar -t lists them)\n");
+        exit (EXIT_FAILURE);
+    }
+
+    for (; optind < argc; optind++) {
+        if (!cdr_is_arch (argv[optind])) {
+            if ((p = cdr_load (argv[optind], &h, &n)) == NULL) {
+                err = 1;
+                continue;
+            }
+            print_pass (&h, p, n);
+            free ( (void *)p);
+            continue;
+        }
+        if (cdr_arch_open (&a, argv[optind])) {
+            err = 1;
+            continue;
+        }
+        for (id = id0; id <= ((id1 < 0) ? a.npass - 1 : id1); id++) {
+            if ((p = cdr_arch_load (&a, id, &h, &n)) == NULL) {
+                err = 1;
+                break;
+            }
+            print_pass (&h, p, n);
+            free ( (void *)p);
+        }
+        cdr_arch_close (&a);
+    }
+    exit ((err) ? EXIT_FAILURE : EXIT_SUCCESS);
+}
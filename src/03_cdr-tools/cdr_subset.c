@@ -0,0 +1,350 @@
+/*  cdr_subset.c
+
+ Select and merge CDR passes into one CDR archive (cdr_arch.h).  Passes
+ may be chosen by satellite and direction, and points by a time window
+ and a lat/lon box; with -P a pass that has any point inside is kept
+ whole.  Any number of CDR files and archives go into one output, so with
+ no selection it merges them.
+
+ The points are never unpacked to struct CDR: a pass is tested against
+ its directory entry first, skipped if it cannot match and copied whole
+ if it lies inside the selection, and otherwise its packed points are
+ tested by their time, lat and lon and the ones kept are copied as they
+ are.  Passes are handled by a pool of threads, each taking the next pass
+ in input order, and written in that order, so the output does not depend
+ on the number of threads.  Taking a pass and waiting for a turn to write
+ have their own locks, so a thread with nothing to write yet takes more
+ work while another is in the archive writer.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include "cdr.h"
+#include "cdr_arch.h"
+
+#define MAXTHREAD   256
+
+/* The selection; each part applies only if its flag is set */
+struct SEL {
+    int     use_t;
+    double  t0, t1;             /* seconds since 2000 */
+    int     use_r;
+    double  west, arc, south, north;    /* deg; the box runs arc degrees east from west */
+    int     isat, iasc;         /* -1 for any */
+    int     whole;              /* -P */
+    long    minpts;
+};
+
+/* One input pass: pass id of archive in, or CDR file in when id < 0 */
+struct TASK {
+    int     in;
+    long    id;
+};
+
+struct POOL {
+    struct SEL *s;
+    char    **name;             /* inputs */
+    struct CDR_ARCH *arch;      /* inputs that are archives; map NULL for CDR files */
+    struct TASK *task;
+    long    ntask, next;        /* next task to take */
+    pthread_mutex_t lock;       /* next and err */
+    int     err;
+    long    nwrite;             /* next task to write */
+    struct CDR_ARCHW *out;
+    pthread_mutex_t wlock;      /* nwrite, out and the counts */
+    pthread_cond_t turn;
+    long    npass, npoint, nread;       /* passes and points written, points read */
+    double  bytes;              /* bytes of the input passes */
+};
+
+static double wrap (double x) {
+
+    /* x to 0 - 360 */
+
+    while (x < 0.) x += 360.;
+    while (x >= 360.) x -= 360.;
+    return (x);
+}
+
+static int sel_pass (struct SEL *s, struct CDR_PASS *d) {
+
+    /* From a directory entry: 0 if no point can match, 2 if every point
+       does, 1 if the points must be looked at */
+
+    double  a, dw;
+    int     inside = 1;
+
+    if ((s->isat >= 0 && d->isat != s->isat) || (s->iasc >= 0 && d->iasc != s->iasc) || d->n < s->minpts) return (0);
+    if (s->use_t) {
+        if (d->t1 < s->t0 || d->t0 > s->t1) return (0);
+        inside &= (d->t0 >= s->t0 && d->t1 <= s->t1);
+    }
+    if (s->use_r) {
+        if (d->north < s->south || d->south > s->north) return (0);
+        inside &= (d->south >= s->south && d->north <= s->north);
+        a = d->east - d->west;
+        if (a < 0.) a += 360.;
+        dw = wrap (d->west - s->west);
+        if (dw > s->arc && wrap (s->west - d->west) > a) return (0);
+        inside &= (dw + a <= s->arc);
+    }
+    return ((inside) ? 2 : 1);
+}
+
+static int sel_point (struct SEL *s, const unsigned char *r) {
+
+    /* 1 if the packed point r is selected */
+
+    double  t;
+    float   lat, lon;
+
+    if (s->use_t) {
+        cdr_le (&t, r, 8);
+        if (t < s->t0 || t > s->t1) return (0);
+    }
+    if (s->use_r) {
+        cdr_le (&lat, r + 8, 4);
+        cdr_le (&lon, r + 12, 4);
+        if (lat < s->south || lat > s->north || wrap (lon - s->west) > s->arc) return (0);
+    }
+    return (1);
+}
+
+static size_t subset (struct SEL *s, const unsigned char *raw, size_t n, unsigned char *buf) {
+
+    /* Copy the header and the selected points of a packed pass to buf;
+       returns the points copied, all of them with -P if any is selected */
+
+    const unsigned char *r;
+    unsigned char *b;
+    size_t  k, m = 0;
+
+    memcpy (buf, raw, CDR_HEADSIZE);
+    for (k = 0, r = raw + CDR_HEADSIZE, b = buf + CDR_HEADSIZE; k < n; k++, r += CDR_PACKED) {
+        if (!sel_point (s, r)) continue;
+        if (s->whole) {
+            memcpy (buf + CDR_HEADSIZE, raw + CDR_HEADSIZE, n * CDR_PACKED);
+            return (n);
+        }
+        memcpy (b, r, CDR_PACKED);
+        b += CDR_PACKED;
+        m++;
+    }
+    return (m);
+}
+
+static void *pass_work (void *arg) {
+
+    struct POOL *q = (struct POOL *)arg;
+    struct TASK *t;
+    struct CDR_FILE cf;
+    struct CDR_PASS d;
+    const unsigned char *raw;
+    unsigned char *buf = NULL, *nb;
+    size_t  n, m, nbuf = 0;
+    long    i;
+    int     how, err, mapped;
+
+    for (;;) {
+        pthread_mutex_lock (&q->lock);
+        i = (q->err) ? q->ntask : q->next++;
+        pthread_mutex_unlock (&q->lock);
+        if (i >= q->ntask) break;
+        t = &q->task[i];
+
+        /* the pass and how far its directory entry settles it */
+        err = mapped = 0;
+        raw = NULL;
+        n = m = 0;
+        how = 0;
+        if (t->id >= 0) {
+            if (cdr_arch_pass (&q->arch[t->in], t->id, &d)) err = 1;
+            else {
+                raw = cdr_arch_raw (&q->arch[t->in], &d);
+                n = (size_t)d.n;
+                how = sel_pass (q->s, &d);
+            }
+        }
+        else if (cdr_open (&cf, q->name[t->in])) err = 1;
+        else {
+            mapped = 1;
+            raw = cf.raw - CDR_HEADSIZE;
+            n = cf.n;
+            how = ((q->s->isat >= 0 && cf.h.isat != q->s->isat) || (q->s->iasc >= 0 && cf.h.iasc != q->s->iasc)) ? 0 : 1;
+        }
+
+        /* the points it keeps, in buf unless all of them are */
+        if (how == 2) m = n;
+        else if (how == 1) {
+            if (nbuf < CDR_HEADSIZE + n * CDR_PACKED) {
+                nbuf = CDR_HEADSIZE + n * CDR_PACKED;
+                if ((nb = (unsigned char *) realloc (buf, nbuf)) == NULL) {
+                    fprintf (stderr, "Failed to realloc a pass of %lu points\n", (unsigned long)n);
+                    err = 1;
+                    nbuf = 0;
+                }
+                else buf = nb;
+            }
+            if (!err) m = subset (q->s, raw, n, buf);
+        }
+        if (m < (size_t)q->s->minpts) m = 0;
+
+        /* write in input order; an error stops the writes, and the takes */
+        pthread_mutex_lock (&q->wlock);
+        while (q->nwrite != i) pthread_cond_wait (&q->turn, &q->wlock);
+        pthread_mutex_lock (&q->lock);
+        err |= q->err;
+        pthread_mutex_unlock (&q->lock);
+        if (!err && m > 0) {
+            if (how == 2 && t->id >= 0) err = (cdr_arch_copy (q->out, &d, raw) < 0);
+            else if (how == 2 || m == n) err = (cdr_arch_put (q->out, raw, m) < 0);
+            else err = (cdr_arch_put (q->out, buf, m) < 0);
+            if (!err) {
+                q->npass++;
+                q->npoint += (long)m;
+            }
+        }
+        q->nread += (long)n;
+        q->bytes += (double)(CDR_HEADSIZE + n * CDR_PACKED);
+        q->nwrite++;
+        pthread_cond_broadcast (&q->turn);
+        pthread_mutex_unlock (&q->wlock);
+        if (err) {
+            pthread_mutex_lock (&q->lock);
+            q->err = 1;
+            pthread_mutex_unlock (&q->lock);
+        }
+        if (mapped) cdr_close (&cf);
+    }
+    free ( (void *)buf);
+    return (NULL);
+}
+
+int main (int argc, char **argv) {
+
+    struct SEL s;
+    struct POOL q;
+    struct CDR_ARCHW out;
+    struct timespec c0, c1;
+    pthread_t tid[MAXTHREAD];
+    char    *outname = NULL;
+    long    k, ntask = 0;
+    double  east, secs;
+    int     c, i, bad = 0, nin, nthread;
+
+    memset (&s, 0, sizeof (s));
+    memset (&q, 0, sizeof (q));
+    s.isat = s.iasc = -1;
+    s.minpts = 1;
+    nthread = (int)sysconf (_SC_NPROCESSORS_ONLN);
+    while ((c = getopt (argc, argv, "a:j:n:o:PR:s:t:")) != -1) {
+        switch (c) {
+            case 'a':   /* direction */
+                s.iasc = atoi (optarg);
+                break;
+            case 'j':   /* threads */
+                nthread = atoi (optarg);
+                break;
+            case 'n':   /* least points in an output pass */
+                s.minpts = atol (optarg);
+                break;
+            case 'o':   /* output archive */
+                outname = optarg;
+                break;
+            case 'P':   /* whole passes */
+                s.whole = 1;
+                break;
+            case 'R':   /* lat/lon box */
+                s.use_r = 1;
+                if (sscanf (optarg, "%lf/%lf/%lf/%lf", &s.west, &east, &s.south, &s.north) != 4 || s.south > s.north) bad = 1;
+                s.arc = east - s.west;
+                if (s.arc < 0.) s.arc += 360.;
+                if (s.arc > 360.) s.arc = 360.;
+                s.west = wrap (s.west);
+                break;
+            case 's':   /* satellite */
+                s.isat = atoi (optarg);
+                break;
+            case 't':   /* time window */
+                s.use_t = 1;
+                if (sscanf (optarg, "%lf/%lf", &s.t0, &s.t1) != 2 || s.t0 > s.t1) bad = 1;
+                break;
+            default:
+                bad = 1;
+                break;
+        }
+    }
+    if (bad || optind >= argc || outname == NULL || s.minpts < 1) {
+        fprintf (stderr, "usage: cdr_subset -o out.cda [-t t0/t1] [-R west/east/south/north] [-s isat] [-a iasc] [-P] [-n minpts] [-j nthreads] file1.cdr | archive1.cda ...\n");
+        fprintf (stderr, "\t-o  write the selected passes and points to this new CDR archive\n");
+        fprintf (stderr, "\t-t  keep points with time_1 from t0 to t1, seconds since 2000\n");
+        fprintf (stderr, "\t-R  keep points in this box, deg; west > east wraps through 0\n");
+        fprintf (stderr, "\t-s  keep passes of this satellite (CDR isat)\n");
+        fprintf (stderr, "\t-a  keep passes going this way: 1 ascending, 0 descending\n");
+        fprintf (stderr, "\t-P  keep whole passes with any point selected by -t and -R\n");
+        fprintf (stderr, "\t-n  leave out passes left with fewer points than this (default 1)\n");
+        fprintf (stderr, "\t-j  threads (default one per online CPU)\n");
+        fprintf (stderr, "\tWith no selection the inputs are merged.  Output passes are in input order.\n");
+        exit (EXIT_FAILURE);
+    }
+    if (nthread < 1) nthread = 1;
+    if (nthread > MAXTHREAD) nthread = MAXTHREAD;
+
+    /* one mmap per input archive, and the list of passes */
+    nin = argc - optind;
+    q.s = &s;
+    q.name = argv + optind;
+    if ((q.arch = (struct CDR_ARCH *) calloc (nin, sizeof (struct CDR_ARCH))) == NULL) {
+        fprintf (stderr, "Failed to malloc inputs\n");
+        exit (EXIT_FAILURE);
+    }
+    for (i = 0; i < nin; i++) {
+        if (!cdr_is_arch (q.name[i])) ntask++;
+        else if (cdr_arch_open (&q.arch[i], q.name[i])) exit (EXIT_FAILURE);
+        else ntask += q.arch[i].npass;
+    }
+    if ((q.task = (struct TASK *) malloc ((ntask + 1) * sizeof (struct TASK))) == NULL) {
+        fprintf (stderr, "Failed to malloc %ld passes\n", ntask);
+        exit (EXIT_FAILURE);
+    }
+    for (i = 0; i < nin; i++) {
+        if (q.arch[i].map == NULL) {
+            q.task[q.ntask].in = i;
+            q.task[q.ntask++].id = -1;
+        }
+        else for (k = 0; k < q.arch[i].npass; k++) {
+            q.task[q.ntask].in = i;
+            q.task[q.ntask++].id = k;
+        }
+    }
+
+    if (cdr_arch_create (&out, outname, 0)) exit (EXIT_FAILURE);
+    q.out = &out;
+    pthread_mutex_init (&q.lock, NULL);
+    pthread_mutex_init (&q.wlock, NULL);
+    pthread_cond_init (&q.turn, NULL);
+    clock_gettime (CLOCK_MONOTONIC, &c0);
+    for (i = 0; i < nthread; i++) {
+        if (pthread_create (&tid[i], NULL, pass_work, &q)) {
+            fprintf (stderr, "Failed to start thread %d\n", i);
+            exit (EXIT_FAILURE);
+        }
+    }
+    for (i = 0; i < nthread; i++) pthread_join (tid[i], NULL);
+    q.err |= cdr_arch_finish (&out);
+    clock_gettime (CLOCK_MONOTONIC, &c1);
+    secs = (c1.tv_sec - c0.tv_sec) + 1.e-9 * (c1.tv_nsec - c0.tv_nsec);
+
+    for (i = 0; i < nin; i++) cdr_arch_close (&q.arch[i]);
+    free ( (void *)q.arch);
+    free ( (void *)q.task);
+    fprintf (stderr, "cdr_subset kept %ld of %ld passes and %ld of %ld points from %d inputs with %d threads in %.2f s (%.0f MB/s).\n",
+        q.npass, q.ntask, q.npoint, q.nread, nin, nthread, secs, 1.e-6 * q.bytes / ((secs > 0.) ? secs : 1.));
+    exit ((q.err) ? EXIT_FAILURE : EXIT_SUCCESS);
+}
@@ -0,0 +1,476 @@
+/*  xadjust.c
+
+ Adjust the passes of a CDR archive to their crossovers (xover.h): solve
+ for a bias per pass, and with -t a tilt, that best removes the crossover
+ differences, print them, and with -u take them out of the archive's sh
+ (and add them to cor) in place.
+
+ A pass's correction at time t is b + c tau, tau = 2 (t - tmid) / (t1 - t0)
+ running from -1 to 1 over the pass, so b and c are both metres.  The
+ least squares problem over all crossovers k,
+
+   min sum_k [(sha_k - shb_k) - (b_a + c_a tau_a - b_b - c_b tau_b)]^2
+       + damp sum_p (b_p^2 + c_p^2)
+
+ has one block of unknowns per pass.  Its normal matrix is never formed:
+ each crossover is listed under both its passes, so the product of the
+ normal matrix with a vector is, pass by pass, a sum over that pass's
+ crossovers, and the threads share the passes without locks.  It is
+ solved by conjugate gradients preconditioned by each pass's own block.
+ The small damping fixes what crossovers cannot see, a common offset
+ (and tilt) and passes with no crossovers, at zero.  Memory is that of
+ the crossovers plus a few numbers per pass.
+
+ With -e, crossovers whose residual is more than that many times the rms
+ are left out and the solve repeated, up to EDITS times.
+ */
+
+#define _XOPEN_SOURCE 600   /* pthread_barrier_t */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include "cdr.h"
+#include "cdr_arch.h"
+#include "xover.h"
+
+#define MAXTHREAD   256
+#define NU          2           /* unknowns per pass: bias, tilt */
+#define EDITS       5
+#define APPLYBLOCK  4096        /* points corrected at a time */
+
+struct SOLVE {
+    struct XOVER *x;
+    size_t  nx;
+    double  *tau;               /* 2 k: tau of crossover k on pass a, 2 k + 1 on pass b */
+    char    *used;              /* by crossover, after editing */
+    long    npass;
+    long    *start;             /* crossovers of pass p: item[start[p] .. start[p+1]-1] */
+    long    *item;              /* 2 k + side, side 0 when p is pass a */
+    int     nu;                 /* 1, or NU with -t */
+    double  damp, tol;
+    int     maxit;
+    double  *u, *r, *z, *p, *q, *rhs;   /* nu per pass */
+    double  *minv;              /* inverse of each pass's diagonal block, nu x nu */
+    double  *part;              /* per thread partial sums, 4 each */
+    int     nthread, iter;
+    double  rel;                /* final |r| / |rhs| */
+    pthread_barrier_t bar;
+};
+
+struct ARG {
+    struct SOLVE *s;
+    int     id;
+};
+
+static double row (struct SOLVE *s, long it, double *f) {
+
+    /* Crossover item it seen from its pass: the coefficients f of that
+       pass's unknowns, and the sign of the pass in the difference */
+
+    int     side = (int)(it & 1);
+
+    f[0] = 1.;
+    f[1] = s->tau[(it & ~1L) + side];
+    return ((side) ? -1. : 1.);
+}
+
+static double model (struct SOLVE *s, long k, double *v) {
+
+    /* The crossover difference that the unknowns v explain */
+
+    double  a, b;
+    int     ia = s->x[k].ida, ib = s->x[k].idb;
+
+    a = v[s->nu * ia];
+    b = v[s->nu * ib];
+    if (s->nu > 1) {
+        a += v[s->nu * ia + 1] * s->tau[2 * k];
+        b += v[s->nu * ib + 1] * s->tau[2 * k + 1];
+    }
+    return (a - b);
+}
+
+static void normal (struct SOLVE *s, long p0, long p1, double *v, double *out) {
+
+    /* out = (normal matrix) v, for passes p0 .. p1-1 */
+
+    double  f[2], g;
+    long    p, j;
+    int     m;
+
+    for (p = p0; p < p1; p++) {
+        for (m = 0; m < s->nu; m++) out[s->nu * p + m] = s->damp * v[s->nu * p + m];
+        for (j = s->start[p]; j < s->start[p+1]; j++) {
+            if (!s->used[s->item[j] >> 1]) continue;
+            g = row (s, s->item[j], f) * model (s, s->item[j] >> 1, v);
+            for (m = 0; m < s->nu; m++) out[s->nu * p + m] += f[m] * g;
+        }
+    }
+}
+
+static void precondition (struct SOLVE *s, long p0, long p1) {
+
+    /* z = M^-1 r over passes p0 .. p1-1 */
+
+    long    p;
+    double  *m;
+
+    for (p = p0; p < p1; p++) {
+        m = &s->minv[s->nu * s->nu * p];
+        if (s->nu == 1) s->z[p] = m[0] * s->r[p];
+        else {
+            s->z[2*p] = m[0] * s->r[2*p] + m[1] * s->r[2*p+1];
+            s->z[2*p+1] = m[2] * s->r[2*p] + m[3] * s->r[2*p+1];
+        }
+    }
+}
+
+static double total (struct SOLVE *s, int slot) {
+
+    /* Sum of the threads' partial sums in slot, in a fixed order so every
+       thread gets the same number */
+
+    double  sum = 0.;
+    int     i;
+
+    for (i = 0; i < s->nthread; i++) sum += s->part[4 * i + slot];
+    return (sum);
+}
+
+static void *pcg (void *arg) {
+
+    /* Each thread runs the iteration over its own passes; sums over all
+       passes are put together after a barrier */
+
+    struct ARG *a = (struct ARG *)arg;
+    struct SOLVE *s = a->s;
+    struct XOVER *x;
+    double  f[2], g, det, d[4], *mp, alpha, beta, rz, rz1, rr, bb, pq, *part = &s->part[4 * a->id];
+    long    p, j, i, n0, n1, p0, p1;
+    int     m, it;
+
+    p0 = s->npass * a->id / s->nthread;
+    p1 = s->npass * (a->id + 1) / s->nthread;
+    n0 = s->nu * p0;
+    n1 = s->nu * p1;
+
+    /* right hand side and block preconditioner */
+    for (p = p0; p < p1; p++) {
+        d[0] = d[3] = s->damp;
+        d[1] = d[2] = 0.;
+        for (m = 0; m < s->nu; m++) s->rhs[s->nu * p + m] = 0.;
+        for (j = s->start[p]; j < s->start[p+1]; j++) {
+            if (!s->used[s->item[j] >> 1]) continue;
+            x = &s->x[s->item[j] >> 1];
+            g = row (s, s->item[j], f) * (x->sha - x->shb);
+            for (m = 0; m < s->nu; m++) s->rhs[s->nu * p + m] += f[m] * g;
+            d[0] += 1.;
+            d[1] += f[1];
+            d[3] += f[1] * f[1];
+        }
+        mp = &s->minv[s->nu * s->nu * p];
+        if (s->nu == 1) mp[0] = 1. / d[0];
+        else {
+            det = d[0] * d[3] - d[1] * d[1];
+            mp[0] = d[3] / det;
+            mp[1] = mp[2] = -d[1] / det;
+            mp[3] = d[0] / det;
+        }
+    }
+    for (i = n0; i < n1; i++) {
+        s->u[i] = 0.;
+        s->r[i] = s->rhs[i];
+    }
+    precondition (s, p0, p1);
+    for (i = n0, part[1] = part[2] = 0.; i < n1; i++) {
+        s->p[i] = s->z[i];
+        part[1] += s->r[i] * s->z[i];
+        part[2] += s->rhs[i] * s->rhs[i];
+    }
+    pthread_barrier_wait (&s->bar);
+    rz = total (s, 1);
+    bb = total (s, 2);
+    rr = bb;
+
+    for (it = 0; it < s->maxit && rr > s->tol * s->tol * bb; it++) {
+        pthread_barrier_wait (&s->bar);     /* all of p is updated, and the sums read */
+        normal (s, p0, p1, s->p, s->q);
+        for (i = n0, part[0] = 0.; i < n1; i++) part[0] += s->p[i] * s->q[i];
+        pthread_barrier_wait (&s->bar);
+        pq = total (s, 0);
+        alpha = rz / pq;
+        for (i = n0; i < n1; i++) {
+            s->u[i] += alpha * s->p[i];
+            s->r[i] -= alpha * s->q[i];
+        }
+        precondition (s, p0, p1);
+        for (i = n0, part[1] = part[2] = 0.; i < n1; i++) {
+            part[1] += s->r[i] * s->z[i];
+            part[2] += s->r[i] * s->r[i];
+        }
+        pthread_barrier_wait (&s->bar);
+        rz1 = total (s, 1);
+        rr = total (s, 2);
+        beta = rz1 / rz;
+        rz = rz1;
+        for (i = n0; i < n1; i++) s->p[i] = s->z[i] + beta * s->p[i];
+    }
+    if (a->id == 0) {
+        s->iter = it;
+        s->rel = (bb > 0.) ? sqrt (rr / bb) : 0.;
+    }
+    return (NULL);
+}
+
+static int solve (struct SOLVE *s) {
+    pthread_t tid[MAXTHREAD];
+    struct ARG arg[MAXTHREAD];
+    int     i;
+
+    pthread_barrier_init (&s->bar, NULL, (unsigned)s->nthread);
+    for (i = 0; i < s->nthread; i++) {
+        arg[i].s = s;
+        arg[i].id = i;
+        if (pthread_create (&tid[i], NULL, pcg, &arg[i])) {
+            fprintf (stderr, "Failed to start thread %d\n", i);
+            return (1);
+        }
+    }
+    for (i = 0; i < s->nthread; i++) pthread_join (tid[i], NULL);
+    pthread_barrier_destroy (&s->bar);
+    return (0);
+}
+
+static double rms (struct SOLVE *s, double *v, size_t *nused) {
+
+    /* rms crossover difference left after taking out v (NULL for none) */
+
+    double  sum = 0., e;
+    size_t  k, n = 0;
+
+    for (k = 0; k < s->nx; k++) {
+        if (!s->used[k]) continue;
+        e = s->x[k].sha - s->x[k].shb - ((v == NULL) ? 0. : model (s, (long)k, v));
+        sum += e * e;
+        n++;
+    }
+    *nused = n;
+    return ((n > 0) ? sqrt (sum / n) : 0.);
+}
+
+struct APPLY {
+    struct CDR_ARCH *a;
+    struct SOLVE *s;
+    long    next;
+    pthread_mutex_t lock;
+    int     err;
+};
+
+static void *apply_work (void *arg) {
+
+    /* sh -= b + c tau and cor += b + c tau, pass by pass, in the map */
+
+    struct APPLY *w = (struct APPLY *)arg;
+    struct SOLVE *s = w->s;
+    struct CDR_PASS d;
+    struct CDR pt[APPLYBLOCK];
+    unsigned char *raw;
+    double  b, c, tm, hs, corr;
+    long    p, k0;
+    size_t  k, m;
+
+    for (;;) {
+        pthread_mutex_lock (&w->lock);
+        p = w->next++;
+        pthread_mutex_unlock (&w->lock);
+        if (p >= s->npass) break;
+        if (cdr_arch_pass (w->a, p, &d)) {
+            w->err = 1;
+            break;
+        }
+        b = s->u[s->nu * p];
+        c = (s->nu > 1) ? s->u[s->nu * p + 1] : 0.;
+        tm = 0.5 * (d.t0 + d.t1);
+        hs = (d.t1 > d.t0) ? 0.5 * (d.t1 - d.t0) : 1.;
+        raw = (unsigned char *)cdr_arch_raw (w->a, &d) + CDR_HEADSIZE;
+        for (k0 = 0; k0 < d.n; k0 += APPLYBLOCK) {
+            m = (d.n - k0 < APPLYBLOCK) ? (size_t)(d.n - k0) : APPLYBLOCK;
+            cdr_unpack (raw + k0 * CDR_PACKED, m, pt);
+            for (k = 0; k < m; k++) {
+                corr = b + c * (pt[k].time_1 - tm) / hs;
+                pt[k].sh = (float)(pt[k].sh - corr);
+                pt[k].cor = (float)(pt[k].cor + corr);
+            }
+            cdr_pack (pt, m, raw + k0 * CDR_PACKED);
+        }
+    }
+    return (NULL);
+}
+
+int main (int argc, char **argv) {
+
+    struct SOLVE s;
+    struct CDR_ARCH a;
+    struct CDR_PASS d;
+    struct APPLY w;
+    struct timespec c0, c1;
+    pthread_t tid[MAXTHREAD];
+    char    *xname = NULL;
+    double  *t0, *t1, edit = 0., r0, r1, tm, hs, e;
+    long    p, *fill, *ncross;
+    size_t  k, n0, n1, nedit;
+    int     c, i, bad = 0, update = 0, round;
+
+    memset (&s, 0, sizeof (s));
+    memset (&w, 0, sizeof (w));
+    s.nu = 1;
+    s.damp = 1.e-4;
+    s.tol = 1.e-8;
+    s.maxit = 1000;
+    s.nthread = (int)sysconf (_SC_NPROCESSORS_ONLN);
+    while ((c = getopt (argc, argv, "d:e:i:j:tux:")) != -1) {
+        switch (c) {
+            case 'd':   /* damping */
+                s.damp = atof (optarg);
+                break;
+            case 'e':   /* edit at this many rms */
+                edit = atof (optarg);
+                break;
+            case 'i':   /* most iterations */
+                s.maxit = atoi (optarg);
+                break;
+            case 'j':   /* threads */
+                s.nthread = atoi (optarg);
+                break;
+            case 't':   /* tilts too */
+                s.nu = NU;
+                break;
+            case 'u':   /* update the archive */
+                update = 1;
+                break;
+            case 'x':   /* crossovers */
+                xname = optarg;
+                break;
+            default:
+                bad = 1;
+                break;
+        }
+    }
+    if (bad || argc - optind != 1 || xname == NULL || !(s.damp > 0.) || edit < 0. || s.maxit < 1) {
+        fprintf (stderr, "usage: xadjust -x crossovers.xo [-t] [-e nrms] [-d damp] [-i maxit] [-j nthreads] [-u] archive.cda > adjust.txt\n");
+        fprintf (stderr, "\t-x  crossovers of the archive, from xover\n");
+        fprintf (stderr, "\t-t  solve for a tilt along each pass as well as a bias\n");
+        fprintf (stderr, "\t-e  leave out crossovers with residuals over this many rms and solve again (default keep all)\n");
+        fprintf (stderr, "\t-d  damping of each unknown, m^-2 in crossover units (default 1e-4)\n");
+        fprintf (stderr, "\t-i  most conjugate gradient iterations (default 1000)\n");
+        fprintf (stderr, "\t-j  threads (default one per online CPU)\n");
+        fprintf (stderr, "\t-u  take the corrections out of the archive's sh, and add them to cor, in place\n");
+        fprintf (stderr, "\tPrints pass id, bias (m), tilt (m at the pass ends) and crossovers used, per pass.\n");
+        exit (EXIT_FAILURE);
+    }
+    if (s.nthread < 1) s.nthread = 1;
+    if (s.nthread > MAXTHREAD) s.nthread = MAXTHREAD;
+    clock_gettime (CLOCK_MONOTONIC, &c0);
+
+    /* passes, crossovers and the crossovers of each pass */
+    if ((update) ? cdr_arch_open_rw (&a, argv[optind]) : cdr_arch_open (&a, argv[optind])) exit (EXIT_FAILURE);
+    if ((s.x = xo_read (xname, &s.nx)) == NULL) exit (EXIT_FAILURE);
+    s.npass = a.npass;
+    t0 = (double *) malloc ((s.npass + 1) * sizeof (double));
+    t1 = (double *) malloc ((s.npass + 1) * sizeof (double));
+    s.start = (long *) calloc (s.npass + 2, sizeof (long));
+    fill = (long *) malloc ((s.npass + 1) * sizeof (long));
+    ncross = (long *) calloc (s.npass + 1, sizeof (long));
+    s.item = (long *) malloc ((2 * s.nx + 1) * sizeof (long));
+    s.tau = (double *) malloc ((2 * s.nx + 1) * sizeof (double));
+    s.used = (char *) malloc (s.nx + 1);
+    s.u = (double *) calloc (s.nu * s.npass + 1, sizeof (double));
+    s.r = (double *) malloc ((s.nu * s.npass + 1) * sizeof (double));
+    s.z = (double *) malloc ((s.nu * s.npass + 1) * sizeof (double));
+    s.p = (double *) malloc ((s.nu * s.npass + 1) * sizeof (double));
+    s.q = (double *) malloc ((s.nu * s.npass + 1) * sizeof (double));
+    s.rhs = (double *) malloc ((s.nu * s.npass + 1) * sizeof (double));
+    s.minv = (double *) malloc ((s.nu * s.nu * s.npass + 1) * sizeof (double));
+    s.part = (double *) malloc (4 * s.nthread * sizeof (double));
+    if (t0 == NULL || t1 == NULL || s.start == NULL || fill == NULL || ncross == NULL || s.item == NULL || s.tau == NULL || s.used == NULL
+        || s.u == NULL || s.r == NULL || s.z == NULL || s.p == NULL || s.q == NULL || s.rhs == NULL || s.minv == NULL || s.part == NULL) {
+        fprintf (stderr, "Failed to malloc for %ld passes and %lu crossovers\n", s.npass, (unsigned long)s.nx);
+        exit (EXIT_FAILURE);
+    }
+    for (p = 0; p < s.npass; p++) {
+        if (cdr_arch_pass (&a, p, &d)) exit (EXIT_FAILURE);
+        t0[p] = d.t0;
+        t1[p] = d.t1;
+    }
+    for (k = 0; k < s.nx; k++) {
+        if (s.x[k].ida < 0 || s.x[k].ida >= s.npass || s.x[k].idb < 0 || s.x[k].idb >= s.npass) {
+            fprintf (stderr, "Failed: crossover %lu names a pass not in %s; were the crossovers found in this archive?\n", (unsigned long)k, argv[optind]);
+            exit (EXIT_FAILURE);
+        }
+        s.start[s.x[k].ida + 1]++;
+        s.start[s.x[k].idb + 1]++;
+        for (i = 0; i < 2; i++) {
+            p = (i) ? s.x[k].idb : s.x[k].ida;
+            tm = 0.5 * (t0[p] + t1[p]);
+            hs = (t1[p] > t0[p]) ? 0.5 * (t1[p] - t0[p]) : 1.;
+            s.tau[2 * k + i] = (((i) ? s.x[k].tb : s.x[k].ta) - tm) / hs;
+        }
+        s.used[k] = 1;
+    }
+    for (p = 0; p < s.npass; p++) s.start[p+1] += s.start[p];
+    memcpy (fill, s.start, s.npass * sizeof (long));
+    for (k = 0; k < s.nx; k++) {
+        s.item[fill[s.x[k].ida]++] = 2 * (long)k;
+        s.item[fill[s.x[k].idb]++] = 2 * (long)k + 1;
+    }
+
+    /* solve, and with -e edit and solve again */
+    r0 = rms (&s, NULL, &n0);
+    for (round = 0; ; round++) {
+        if (solve (&s)) exit (EXIT_FAILURE);
+        r1 = rms (&s, s.u, &n1);
+        fprintf (stderr, "xadjust: %lu crossovers, rms %.4f m before and %.4f m after, in %d iterations (relative residual %.1e).\n",
+            (unsigned long)n1, r0, r1, s.iter, s.rel);
+        if (edit == 0. || round == EDITS) break;
+        for (k = 0, nedit = 0; k < s.nx; k++) {
+            e = fabs (s.x[k].sha - s.x[k].shb - model (&s, (long)k, s.u));
+            if (s.used[k] && e > edit * r1) {
+                s.used[k] = 0;
+                nedit++;
+            }
+        }
+        if (nedit == 0) break;
+        r0 = rms (&s, NULL, &n0);
+    }
+
+    for (k = 0; k < s.nx; k++) {
+        if (!s.used[k]) continue;
+        ncross[s.x[k].ida]++;
+        ncross[s.x[k].idb]++;
+    }
+    for (p = 0; p < s.npass; p++) printf ("%ld %.4f %.4f %ld\n", p, s.u[s.nu * p], (s.nu > 1) ? s.u[s.nu * p + 1] : 0., ncross[p]);
+
+    /* take the corrections out of the archive */
+    if (update) {
+        w.a = &a;
+        w.s = &s;
+        pthread_mutex_init (&w.lock, NULL);
+        for (i = 0; i < s.nthread; i++) {
+            if (pthread_create (&tid[i], NULL, apply_work, &w)) {
+                fprintf (stderr, "Failed to start thread %d\n", i);
+                exit (EXIT_FAILURE);
+            }
+        }
+        for (i = 0; i < s.nthread; i++) pthread_join (tid[i], NULL);
+    }
+    if (cdr_arch_close (&a)) w.err = 1;
+    clock_gettime (CLOCK_MONOTONIC, &c1);
+    fprintf (stderr, "xadjust: %ld passes%s with %d threads in %.2f s.\n", s.npass, (update) ? " adjusted in place" : "",
+        s.nthread, (c1.tv_sec - c0.tv_sec) + 1.e-9 * (c1.tv_nsec - c0.tv_nsec));
+    exit ((update && w.err) ? EXIT_FAILURE : EXIT_SUCCESS);
+}
@@ -0,0 +1,513 @@
+/*  xover.c
+
+ Stage 04: find the crossovers between the ascending and the descending
+ passes of a CDR archive (cdr_arch.h) and write them as xover.h records,
+ with time and sh interpolated to the crossing on both passes.
+
+ Every pass is cut into chunks of NSEG segments with a time span and a
+ lat/lon box, and each chunk is listed in the cells of a lat/lon grid that
+ its box touches, ascending and descending apart.  A cell then only pairs
+ its ascending chunks with its descending ones, and a pair whose boxes
+ overlap is handled only in the cell holding the south-west corner of the
+ overlap, so no pair is tried twice and the work grows with the number of
+ crossings rather than with the square of the number of passes.  The
+ segments of a pair are intersected in a plane tangent at the first
+ point, with lon scaled by cos(lat), or poleward of POLAR in the
+ azimuthal equidistant plane about the pole; a crossing counts for a segment from
+ its start up to but not including its end, so a crossing at a point is
+ found once.  Segments across a gap in the pass are not used.
+
+ Passes are chunked, and then cells searched, by a pool of threads; the
+ crossovers are sorted by pass ids and time, so the output does not
+ depend on the number of threads.  Only the chunk boxes (48 bytes
+ per NSEG points) are held in memory; the points are read from the map
+ of the archive as pairs need them.
+ */
+
+#define _XOPEN_SOURCE 600   /* M_PI */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include "cdr.h"
+#include "cdr_arch.h"
+#include "xover.h"
+
+#define NSEG        32          /* segments per chunk */
+#define GAPX        2.5         /* a step longer than this many idt is a gap */
+#define CELLBATCH   16          /* cells taken by a thread at a time */
+#define MAXTHREAD   256
+#define POLAR       60.         /* deg; segments wholly poleward use the polar plane */
+#define D2R         (M_PI / 180.)
+
+/* Segments k0 .. k0+n-1 of a pass, between its points k0 .. k0+n */
+struct CHUNK {
+    double  t0, t1;
+    float   south, north;
+    float   west, span;         /* deg: west 0 to 360, the box runs span degrees east */
+    float   gap;                /* longest step that is a segment, s */
+    int     pass, k0, n;
+};
+
+/* Chunks listed by cell, for ascending (0) and descending (1) passes */
+struct GRID {
+    double  cell;               /* deg */
+    int     nlat, nlon;
+    long    *start[2];          /* cell c lists list[s][start[s][c] .. start[s][c+1]-1] */
+    int     *list[2];
+};
+
+struct OUT {
+    struct XOVER *x;
+    size_t  n, cap;
+    long    npair;              /* chunk pairs intersected */
+};
+
+struct WORK {
+    struct CDR_ARCH *a;
+    struct CHUNK *chunk;
+    long    *first;             /* chunks of pass p from first[p] */
+    int     *side;              /* 0 ascending, 1 descending, -1 unused, by pass */
+    struct GRID g;
+    double  maxdt;              /* -T, s; 0 for any */
+    long    next, nitem;        /* passes, then cells, taken so far and in all */
+    pthread_mutex_t lock;
+    struct OUT *out;
+    int     nthread, err;
+};
+
+struct ARG {
+    struct WORK *w;
+    int     id;
+};
+
+static double wrap (double x) {
+
+    /* x to 0 - 360 */
+
+    while (x < 0.) x += 360.;
+    while (x >= 360.) x -= 360.;
+    return (x);
+}
+
+static double wrap180 (double x) {
+    while (x > 180.) x -= 360.;
+    while (x < -180.) x += 360.;
+    return (x);
+}
+
+static int row (struct GRID *g, double lat) {
+    int     i = (int)floor ((lat + 90.) / g->cell);
+
+    return ((i < 0) ? 0 : (i >= g->nlat) ? g->nlat - 1 : i);
+}
+
+static int col (struct GRID *g, double lon) {
+    int     j = (int)floor (wrap (lon) / g->cell);
+
+    return ((j >= g->nlon) ? g->nlon - 1 : j);
+}
+
+static long take (struct WORK *w, long batch) {
+
+    /* The first of the next batch of items for a thread, or nitem when
+       they are gone */
+
+    long    i;
+
+    pthread_mutex_lock (&w->lock);
+    i = w->next;
+    w->next += batch;
+    pthread_mutex_unlock (&w->lock);
+    return ((i < w->nitem) ? i : w->nitem);
+}
+
+static void chunk_pass (struct WORK *w, long p) {
+
+    /* The chunks of pass p */
+
+    struct CDR_PASS d;
+    struct CDR pt[NSEG + 1];
+    struct CHUNK *c;
+    const unsigned char *raw;
+    double  u, lo, hi;
+    long    k0;
+    int     k, n;
+
+    if (cdr_arch_pass (w->a, p, &d)) {
+        w->err = 1;
+        return;
+    }
+    raw = cdr_arch_raw (w->a, &d) + CDR_HEADSIZE;
+    for (k0 = 0, c = &w->chunk[w->first[p]]; k0 < d.n - 1; k0 += NSEG, c++) {
+        n = (d.n - 1 - k0 < NSEG) ? (int)(d.n - 1 - k0) : NSEG;
+        cdr_unpack (raw + k0 * CDR_PACKED, (size_t)n + 1, pt);
+        c->pass = (int)p;
+        c->k0 = (int)k0;
+        c->n = n;
+        c->gap = (float)(GAPX * 1.e-3 * d.idt);
+        c->t0 = c->t1 = pt[0].time_1;
+        c->south = c->north = pt[0].lat;
+        u = lo = hi = pt[0].lon;
+        for (k = 1; k <= n; k++) {
+            if (pt[k].time_1 < c->t0) c->t0 = pt[k].time_1;
+            if (pt[k].time_1 > c->t1) c->t1 = pt[k].time_1;
+            if (pt[k].lat < c->south) c->south = pt[k].lat;
+            if (pt[k].lat > c->north) c->north = pt[k].lat;
+            u += wrap180 (pt[k].lon - pt[k-1].lon);
+            if (u < lo) lo = u;
+            if (u > hi) hi = u;
+        }
+        c->west = (float)wrap (lo);
+        c->span = (float)((hi - lo < 360.) ? hi - lo : 360.);
+    }
+}
+
+static void *chunk_work (void *arg) {
+    struct WORK *w = (struct WORK *)arg;
+    long    p;
+
+    while ((p = take (w, 1)) < w->nitem) {
+        if (w->side[p] >= 0) chunk_pass (w, p);
+    }
+    return (NULL);
+}
+
+static int add_xover (struct OUT *o, struct XOVER *x) {
+    struct XOVER *nx;
+
+    if (o->n == o->cap) {
+        o->cap = (o->cap) ? 2 * o->cap : 4096;
+        if ((nx = (struct XOVER *) realloc (o->x, o->cap * sizeof (*nx))) == NULL) {
+            fprintf (stderr, "Failed to realloc crossovers\n");
+            return (1);
+        }
+        o->x = nx;
+    }
+    o->x[o->n++] = *x;
+    return (0);
+}
+
+static void plane (struct CDR *p, struct CDR *p0, double cl, int polar, double *x, double *y) {
+
+    /* p on the plane of a segment starting at p0: tangent at p0 with lon
+       scaled by cl = cos(lat), or near a pole azimuthal equidistant about
+       it, where lon changes too fast along a segment for the tangent plane */
+
+    double  r;
+
+    if (polar) {
+        r = 90. - fabs (p->lat);
+        *x = r * cos (D2R * p->lon);
+        *y = r * sin (D2R * p->lon);
+        return;
+    }
+    *x = wrap180 (p->lon - p0->lon) * cl;
+    *y = p->lat - p0->lat;
+}
+
+static int cross (struct WORK *w, struct CHUNK *ca, struct CHUNK *cb, struct OUT *o) {
+
+    /* Intersect the segments of an ascending and a descending chunk */
+
+    struct CDR_PASS da, db;
+    struct CDR a[NSEG + 1], b[NSEG + 1];
+    struct XOVER x;
+    double  cl, ax, ay, bx, by, ex, ey, den, s, t, px, py;
+    float   alo, ahi, blo, bhi;
+    int     i, j, polar;
+
+    if (cdr_arch_pass (w->a, ca->pass, &da) || cdr_arch_pass (w->a, cb->pass, &db)) return (1);
+    cdr_unpack (cdr_arch_raw (w->a, &da) + CDR_HEADSIZE + ca->k0 * CDR_PACKED, (size_t)ca->n + 1, a);
+    cdr_unpack (cdr_arch_raw (w->a, &db) + CDR_HEADSIZE + cb->k0 * CDR_PACKED, (size_t)cb->n + 1, b);
+    o->npair++;
+    for (i = 0; i < ca->n; i++) {
+        if (a[i+1].time_1 - a[i].time_1 > ca->gap) continue;
+        alo = (a[i].lat < a[i+1].lat) ? a[i].lat : a[i+1].lat;
+        ahi = (a[i].lat < a[i+1].lat) ? a[i+1].lat : a[i].lat;
+        if (ahi < cb->south || alo > cb->north) continue;
+        polar = (alo > POLAR || ahi < -POLAR);
+        cl = cos (D2R * a[i].lat);
+        plane (&a[i], &a[i], cl, polar, &px, &py);
+        plane (&a[i+1], &a[i], cl, polar, &ax, &ay);
+        ax -= px;
+        ay -= py;
+        for (j = 0; j < cb->n; j++) {
+            blo = (b[j].lat < b[j+1].lat) ? b[j].lat : b[j+1].lat;
+            bhi = (b[j].lat < b[j+1].lat) ? b[j+1].lat : b[j].lat;
+            if (bhi < alo || blo > ahi || b[j+1].time_1 - b[j].time_1 > cb->gap) continue;
+            plane (&b[j], &a[i], cl, polar, &bx, &by);
+            plane (&b[j+1], &a[i], cl, polar, &ex, &ey);
+            ex -= bx;
+            ey -= by;
+            bx -= px;
+            by -= py;
+            if ((den = ax * ey - ay * ex) == 0.) continue;
+            s = (bx * ey - by * ex) / den;
+            t = (bx * ay - by * ax) / den;
+            if (s < 0. || s >= 1. || t < 0. || t >= 1.) continue;
+            if (w->maxdt > 0. && fabs (b[j].time_1 - a[i].time_1) > w->maxdt) continue;
+            if (polar) {
+                x.lat = (float)((90. - hypot (px + s * ax, py + s * ay)) * ((a[i].lat > 0.) ? 1. : -1.));
+                x.lon = (float)wrap (atan2 (py + s * ay, px + s * ax) / D2R);
+            }
+            else {
+                x.lat = (float)(a[i].lat + s * ay);
+                x.lon = (float)wrap (a[i].lon + s * wrap180 (a[i+1].lon - a[i].lon));
+            }
+            x.ta = a[i].time_1 + s * (a[i+1].time_1 - a[i].time_1);
+            x.tb = b[j].time_1 + t * (b[j+1].time_1 - b[j].time_1);
+            x.sha = (float)(a[i].sh + s * (a[i+1].sh - a[i].sh));
+            x.shb = (float)(b[j].sh + t * (b[j+1].sh - b[j].sh));
+            x.ida = ca->pass;
+            x.idb = cb->pass;
+            if (add_xover (o, &x)) return (1);
+        }
+    }
+    return (0);
+}
+
+static int in_arc (double lon, double start, double len) {
+    /* lon (deg) lies within len degrees east of start */
+    return (wrap (lon - start) <= len);
+}
+
+static int search_cell (struct WORK *w, long c, struct OUT *o) {
+
+    /* Cross the ascending chunks of cell c with its descending ones */
+
+    struct GRID *g = &w->g;
+    struct CHUNK *ca, *cb;
+    double  corner;
+    long    i, j;
+    int     r = (int)(c / g->nlon), k = (int)(c % g->nlon);
+
+    for (i = g->start[0][c]; i < g->start[0][c+1]; i++) {
+        ca = &w->chunk[g->list[0][i]];
+        for (j = g->start[1][c]; j < g->start[1][c+1]; j++) {
+            cb = &w->chunk[g->list[1][j]];
+            if (ca->north < cb->south || ca->south > cb->north) continue;
+            if (w->maxdt > 0. && (ca->t0 - cb->t1 > w->maxdt || cb->t0 - ca->t1 > w->maxdt)) continue;
+            if (in_arc (cb->west, ca->west, ca->span)) corner = cb->west;
+            else if (in_arc (ca->west, cb->west, cb->span)) corner = ca->west;
+            else continue;
+            if (row (g, (ca->south > cb->south) ? ca->south : cb->south) != r || col (g, corner) != k) continue;
+            if (cross (w, ca, cb, o)) return (1);
+        }
+    }
+    return (0);
+}
+
+static void *cell_work (void *arg) {
+    struct ARG *a = (struct ARG *)arg;
+    struct WORK *w = a->w;
+    long    c, c1;
+
+    while ((c = take (w, CELLBATCH)) < w->nitem) {
+        for (c1 = (c + CELLBATCH < w->nitem) ? c + CELLBATCH : w->nitem; c < c1; c++) {
+            if (search_cell (w, c, &w->out[a->id])) {
+                w->err = 1;
+                return (NULL);
+            }
+        }
+    }
+    return (NULL);
+}
+
+static int bin_chunks (struct WORK *w, long nchunk) {
+
+    /* List each chunk in the cells its box touches: count, then fill */
+
+    struct GRID *g = &w->g;
+    struct CHUNK *c;
+    long    i, ncell = (long)g->nlat * g->nlon, *fill[2];
+    int     pass, s, r, r0, r1, k, k0, nk;
+
+    for (s = 0; s < 2; s++) {
+        g->start[s] = (long *) calloc (ncell + 1, sizeof (long));
+        fill[s] = (long *) calloc (ncell + 1, sizeof (long));
+        if (g->start[s] == NULL || fill[s] == NULL) {
+            fprintf (stderr, "Failed to malloc a grid of %ld cells\n", ncell);
+            return (1);
+        }
+    }
+    for (pass = 0; pass < 2; pass++) {
+        for (i = 0, c = w->chunk; i < nchunk; i++, c++) {
+            if ((s = w->side[c->pass]) < 0) continue;
+            r0 = row (g, c->south);
+            r1 = row (g, c->north);
+            k0 = col (g, c->west);
+            nk = col (g, c->west + c->span) - k0;
+            if (nk < 0) nk += g->nlon;
+            if (c->span >= 360. - g->cell) {
+                k0 = 0;
+                nk = g->nlon - 1;
+            }
+            for (r = r0; r <= r1; r++) {
+                for (k = 0; k <= nk; k++) {
+                    if (pass == 0) g->start[s][(long)r * g->nlon + (k0 + k) % g->nlon + 1]++;
+                    else g->list[s][fill[s][(long)r * g->nlon + (k0 + k) % g->nlon]++] = (int)i;
+                }
+            }
+        }
+        if (pass == 1) break;
+        for (s = 0; s < 2; s++) {
+            for (i = 0; i < ncell; i++) g->start[s][i+1] += g->start[s][i];
+            memcpy (fill[s], g->start[s], ncell * sizeof (long));
+            if ((g->list[s] = (int *) malloc ((g->start[s][ncell] + 1) * sizeof (int))) == NULL) {
+                fprintf (stderr, "Failed to malloc %ld cell entries\n", g->start[s][ncell]);
+                return (1);
+            }
+        }
+    }
+    free ( (void *)fill[0]);
+    free ( (void *)fill[1]);
+    return (0);
+}
+
+static int by_pass (const void *p, const void *q) {
+    const struct XOVER *a = (const struct XOVER *)p, *b = (const struct XOVER *)q;
+
+    if (a->ida != b->ida) return ((a->ida < b->ida) ? -1 : 1);
+    if (a->idb != b->idb) return ((a->idb < b->idb) ? -1 : 1);
+    return ((a->ta < b->ta) ? -1 : (a->ta > b->ta) ? 1 : 0);
+}
+
+int main (int argc, char **argv) {
+
+    struct CDR_ARCH a;
+    struct CDR_PASS d;
+    struct WORK w;
+    struct ARG arg[MAXTHREAD];
+    struct XOVER *x;
+    struct timespec c0, c1;
+    pthread_t tid[MAXTHREAD];
+    char    *outname = NULL;
+    long    p, nchunk = 0, npair = 0;
+    size_t  n;
+    double  secs;
+    int     c, i, bad = 0, nthread;
+
+    memset (&w, 0, sizeof (w));
+    w.g.cell = 1.;
+    nthread = (int)sysconf (_SC_NPROCESSORS_ONLN);
+    while ((c = getopt (argc, argv, "c:j:o:T:")) != -1) {
+        switch (c) {
+            case 'c':   /* cell size, deg */
+                w.g.cell = atof (optarg);
+                break;
+            case 'j':   /* threads */
+                nthread = atoi (optarg);
+                break;
+            case 'o':   /* output */
+                outname = optarg;
+                break;
+            case 'T':   /* largest time between the passes, days */
+                w.maxdt = 86400. * atof (optarg);
+                break;
+            default:
+                bad = 1;
+                break;
+        }
+    }
+    if (bad || argc - optind != 1 || outname == NULL || !(w.g.cell >= 0.01 && w.g.cell <= 90.) || w.maxdt < 0.) {
+        fprintf (stderr, "usage: xover -o out.xo [-c cell] [-T days] [-j nthreads] archive.cda\n");
+        fprintf (stderr, "\t-o  write the crossovers here (xover.h)\n");
+        fprintf (stderr, "\t-c  search cell size, deg (default 1)\n");
+        fprintf (stderr, "\t-T  only crossings less than this many days apart (default any)\n");
+        fprintf (stderr, "\t-j  threads (default one per online CPU)\n");
+        fprintf (stderr, "\tThe archive's passes with iasc 1 are crossed with those with iasc 0.\n");
+        exit (EXIT_FAILURE);
+    }
+    if (nthread < 1) nthread = 1;
+    if (nthread > MAXTHREAD) nthread = MAXTHREAD;
+    w.nthread = nthread;
+    clock_gettime (CLOCK_MONOTONIC, &c0);
+
+    /* chunk counts from the directory, then the chunks themselves */
+    if (cdr_arch_open (&a, argv[optind])) exit (EXIT_FAILURE);
+    w.a = &a;
+    w.first = (long *) malloc ((a.npass + 1) * sizeof (long));
+    w.side = (int *) malloc ((a.npass + 1) * sizeof (int));
+    if (w.first == NULL || w.side == NULL) {
+        fprintf (stderr, "Failed to malloc %ld passes\n", a.npass);
+        exit (EXIT_FAILURE);
+    }
+    for (p = 0; p < a.npass; p++) {
+        if (cdr_arch_pass (&a, p, &d)) exit (EXIT_FAILURE);
+        w.first[p] = nchunk;
+        w.side[p] = (d.iasc == 1) ? 0 : (d.iasc == 0) ? 1 : -1;
+        if (w.side[p] >= 0 && d.n > 1) nchunk += (d.n - 1 + NSEG - 1) / NSEG;
+        else w.side[p] = -1;
+    }
+    if ((w.chunk = (struct CHUNK *) malloc ((nchunk + 1) * sizeof (struct CHUNK))) == NULL) {
+        fprintf (stderr, "Failed to malloc %ld chunks\n", nchunk);
+        exit (EXIT_FAILURE);
+    }
+    pthread_mutex_init (&w.lock, NULL);
+    w.nitem = a.npass;
+    for (i = 0; i < nthread; i++) {
+        if (pthread_create (&tid[i], NULL, chunk_work, &w)) {
+            fprintf (stderr, "Failed to start thread %d\n", i);
+            exit (EXIT_FAILURE);
+        }
+    }
+    for (i = 0; i < nthread; i++) pthread_join (tid[i], NULL);
+    if (w.err) exit (EXIT_FAILURE);
+
+    /* the grid, then the cells searched */
+    w.g.nlat = (int)ceil (180. / w.g.cell);
+    w.g.nlon = (int)ceil (360. / w.g.cell);
+    if (bin_chunks (&w, nchunk)) exit (EXIT_FAILURE);
+    if ((w.out = (struct OUT *) calloc (nthread, sizeof (struct OUT))) == NULL) {
+        fprintf (stderr, "Failed to malloc thread outputs\n");
+        exit (EXIT_FAILURE);
+    }
+    w.next = 0;
+    w.nitem = (long)w.g.nlat * w.g.nlon;
+    for (i = 0; i < nthread; i++) {
+        arg[i].w = &w;
+        arg[i].id = i;
+        if (pthread_create (&tid[i], NULL, cell_work, &arg[i])) {
+            fprintf (stderr, "Failed to start thread %d\n", i);
+            exit (EXIT_FAILURE);
+        }
+    }
+    for (i = 0; i < nthread; i++) pthread_join (tid[i], NULL);
+    if (w.err) exit (EXIT_FAILURE);
+
+    /* gather, sort and write */
+    for (i = 0, n = 0; i < nthread; i++) n += w.out[i].n;
+    if ((x = (struct XOVER *) malloc ((n + 1) * sizeof (struct XOVER))) == NULL) {
+        fprintf (stderr, "Failed to malloc %lu crossovers\n", (unsigned long)n);
+        exit (EXIT_FAILURE);
+    }
+    for (i = 0, n = 0; i < nthread; i++) {
+        memcpy (x + n, w.out[i].x, w.out[i].n * sizeof (struct XOVER));
+        n += w.out[i].n;
+        npair += w.out[i].npair;
+        free ( (void *)w.out[i].x);
+    }
+    qsort (x, n, sizeof (struct XOVER), by_pass);
+    if (xo_write (outname, x, n)) exit (EXIT_FAILURE);
+    clock_gettime (CLOCK_MONOTONIC, &c1);
+    secs = (c1.tv_sec - c0.tv_sec) + 1.e-9 * (c1.tv_nsec - c0.tv_nsec);
+
+    fprintf (stderr, "xover found %lu crossovers between %ld passes (%ld chunks, %ld pairs tried) with %d threads in %.2f s.\n",
+        (unsigned long)n, a.npass, nchunk, npair, nthread, secs);
+    free ( (void *)x);
+    free ( (void *)w.out);
+    free ( (void *)w.chunk);
+    free ( (void *)w.first);
+    free ( (void *)w.side);
+    for (i = 0; i < 2; i++) {
+        free ( (void *)w.g.start[i]);
+        free ( (void *)w.g.list[i]);
+    }
+    cdr_arch_close (&a);
+    exit (EXIT_SUCCESS);
+}
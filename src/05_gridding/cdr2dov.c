@@ -0,0 +1,750 @@
+/*  cdr2dov.c
+
+ Stage 05: grid the along-track slopes (dsh) of a CDR archive (cdr_arch.h)
+ into north and east vertical deflection on a regular lat/lon grid
+ (fgrid.h), the step from the CDRs toward gravity and its vertical
+ gradient.
+
+ A slope measured along azimuth az (clockwise from north) sees the
+ deflection as
+
+   dsh = -(xi cos(az) + eta sin(az))
+
+ xi north and eta east, in microradians like dsh.  Each slope is taken at
+ its point by bilinear interpolation between the four grid nodes around
+ it, and a membrane penalty smooth * (difference)^2 between neighbouring
+ nodes, in metres along the ground, fills the space between the tracks.
+ The normal equations of that couple each node only with its eight
+ neighbours, so they are kept as a 3 x 3 stencil of 2 x 2 blocks per node
+ and solved by conjugate gradients preconditioned by each node's own block.
+
+ The grid is solved a tile at a time.  A tile is -T x -T nodes; it is
+ solved over a domain reaching -H nodes further on every side (and
+ around through 0 deg on a global grid), with every slope in that domain,
+ and only its own nodes are kept.  The penalty reaches across gaps
+ between tracks, so the halo must span a few of them for the tiles to
+ meet without visible steps: with tracks 10' apart on a 1' grid, a halo
+ of 12 nodes left steps of 2.5 microradians and one of 40 (the default)
+ 0.16.  The
+ slopes are streamed from the archive once into a scratch file for each
+ row of tiles (a band), those near a band edge into both bands; then the
+ bands are taken one at a time and their tiles solved by a pool of
+ threads, each band's rows written to the grid as it finishes.  Memory is
+ one band's slopes and rows plus a domain's equations per thread, so a
+ global one arc minute grid is built without the globe in memory.  A
+ node with no slope within -M nodes is left NaN.
+ */
+
+#define _XOPEN_SOURCE 600   /* M_PI, NAN */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include "cdr.h"
+#include "cdr_arch.h"
+#include "fgrid.h"
+
+#define GAPX        2.5         /* a step longer than this many idt is a gap */
+#define MAXTHREAD   256
+#define OBSBUF      4096        /* slopes buffered per band before a write */
+#define MINCOS      0.1         /* floor on cos(lat) in the east-west penalty */
+#define DAMP        1.e-6       /* on every node, so an empty domain still solves */
+#define D2R         (M_PI / 180.)
+
+/* A slope: dsh at a point and the azimuth it is measured along */
+struct OBS {
+    float   lat, lon;           /* deg */
+    float   s;                  /* dsh, microradians */
+    float   az;                 /* radians clockwise from north */
+};
+
+/* The nodes a tile solves over: rows r0 .. r0+nr-1, columns c0 .. c0+nc-1
+   (mod nx on a global grid), of which it keeps rows j0 .. j0+th-1 and
+   columns i0 .. i0+tw-1 */
+struct DOM {
+    int     r0, nr, c0, nc;
+    int     j0, th, i0, tw;
+};
+
+struct WORK {
+    struct FGRID_HEAD h;
+    int     tile, halo, mask;
+    int     nband, ntcol;       /* tiles down and across */
+    double  smooth, tol;
+    int     maxit, nthread;
+    struct OBS *obs;            /* this band's slopes */
+    long    *start;             /* tile column c: obs[list[start[c] .. start[c+1]-1]] */
+    long    *list;
+    int     band;
+    float   *out;               /* 2 planes of the band's rows, nx a row */
+    long    next;
+    long    iter, nsolved, nslow, nempty;
+    pthread_mutex_t lock;
+    int     err;
+};
+
+static double wrap (double lon) {
+
+    /* 0 <= lon < 360 */
+
+    lon = fmod (lon, 360.);
+    if (lon < 0.) lon += 360.;
+    return ((lon >= 360.) ? 0. : lon);
+}
+
+static void domain (struct WORK *w, int b, int c, struct DOM *d) {
+    int     ny = w->h.ny, nx = w->h.nx;
+
+    d->j0 = b * w->tile;
+    d->th = (ny - d->j0 < w->tile) ? ny - d->j0 : w->tile;
+    d->r0 = (d->j0 - w->halo < 0) ? 0 : d->j0 - w->halo;
+    d->nr = ((d->j0 + d->th + w->halo > ny) ? ny : d->j0 + d->th + w->halo) - d->r0;
+    d->i0 = c * w->tile;
+    d->tw = (nx - d->i0 < w->tile) ? nx - d->i0 : w->tile;
+    if (w->h.global) {
+        d->c0 = d->i0 - w->halo;
+        d->nc = d->tw + 2 * w->halo;
+    }
+    else {
+        d->c0 = (d->i0 - w->halo < 0) ? 0 : d->i0 - w->halo;
+        d->nc = ((d->i0 + d->tw + w->halo > nx) ? nx : d->i0 + d->tw + w->halo) - d->c0;
+    }
+}
+
+static int cell (struct WORK *w, struct OBS *o, int *i, int *j, double *fx, double *fy) {
+
+    /* The grid cell holding o, its south-west node (i, j) and o's place in
+       it; 0 when o is off the grid */
+
+    double  x, y;
+
+    y = (o->lat - w->h.south) / w->h.dy;
+    x = wrap (o->lon - w->h.west) / w->h.dx;
+    if (!(y >= 0.) || !(x >= 0.)) return (0);
+    *j = (int)y;
+    *i = (int)x;
+    if (*j >= w->h.ny - 1) return (0);
+    if (w->h.global) {
+        if (*i >= w->h.nx) *i = w->h.nx - 1;
+    }
+    else if (*i >= w->h.nx - 1) return (0);
+    *fx = x - *i;
+    *fy = y - *j;
+    return (1);
+}
+
+static int local_col (struct WORK *w, struct DOM *d, int i) {
+
+    /* Column i of the grid as a column of the domain, -1 when outside */
+
+    int     k = i - d->c0;
+
+    if (w->h.global) k = ((k % w->h.nx) + w->h.nx) % w->h.nx;
+    return ((k >= 0 && k < d->nc) ? k : -1);
+}
+
+static int in_band (struct WORK *w, int b, int j) {
+
+    /* Whether the cell with south row j is wholly in band b's domains */
+
+    struct DOM d;
+
+    domain (w, b, 0, &d);
+    return (j >= d.r0 && j + 1 < d.r0 + d.nr);
+}
+
+static int in_tile (struct WORK *w, int c, int i) {
+
+    /* Whether the cell with west column i is wholly in tile column c's
+       domains */
+
+    struct DOM d;
+    int     k;
+
+    domain (w, 0, c, &d);
+    k = local_col (w, &d, i);
+    return (k >= 0 && k + 1 < d.nc);
+}
+
+/* The bands' scratch files, and a buffer of slopes for each */
+struct BANDS {
+    FILE    **fp;
+    struct OBS *buf;
+    int     *nbuf;
+    long    *n;
+    long    most;
+};
+
+static int flush_band (struct BANDS *s, int b) {
+    if (s->nbuf[b] && fwrite (s->buf + (size_t)b * OBSBUF, sizeof (struct OBS), s->nbuf[b], s->fp[b]) != (size_t)s->nbuf[b]) {
+        fprintf (stderr, "Failed to write band %d scratch\n", b);
+        return (1);
+    }
+    s->n[b] += s->nbuf[b];
+    s->nbuf[b] = 0;
+    return (0);
+}
+
+static int put_obs (struct WORK *w, struct BANDS *s, struct OBS *o) {
+
+    /* o into the scratch of every band whose domains hold it */
+
+    double  fx, fy;
+    int     i, j, b, b1;
+
+    if (!cell (w, o, &i, &j, &fx, &fy)) return (0);
+    b = (j - w->halo) / w->tile - 1;
+    b1 = (j + w->halo) / w->tile + 1;
+    for (b = (b < 0) ? 0 : b; b <= b1 && b < w->nband; b++) {
+        if (!in_band (w, b, j)) continue;
+        s->buf[(size_t)b * OBSBUF + s->nbuf[b]++] = *o;
+        if (s->nbuf[b] == OBSBUF && flush_band (s, b)) return (1);
+    }
+    return (0);
+}
+
+static double azimuth (struct CDR *a, struct CDR *b) {
+
+    /* Initial azimuth from a to b on the sphere, radians */
+
+    double  f1 = a->lat * D2R, f2 = b->lat * D2R, dl = (b->lon - a->lon) * D2R;
+
+    return (atan2 (sin (dl) * cos (f2), cos (f1) * sin (f2) - sin (f1) * cos (f2) * cos (dl)));
+}
+
+static int stream (struct WORK *w, struct CDR_ARCH *a, struct BANDS *s, long *nobs) {
+
+    /* Every slope of the archive, with its azimuth from the points either
+       side of it that are not across a gap, into the bands */
+
+    struct CDR_PASS d;
+    struct CDR *pt = NULL, *p0, *p1;
+    struct OBS o;
+    size_t  cap = 0;
+    double  gap;
+    long    p, k;
+
+    for (p = 0; p < a->npass; p++) {
+        if (cdr_arch_pass (a, p, &d)) return (1);
+        if (d.n < 2) continue;
+        if ((size_t)d.n > cap) {
+            cap = (size_t)d.n;
+            free ( (void *)pt);
+            if ((pt = (struct CDR *) malloc (cap * sizeof (struct CDR))) == NULL) {
+                fprintf (stderr, "Failed to malloc %ld points\n", d.n);
+                return (1);
+            }
+        }
+        cdr_unpack (cdr_arch_raw (a, &d) + CDR_HEADSIZE, (size_t)d.n, pt);
+        gap = (d.idt > 0) ? GAPX * 1.e-3 * d.idt : 1.e30;
+        for (k = 0; k < d.n; k++) {
+            p0 = (k > 0 && pt[k].time_1 - pt[k-1].time_1 <= gap) ? &pt[k-1] : &pt[k];
+            p1 = (k < d.n - 1 && pt[k+1].time_1 - pt[k].time_1 <= gap) ? &pt[k+1] : &pt[k];
+            if (p0 == p1 || pt[k].dsh != pt[k].dsh) continue;
+            o.lat = pt[k].lat;
+            o.lon = pt[k].lon;
+            o.s = pt[k].dsh;
+            o.az = (float)azimuth (p0, p1);
+            if (put_obs (w, s, &o)) {
+                free ( (void *)pt);
+                return (1);
+            }
+            (*nobs)++;
+        }
+    }
+    free ( (void *)pt);
+    return (0);
+}
+
+static int bin_band (struct WORK *w, long n) {
+
+    /* The band's slopes listed by tile column, a slope under every column
+       whose domains hold it */
+
+    double  fx, fy;
+    long    k, m;
+    int     i, j, c, pass, seen[8], nseen, q, ok;
+
+    memset (w->start, 0, (w->ntcol + 1) * sizeof (long));
+    for (pass = 0; pass < 2; pass++) {
+        for (k = 0; k < n; k++) {
+            cell (w, &w->obs[k], &i, &j, &fx, &fy);
+            for (c = i / w->tile - 2, nseen = 0; c <= i / w->tile + 2; c++) {
+                m = (w->h.global) ? ((c % w->ntcol) + w->ntcol) % w->ntcol : c;
+                if (m < 0 || m >= w->ntcol) continue;
+                for (q = 0, ok = 1; q < nseen; q++) if (seen[q] == (int)m) ok = 0;
+                if (!ok || !in_tile (w, (int)m, i)) continue;
+                seen[nseen++] = (int)m;
+                if (pass == 0) w->start[m+1]++;
+                else w->list[w->start[m]++] = k;
+            }
+        }
+        if (pass == 0) {
+            for (c = 0; c < w->ntcol; c++) w->start[c+1] += w->start[c];
+            free ( (void *)w->list);
+            if ((w->list = (long *) malloc ((w->start[w->ntcol] + 1) * sizeof (long))) == NULL) {
+                fprintf (stderr, "Failed to malloc a list of %ld slopes\n", w->start[w->ntcol]);
+                return (1);
+            }
+        }
+    }
+    for (c = w->ntcol; c > 0; c--) w->start[c] = w->start[c-1];
+    w->start[0] = 0;
+    return (0);
+}
+
+/* A thread's space for one domain's equations */
+struct SPACE {
+    double  *a;                 /* 9 blocks of 4 per node: neighbour (dr, dc) is block 3 (dr+1) + dc+1 */
+    double  *rhs, *v, *r, *z, *p, *q;   /* 2 per node: xi, eta */
+    double  *minv;              /* 4 per node */
+    long    *cnt;               /* slopes at or south-west of each node, summed */
+};
+
+static void accumulate (struct WORK *w, struct DOM *d, struct SPACE *sp, long c) {
+
+    /* The normal equations of the domain from its slopes and the penalty */
+
+    double  fx, fy, wt[4], g[2], ww, lam, cl;
+    long    k, n, na, nb;
+    int     i, j, lr, lc, e, f, m, ra, ca, rb, cb, blk;
+    long    nn = (long)d->nr * d->nc;
+
+    memset (sp->a, 0, nn * 36 * sizeof (double));
+    memset (sp->rhs, 0, nn * 2 * sizeof (double));
+    memset (sp->cnt, 0, nn * sizeof (long));
+    for (k = w->start[c]; k < w->start[c+1]; k++) {
+        struct OBS *o = &w->obs[w->list[k]];
+
+        if (!cell (w, o, &i, &j, &fx, &fy) || j < d->r0) continue;
+        lr = j - d->r0;
+        if ((lc = local_col (w, d, i)) < 0 || lr + 1 >= d->nr || lc + 1 >= d->nc) continue;
+        wt[0] = (1. - fx) * (1. - fy);
+        wt[1] = fx * (1. - fy);
+        wt[2] = (1. - fx) * fy;
+        wt[3] = fx * fy;
+        g[0] = cos (o->az);
+        g[1] = sin (o->az);
+        sp->cnt[(long)(lr + 1) * d->nc + lc + 1]++;
+        for (e = 0; e < 4; e++) {
+            ra = lr + (e >> 1);
+            ca = lc + (e & 1);
+            na = (long)ra * d->nc + ca;
+            for (m = 0; m < 2; m++) sp->rhs[2 * na + m] -= wt[e] * g[m] * o->s;
+            for (f = 0; f < 4; f++) {
+                rb = lr + (f >> 1);
+                cb = lc + (f & 1);
+                ww = wt[e] * wt[f];
+                blk = 3 * (rb - ra + 1) + cb - ca + 1;
+                n = (na * 9 + blk) * 4;
+                sp->a[n] += ww * g[0] * g[0];
+                sp->a[n+1] += ww * g[0] * g[1];
+                sp->a[n+2] += ww * g[1] * g[0];
+                sp->a[n+3] += ww * g[1] * g[1];
+            }
+        }
+    }
+
+    /* the penalty, per difference in metres: east-west differences span
+       cos(lat) of a north-south one */
+    for (lr = 0; lr < d->nr; lr++) {
+        cl = cos ((w->h.south + (d->r0 + lr) * w->h.dy) * D2R);
+        if (cl < MINCOS) cl = MINCOS;
+        for (lc = 0; lc < d->nc; lc++) {
+            na = (long)lr * d->nc + lc;
+            for (m = 0; m < 4; m += 3) sp->a[(na * 9 + 4) * 4 + m] += DAMP;
+            for (e = 0; e < 2; e++) {
+                if (e == 0 && lc + 1 < d->nc) {
+                    nb = na + 1;
+                    lam = w->smooth * (w->h.dy * w->h.dy) / (w->h.dx * w->h.dx * cl * cl);
+                    blk = 5;
+                }
+                else if (e == 1 && lr + 1 < d->nr) {
+                    nb = na + d->nc;
+                    lam = w->smooth;
+                    blk = 7;
+                }
+                else continue;
+                for (m = 0; m < 4; m += 3) {
+                    sp->a[(na * 9 + 4) * 4 + m] += lam;
+                    sp->a[(nb * 9 + 4) * 4 + m] += lam;
+                    sp->a[(na * 9 + blk) * 4 + m] -= lam;
+                    sp->a[(nb * 9 + 8 - blk) * 4 + m] -= lam;
+                }
+            }
+        }
+    }
+}
+
+static void product (struct DOM *d, struct SPACE *sp, double *v, double *out) {
+
+    /* out = (normal matrix) v over the domain */
+
+    double  *b;
+    long    na, nb;
+    int     lr, lc, dr, dc;
+
+    for (lr = 0; lr < d->nr; lr++) {
+        for (lc = 0; lc < d->nc; lc++) {
+            na = (long)lr * d->nc + lc;
+            out[2 * na] = out[2 * na + 1] = 0.;
+            for (dr = -1; dr <= 1; dr++) {
+                if (lr + dr < 0 || lr + dr >= d->nr) continue;
+                for (dc = -1; dc <= 1; dc++) {
+                    if (lc + dc < 0 || lc + dc >= d->nc) continue;
+                    nb = na + (long)dr * d->nc + dc;
+                    b = sp->a + (na * 9 + 3 * (dr + 1) + dc + 1) * 4;
+                    out[2 * na] += b[0] * v[2 * nb] + b[1] * v[2 * nb + 1];
+                    out[2 * na + 1] += b[2] * v[2 * nb] + b[3] * v[2 * nb + 1];
+                }
+            }
+        }
+    }
+}
+
+static void precondition (long nn, struct SPACE *sp) {
+
+    /* z = M^-1 r */
+
+    double  *m;
+    long    n;
+
+    for (n = 0; n < nn; n++) {
+        m = sp->minv + 4 * n;
+        sp->z[2 * n] = m[0] * sp->r[2 * n] + m[1] * sp->r[2 * n + 1];
+        sp->z[2 * n + 1] = m[2] * sp->r[2 * n] + m[3] * sp->r[2 * n + 1];
+    }
+}
+
+static int pcg (struct WORK *w, struct DOM *d, struct SPACE *sp) {
+
+    /* The domain's deflections into sp->v; returns the iterations */
+
+    double  rz, rz1, rr, bb = 0., pq, alpha, beta, det, *b;
+    long    n, i, nn = (long)d->nr * d->nc;
+    int     it;
+
+    for (n = 0; n < nn; n++) {
+        b = sp->a + (n * 9 + 4) * 4;
+        det = b[0] * b[3] - b[1] * b[2];
+        sp->minv[4 * n] = b[3] / det;
+        sp->minv[4 * n + 1] = -b[1] / det;
+        sp->minv[4 * n + 2] = -b[2] / det;
+        sp->minv[4 * n + 3] = b[0] / det;
+    }
+    for (i = 0; i < 2 * nn; i++) {
+        sp->v[i] = 0.;
+        sp->r[i] = sp->rhs[i];
+        bb += sp->rhs[i] * sp->rhs[i];
+    }
+    precondition (nn, sp);
+    for (i = 0, rz = rr = 0.; i < 2 * nn; i++) {
+        sp->p[i] = sp->z[i];
+        rz += sp->r[i] * sp->z[i];
+        rr += sp->r[i] * sp->r[i];
+    }
+    for (it = 0; it < w->maxit && rr > w->tol * w->tol * bb; it++) {
+        product (d, sp, sp->p, sp->q);
+        for (i = 0, pq = 0.; i < 2 * nn; i++) pq += sp->p[i] * sp->q[i];
+        alpha = rz / pq;
+        for (i = 0; i < 2 * nn; i++) {
+            sp->v[i] += alpha * sp->p[i];
+            sp->r[i] -= alpha * sp->q[i];
+        }
+        precondition (nn, sp);
+        for (i = 0, rz1 = rr = 0.; i < 2 * nn; i++) {
+            rz1 += sp->r[i] * sp->z[i];
+            rr += sp->r[i] * sp->r[i];
+        }
+        beta = rz1 / rz;
+        rz = rz1;
+        for (i = 0; i < 2 * nn; i++) sp->p[i] = sp->z[i] + beta * sp->p[i];
+    }
+    return (it);
+}
+
+static long summed (struct DOM *d, long *s, int r, int c) {
+    return ((r < 0 || c < 0) ? 0 : s[(long)r * d->nc + c]);
+}
+
+static int near_data (struct WORK *w, struct DOM *d, struct SPACE *sp, int lr, int lc) {
+
+    /* Whether a slope lies in the cells within mask nodes of node (lr, lc);
+       a cell's count is kept at its north-east node and then summed from
+       the south-west corner of the domain */
+
+    int     a0 = lr - w->mask, a1 = lr + w->mask, b0 = lc - w->mask, b1 = lc + w->mask;
+
+    if (a1 > d->nr - 1) a1 = d->nr - 1;
+    if (b1 > d->nc - 1) b1 = d->nc - 1;
+    return (summed (d, sp->cnt, a1, b1) - summed (d, sp->cnt, a0, b1)
+        - summed (d, sp->cnt, a1, b0) + summed (d, sp->cnt, a0, b0) > 0);
+}
+
+static void keep (struct WORK *w, struct DOM *d, struct SPACE *sp, int solved) {
+
+    /* The tile's own nodes into the band's rows */
+
+    float   *xi, *eta;
+    long    na;
+    int     j, i, lr, lc;
+
+    for (j = 0; j < d->th; j++) {
+        xi = w->out + (long)j * w->h.nx;
+        eta = w->out + ((long)w->tile + j) * w->h.nx;
+        lr = d->j0 + j - d->r0;
+        for (i = d->i0; i < d->i0 + d->tw; i++) {
+            lc = local_col (w, d, i);
+            na = (long)lr * d->nc + lc;
+            if (solved && near_data (w, d, sp, lr, lc)) {
+                xi[i] = (float)sp->v[2 * na];
+                eta[i] = (float)sp->v[2 * na + 1];
+            }
+            else xi[i] = eta[i] = NAN;
+        }
+    }
+}
+
+static void *tile_work (void *arg) {
+    struct WORK *w = (struct WORK *)arg;
+    struct SPACE sp;
+    struct DOM d;
+    long    c, nn, n, iter = 0, nsolved = 0, nslow = 0, nempty = 0;
+    int     it, lr, lc;
+
+    nn = (long)(w->tile + 2 * w->halo) * (w->tile + 2 * w->halo);
+    sp.a = (double *) malloc (nn * 36 * sizeof (double));
+    sp.rhs = (double *) malloc (nn * 12 * sizeof (double));
+    sp.minv = (double *) malloc (nn * 4 * sizeof (double));
+    sp.cnt = (long *) malloc (nn * sizeof (long));
+    if (sp.a == NULL || sp.rhs == NULL || sp.minv == NULL || sp.cnt == NULL) {
+        fprintf (stderr, "Failed to malloc tile equations\n");
+        pthread_mutex_lock (&w->lock);
+        w->err = 1;
+        pthread_mutex_unlock (&w->lock);
+        nn = 0;
+    }
+    sp.v = sp.rhs + 2 * nn;
+    sp.r = sp.v + 2 * nn;
+    sp.z = sp.r + 2 * nn;
+    sp.p = sp.z + 2 * nn;
+    sp.q = sp.p + 2 * nn;
+    while (nn) {
+        pthread_mutex_lock (&w->lock);
+        c = w->next++;
+        pthread_mutex_unlock (&w->lock);
+        if (c >= w->ntcol) break;
+        domain (w, w->band, (int)c, &d);
+        if (w->start[c+1] == w->start[c]) {
+            keep (w, &d, &sp, 0);
+            nempty++;
+            continue;
+        }
+        accumulate (w, &d, &sp, c);
+        for (lr = 0; lr < d.nr; lr++) {
+            for (lc = 0; lc < d.nc; lc++) {
+                n = (long)lr * d.nc + lc;
+                if (lc > 0) sp.cnt[n] += sp.cnt[n-1];
+                if (lr > 0) sp.cnt[n] += sp.cnt[n - d.nc];
+                if (lr > 0 && lc > 0) sp.cnt[n] -= sp.cnt[n - d.nc - 1];
+            }
+        }
+        it = pcg (w, &d, &sp);
+        keep (w, &d, &sp, 1);
+        iter += it;
+        nsolved++;
+        if (it >= w->maxit) nslow++;
+    }
+    pthread_mutex_lock (&w->lock);
+    w->iter += iter;
+    w->nsolved += nsolved;
+    w->nslow += nslow;
+    w->nempty += nempty;
+    pthread_mutex_unlock (&w->lock);
+    free ( (void *)sp.a);
+    free ( (void *)sp.rhs);
+    free ( (void *)sp.minv);
+    free ( (void *)sp.cnt);
+    return (NULL);
+}
+
+int main (int argc, char **argv) {
+
+    struct CDR_ARCH a;
+    struct WORK w;
+    struct BANDS s;
+    struct timespec c0, c1;
+    pthread_t tid[MAXTHREAD];
+    char    *outname = NULL, *tmpdir = ".", scratch[1024];
+    double  west = 0., east = 360., south = -80., north = 80., inc = 1., secs;
+    long    nobs = 0, cap = 0;
+    int     c, i, b, bad = 0, fd;
+
+    memset (&w, 0, sizeof (w));
+    memset (&s, 0, sizeof (s));
+    w.tile = 120;
+    w.halo = 40;
+    w.mask = 4;
+    w.smooth = 1.;
+    w.tol = 1.e-5;
+    w.maxit = 500;
+    w.nthread = (int)sysconf (_SC_NPROCESSORS_ONLN);
+    while ((c = getopt (argc, argv, "H:I:M:R:T:i:j:o:s:w:")) != -1) {
+        switch (c) {
+            case 'H':   /* halo, nodes */
+                w.halo = atoi (optarg);
+                break;
+            case 'I':   /* grid spacing, arc minutes */
+                inc = atof (optarg);
+                break;
+            case 'M':   /* mask distance, nodes */
+                w.mask = atoi (optarg);
+                break;
+            case 'R':   /* region */
+                if (sscanf (optarg, "%lf/%lf/%lf/%lf", &west, &east, &south, &north) != 4) bad = 1;
+                break;
+            case 'T':   /* tile, nodes */
+                w.tile = atoi (optarg);
+                break;
+            case 'i':   /* most iterations per tile */
+                w.maxit = atoi (optarg);
+                break;
+            case 'j':   /* threads */
+                w.nthread = atoi (optarg);
+                break;
+            case 'o':   /* output */
+                outname = optarg;
+                break;
+            case 's':   /* smoothing */
+                w.smooth = atof (optarg);
+                break;
+            case 'w':   /* scratch directory */
+                tmpdir = optarg;
+                break;
+            default:
+                bad = 1;
+                break;
+        }
+    }
+    if (bad || argc - optind != 1 || outname == NULL || !(inc > 0.) || w.tile < 2 || w.halo < 1 || w.halo > w.tile
+        || w.mask < 1 || w.mask > w.halo || !(w.smooth > 0.) || w.maxit < 1 || !(south >= -90. && south < north && north <= 90.)
+        || !(east > west && east - west <= 360.)) {
+        fprintf (stderr, "usage: cdr2dov -o out.grd [-R w/e/s/n] [-I arcmin] [-s smooth] [-T tile] [-H halo] [-M mask] [-i maxit] [-w dir] [-j nthreads] archive.cda\n");
+        fprintf (stderr, "\t-o  write the grid here (fgrid.h): plane 0 north deflection, plane 1 east, microradians\n");
+        fprintf (stderr, "\t-R  region, deg (default 0/360/-80/80; 360 deg of lon wraps)\n");
+        fprintf (stderr, "\t-I  node spacing, arc minutes (default 1)\n");
+        fprintf (stderr, "\t-s  smoothing, per slope of unit weight (default 1)\n");
+        fprintf (stderr, "\t-T  tile size, nodes (default 120)\n");
+        fprintf (stderr, "\t-H  extra nodes solved on each side of a tile, at most the tile (default 40)\n");
+        fprintf (stderr, "\t-M  NaN at nodes with no slope within this many nodes, at most the halo (default 4)\n");
+        fprintf (stderr, "\t-i  most conjugate gradient iterations per tile (default 500)\n");
+        fprintf (stderr, "\t-w  directory for the scratch files, about 16 bytes a point (default .)\n");
+        fprintf (stderr, "\t-j  threads (default one per online CPU)\n");
+        exit (EXIT_FAILURE);
+    }
+    if (w.nthread < 1) w.nthread = 1;
+    if (w.nthread > MAXTHREAD) w.nthread = MAXTHREAD;
+    clock_gettime (CLOCK_MONOTONIC, &c0);
+
+    /* the grid, its tiles, and an empty file for it */
+    memset (&w.h, 0, sizeof (w.h));
+    w.h.dx = w.h.dy = inc / 60.;
+    w.h.west = wrap (west);
+    w.h.south = south;
+    w.h.global = (east - west > 360. - 0.5 * w.h.dx);
+    w.h.nx = (int)floor ((east - west) / w.h.dx + 0.5) + !w.h.global;
+    w.h.ny = (int)floor ((north - south) / w.h.dy + 0.5) + 1;
+    w.h.nplane = 2;
+    if (w.h.global) w.h.dx = 360. / w.h.nx;
+    w.nband = (w.h.ny + w.tile - 1) / w.tile;
+    w.ntcol = (w.h.nx + w.tile - 1) / w.tile;
+    if (w.h.nx < 2 || w.h.ny < 2 || (w.h.global && w.h.nx < w.tile + 2 * w.halo)) {
+        fprintf (stderr, "Failed: a %d x %d grid is too small for tiles of %d and a halo of %d\n", w.h.nx, w.h.ny, w.tile, w.halo);
+        exit (EXIT_FAILURE);
+    }
+    if ((fd = fgrid_create (outname, &w.h)) < 0) exit (EXIT_FAILURE);
+
+    /* the slopes into the bands' scratch, unlinked at once so they go when we do */
+    if (cdr_arch_open (&a, argv[optind])) exit (EXIT_FAILURE);
+    s.fp = (FILE **) calloc (w.nband, sizeof (FILE *));
+    s.buf = (struct OBS *) malloc ((size_t)w.nband * OBSBUF * sizeof (struct OBS));
+    s.nbuf = (int *) calloc (w.nband, sizeof (int));
+    s.n = (long *) calloc (w.nband, sizeof (long));
+    if (s.fp == NULL || s.buf == NULL || s.nbuf == NULL || s.n == NULL) {
+        fprintf (stderr, "Failed to malloc %d band buffers\n", w.nband);
+        exit (EXIT_FAILURE);
+    }
+    for (b = 0; b < w.nband; b++) {
+        sprintf (scratch, "%.900s/cdr2dov.%ld.%d", tmpdir, (long)getpid (), b);
+        if ((s.fp[b] = fopen (scratch, "w+b")) == NULL) {
+            fprintf (stderr, "Failed to open scratch %s\n", scratch);
+            exit (EXIT_FAILURE);
+        }
+        unlink (scratch);
+    }
+    if (stream (&w, &a, &s, &nobs)) exit (EXIT_FAILURE);
+    for (b = 0; b < w.nband; b++) {
+        if (flush_band (&s, b) || fflush (s.fp[b])) exit (EXIT_FAILURE);
+        if (s.n[b] > s.most) s.most = s.n[b];
+    }
+    cdr_arch_close (&a);
+    free ( (void *)s.buf);
+
+    /* band by band: the slopes back, binned by tile, the tiles solved and the rows written */
+    w.start = (long *) malloc ((w.ntcol + 1) * sizeof (long));
+    w.out = (float *) malloc ((size_t)2 * w.tile * w.h.nx * sizeof (float));
+    if (w.start == NULL || w.out == NULL) {
+        fprintf (stderr, "Failed to malloc band rows\n");
+        exit (EXIT_FAILURE);
+    }
+    pthread_mutex_init (&w.lock, NULL);
+    for (b = 0; b < w.nband; b++) {
+        if (s.n[b] > cap) {
+            cap = s.n[b];
+            free ( (void *)w.obs);
+            if ((w.obs = (struct OBS *) malloc (cap * sizeof (struct OBS))) == NULL) {
+                fprintf (stderr, "Failed to malloc %ld slopes\n", cap);
+                exit (EXIT_FAILURE);
+            }
+        }
+        rewind (s.fp[b]);
+        if (fread (w.obs, sizeof (struct OBS), s.n[b], s.fp[b]) != (size_t)s.n[b]) {
+            fprintf (stderr, "Failed to read band %d scratch\n", b);
+            exit (EXIT_FAILURE);
+        }
+        fclose (s.fp[b]);
+        if (bin_band (&w, s.n[b])) exit (EXIT_FAILURE);
+        w.band = b;
+        w.next = 0;
+        for (i = 0; i < w.nthread; i++) {
+            if (pthread_create (&tid[i], NULL, tile_work, &w)) {
+                fprintf (stderr, "Failed to start thread %d\n", i);
+                exit (EXIT_FAILURE);
+            }
+        }
+        for (i = 0; i < w.nthread; i++) pthread_join (tid[i], NULL);
+        if (w.err) exit (EXIT_FAILURE);
+        c = (w.h.ny - b * w.tile < w.tile) ? w.h.ny - b * w.tile : w.tile;
+        if (fgrid_put (fd, &w.h, 0, b * w.tile, c, w.out) || fgrid_put (fd, &w.h, 1, b * w.tile, c, w.out + (size_t)w.tile * w.h.nx))
+            exit (EXIT_FAILURE);
+    }
+    if (fgrid_close (fd)) exit (EXIT_FAILURE);
+    clock_gettime (CLOCK_MONOTONIC, &c1);
+    secs = (c1.tv_sec - c0.tv_sec) + 1.e-9 * (c1.tv_nsec - c0.tv_nsec);
+
+    fprintf (stderr, "cdr2dov: %ld slopes onto a %d x %d grid, %ld tiles solved (%ld empty) in %.1f iterations each, %ld not converged.\n",
+        nobs, w.h.nx, w.h.ny, w.nsolved, w.nempty, (w.nsolved) ? (double)w.iter / w.nsolved : 0., w.nslow);
+    fprintf (stderr, "cdr2dov: at most %ld slopes in a band of %d rows; %d threads in %.2f s.\n", s.most, w.tile, w.nthread, secs);
+    free ( (void *)w.obs);
+    free ( (void *)w.list);
+    free ( (void *)w.start);
+    free ( (void *)w.out);
+    free ( (void *)s.fp);
+    free ( (void *)s.nbuf);
+    free ( (void *)s.n);
+    exit (EXIT_SUCCESS);
+}